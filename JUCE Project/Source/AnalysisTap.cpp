@@ -0,0 +1,129 @@
+// analysisTap.cpp
+
+#include "AnalysisTap.h"
+
+AnalysisTap::AnalysisTap()
+  : stageFrames((size_t)stageFifoSize),
+  signalFrames((size_t)signalFifoSize)
+{
+}
+
+void AnalysisTap::prepare(double sampleRate, int oversamplingRatio)
+{
+  baseSampleRate.store(sampleRate, std::memory_order_relaxed);
+
+  const double oversampledRate = sampleRate * (double)juce::jmax(1, oversamplingRatio);
+  decimation = juce::jmax(1, juce::roundToInt(oversampledRate / (double)targetStageFramesPerSecond));
+  decimationPhase = 0;
+}
+
+//==============================================================================
+bool AnalysisTap::beginBlock(size_t numOversampledSamples) noexcept
+{
+  scratchCount = 0;
+
+  if (!isEnabled())
+    return false;
+
+  const int numSamples = (int)numOversampledSamples;
+  if (decimationPhase >= numSamples)
+  {
+    decimationPhase -= numSamples;
+    return false;
+  }
+
+  // Every decimation-th sample, continuing the stride of the previous block
+  const int available = (numSamples - decimationPhase + decimation - 1) / decimation;
+  scratchFirst = decimationPhase;
+  scratchCount = juce::jmin(available, maxStageFramesPerBlock);
+  decimationPhase = decimationPhase + (available * decimation) - numSamples;
+
+  return scratchCount > 0;
+}
+
+void AnalysisTap::captureChainInput(const float* data, int rateShift) noexcept
+{
+  for (int k = 0; k < scratchCount; ++k)
+    scratch[(size_t)k].chainIn = data[(scratchFirst + k * decimation) >> rateShift];
+}
+
+void AnalysisTap::captureStageInput(int stage, const float* data, const KorenTriodeModel::Stage& params,
+  int rateShift) noexcept
+{
+  for (int k = 0; k < scratchCount; ++k)
+    scratch[(size_t)k].vgk[stage] = (data[(scratchFirst + k * decimation) >> rateShift] * params.drive) + params.bias;
+}
+
+void AnalysisTap::captureStageOutput(int stage, const float* data, const KorenTriodeModel::Stage& params,
+  int rateShift) noexcept
+{
+  // Undo the stage's output scaling (gainVal / 300) to get back to plate volts
+  const float toPlate = params.gainVal != 0.0f ? (300.0f / params.gainVal) : 0.0f;
+
+  for (int k = 0; k < scratchCount; ++k)
+    scratch[(size_t)k].vp[stage] = data[(scratchFirst + k * decimation) >> rateShift] * toPlate;
+}
+
+void AnalysisTap::captureChainOutput(const float* data, int rateShift) noexcept
+{
+  for (int k = 0; k < scratchCount; ++k)
+    scratch[(size_t)k].chainOut = data[(scratchFirst + k * decimation) >> rateShift];
+}
+
+void AnalysisTap::endBlock() noexcept
+{
+  if (scratchCount <= 0)
+    return;
+
+  int start1, size1, start2, size2;
+  stageFifo.prepareToWrite(scratchCount, start1, size1, start2, size2);
+
+  // A full FIFO means the analyzer is behind; drop rather than wait
+  std::copy_n(scratch.begin(), size1, stageFrames.begin() + start1);
+  std::copy_n(scratch.begin() + size1, size2, stageFrames.begin() + start2);
+  stageFifo.finishedWrite(size1 + size2);
+
+  scratchCount = 0;
+}
+
+void AnalysisTap::pushSignal(const float* dry, const float* wet, int numSamples) noexcept
+{
+  if (!isEnabled())
+    return;
+
+  int start1, size1, start2, size2;
+  signalFifo.prepareToWrite(numSamples, start1, size1, start2, size2);
+
+  for (int i = 0; i < size1; ++i)
+    signalFrames[(size_t)(start1 + i)] = { dry[i], wet[i] };
+
+  for (int i = 0; i < size2; ++i)
+    signalFrames[(size_t)(start2 + i)] = { dry[size1 + i], wet[size1 + i] };
+
+  signalFifo.finishedWrite(size1 + size2);
+}
+
+//==============================================================================
+int AnalysisTap::popStageFrames(StageFrame* dest, int maxFrames) noexcept
+{
+  int start1, size1, start2, size2;
+  stageFifo.prepareToRead(maxFrames, start1, size1, start2, size2);
+
+  std::copy_n(stageFrames.begin() + start1, size1, dest);
+  std::copy_n(stageFrames.begin() + start2, size2, dest + size1);
+  stageFifo.finishedRead(size1 + size2);
+
+  return size1 + size2;
+}
+
+int AnalysisTap::popSignalFrames(SignalFrame* dest, int maxFrames) noexcept
+{
+  int start1, size1, start2, size2;
+  signalFifo.prepareToRead(maxFrames, start1, size1, start2, size2);
+
+  std::copy_n(signalFrames.begin() + start1, size1, dest);
+  std::copy_n(signalFrames.begin() + start2, size2, dest + size1);
+  signalFifo.finishedRead(size1 + size2);
+
+  return size1 + size2;
+}
@@ -0,0 +1,105 @@
+// analysisTap.h
+
+#pragma once
+
+#include <JuceHeader.h>
+#include "KorenTriodeModel.h"
+
+/**
+    Wait-free tap from the audio thread to the analyzer.
+
+    DistortionEngine captures a decimated slice of every block (channel 0 only):
+    the chain input/output and the Vgk/Vp operating point of every Koren stage at
+    the oversampled rate, plus the base-rate dry and wet signal. Both streams go
+    through single-producer/single-consumer FIFOs; the audio side never waits and
+    simply drops data when the consumer falls behind. The per-block cost is bounded
+    by maxStageFramesPerBlock strided copies plus one copy of the base-rate block.
+
+    Capture is off unless something enables it (the editor does, while it is showing).
+*/
+class AnalysisTap
+{
+public:
+  static constexpr int numStages = 5;
+
+  /** One decimated sample of the oversampled triode chain. */
+  struct StageFrame
+  {
+    float chainIn = 0.0f;        // before stage 1
+    float chainOut = 0.0f;       // after stage 5
+    float vgk[numStages] = {};   // grid-cathode voltage at each stage
+    float vp[numStages] = {};    // plate voltage at each stage
+  };
+
+  /** One base-rate sample of the dry input and the wet (pre-mix) output. */
+  struct SignalFrame
+  {
+    float dry = 0.0f;
+    float wet = 0.0f;
+  };
+
+  AnalysisTap();
+  ~AnalysisTap() = default;
+
+  // Sets the capture rate for a new stream format. The FIFOs are allocated once,
+  // in the constructor, so this never reallocates under a running analyzer.
+  void prepare(double sampleRate, int oversamplingRatio);
+
+  void setEnabled(bool shouldBeEnabled) noexcept { enabled.store(shouldBeEnabled, std::memory_order_relaxed); }
+  bool isEnabled() const noexcept { return enabled.load(std::memory_order_relaxed); }
+
+  double getSampleRate() const noexcept { return baseSampleRate.load(std::memory_order_relaxed); }
+
+  //==============================================================================
+  // Audio thread
+
+  // Starts capturing an oversampled block. Returns false if nothing is to be captured.
+  bool beginBlock(size_t numOversampledSamples) noexcept;
+
+  // rateShift: how many 2x steps below the oversampled rate the data runs at
+  // (stages can run at lower rates than the top one, see DistortionEngine::RatePlan)
+  void captureChainInput(const float* data, int rateShift = 0) noexcept;
+  void captureStageInput(int stage, const float* data, const KorenTriodeModel::Stage& params,
+    int rateShift = 0) noexcept;
+  void captureStageOutput(int stage, const float* data, const KorenTriodeModel::Stage& params,
+    int rateShift = 0) noexcept;
+  void captureChainOutput(const float* data, int rateShift = 0) noexcept;
+
+  // Publishes the frames captured since beginBlock
+  void endBlock() noexcept;
+
+  void pushSignal(const float* dry, const float* wet, int numSamples) noexcept;
+
+  //==============================================================================
+  // Analyzer thread
+
+  int popStageFrames(StageFrame* dest, int maxFrames) noexcept;
+  int popSignalFrames(SignalFrame* dest, int maxFrames) noexcept;
+
+  // Frames captured per oversampled block, at most
+  static constexpr int maxStageFramesPerBlock = 64;
+
+private:
+  // Roughly how many stage frames per second the analyzer gets
+  static constexpr int targetStageFramesPerSecond = 4000;
+
+  std::atomic<bool> enabled{ false };
+  std::atomic<double> baseSampleRate{ 44100.0 };
+
+  // Stride between captured oversampled samples, and where the next block starts
+  int decimation = 1;
+  int decimationPhase = 0;
+
+  // Frames of the block being captured
+  std::array<StageFrame, maxStageFramesPerBlock> scratch;
+  int scratchCount = 0;
+  int scratchFirst = 0;
+
+  static constexpr int stageFifoSize = 8192;
+  juce::AbstractFifo stageFifo{ stageFifoSize };
+  std::vector<StageFrame> stageFrames;
+
+  static constexpr int signalFifoSize = 1 << 17;
+  juce::AbstractFifo signalFifo{ signalFifoSize };
+  std::vector<SignalFrame> signalFrames;
+};
@@ -0,0 +1,143 @@
+// analyzerView.cpp
+
+#include "AnalyzerView.h"
+
+namespace
+{
+  const juce::Colour stageColours[TubeAnalyzer::numStages] =
+  {
+    juce::Colours::orange,
+    juce::Colours::gold,
+    juce::Colours::lightgreen,
+    juce::Colours::skyblue,
+    juce::Colours::violet
+  };
+
+  // Bounds of a set of points, padded so a flat line still has some height
+  juce::Rectangle<float> getPointBounds(const juce::Point<float>* points, int numPoints)
+  {
+    if (numPoints <= 0)
+      return { -1.0f, -1.0f, 2.0f, 2.0f };
+
+    float minX = points[0].x, maxX = points[0].x;
+    float minY = points[0].y, maxY = points[0].y;
+
+    for (int i = 1; i < numPoints; ++i)
+    {
+      minX = juce::jmin(minX, points[i].x);
+      maxX = juce::jmax(maxX, points[i].x);
+      minY = juce::jmin(minY, points[i].y);
+      maxY = juce::jmax(maxY, points[i].y);
+    }
+
+    const float padX = juce::jmax(1.0e-3f, (maxX - minX) * 0.05f);
+    const float padY = juce::jmax(1.0e-3f, (maxY - minY) * 0.05f);
+    return { minX - padX, minY - padY, (maxX - minX) + 2.0f * padX, (maxY - minY) + 2.0f * padY };
+  }
+
+  void plotPoints(juce::Graphics& g, juce::Rectangle<float> area, const juce::Point<float>* points, int numPoints)
+  {
+    const auto range = getPointBounds(points, numPoints);
+
+    for (int i = 0; i < numPoints; ++i)
+    {
+      const float x = area.getX() + (points[i].x - range.getX()) / range.getWidth() * area.getWidth();
+      const float y = area.getBottom() - (points[i].y - range.getY()) / range.getHeight() * area.getHeight();
+      g.fillRect(x - 0.75f, y - 0.75f, 1.5f, 1.5f);
+    }
+  }
+}
+
+//==============================================================================
+void AnalyzerView::refresh(TubeAnalyzer& analyzer)
+{
+  if (analyzer.getLatestSnapshot(snapshot))
+    repaint();
+}
+
+void AnalyzerView::paint(juce::Graphics& g)
+{
+  g.fillAll(juce::Colours::black.withAlpha(0.85f));
+
+  auto area = getLocalBounds().toFloat().reduced(6.0f);
+  auto top = area.removeFromTop(area.getHeight() * 0.55f);
+
+  drawTransferCurve(g, top.removeFromLeft(top.getWidth() * 0.5f).reduced(4.0f));
+  drawStageScatter(g, top.reduced(4.0f));
+  drawSpectrum(g, area.reduced(4.0f));
+}
+
+void AnalyzerView::drawTransferCurve(juce::Graphics& g, juce::Rectangle<float> area)
+{
+  g.setColour(juce::Colours::grey);
+  g.drawRect(area);
+  g.setFont(11.0f);
+  g.drawText("Transfer (in -> out)", area.removeFromTop(14.0f), juce::Justification::centredLeft);
+
+  g.setColour(juce::Colours::white);
+  plotPoints(g, area, snapshot.transferCurve.data(), snapshot.numPoints);
+}
+
+void AnalyzerView::drawStageScatter(juce::Graphics& g, juce::Rectangle<float> area)
+{
+  g.setColour(juce::Colours::grey);
+  g.drawRect(area);
+  g.setFont(11.0f);
+  g.drawText("Stages (Vgk -> Vp)", area.removeFromTop(14.0f), juce::Justification::centredLeft);
+
+  // Plate levels along the bottom, one column per stage
+  auto levels = area.removeFromBottom(14.0f);
+  const float columnWidth = levels.getWidth() / (float)TubeAnalyzer::numStages;
+
+  for (int s = 0; s < TubeAnalyzer::numStages; ++s)
+  {
+    g.setColour(stageColours[s]);
+    plotPoints(g, area, snapshot.stageScatter[(size_t)s].data(), snapshot.numPoints);
+    g.drawText("S" + juce::String(s + 1) + " " + juce::String(snapshot.stageLevelDb[(size_t)s], 1),
+      levels.removeFromLeft(columnWidth), juce::Justification::centred);
+  }
+}
+
+void AnalyzerView::drawSpectrum(juce::Graphics& g, juce::Rectangle<float> area)
+{
+  g.setColour(juce::Colours::grey);
+  g.drawRect(area);
+  g.setFont(11.0f);
+
+  // Harmonic levels relative to the fundamental
+  juce::String harmonics = juce::String(snapshot.fundamentalHz, 0) + " Hz";
+  for (int n = 1; n < TubeAnalyzer::numHarmonics; ++n)
+    harmonics += "  H" + juce::String(n + 1) + " " + juce::String(snapshot.harmonicsDb[(size_t)n], 1);
+
+  g.drawText(harmonics, area.removeFromTop(14.0f), juce::Justification::centredLeft);
+
+  // Log frequency from 20 Hz to Nyquist, -120..0 dB
+  const float minHz = 20.0f;
+  const float maxHz = (float)snapshot.sampleRate * 0.5f;
+  const float binHz = (float)snapshot.sampleRate / (float)TubeAnalyzer::fftSize;
+  const float logRange = std::log(maxHz / minHz);
+
+  juce::Path path;
+  bool started = false;
+
+  for (int k = 1; k < TubeAnalyzer::numBins; ++k)
+  {
+    const float hz = (float)k * binHz;
+    if (hz < minHz)
+      continue;
+
+    const float x = area.getX() + std::log(hz / minHz) / logRange * area.getWidth();
+    const float db = juce::jlimit(-120.0f, 0.0f, snapshot.spectrumDb[(size_t)k]);
+    const float y = area.getY() + (db / -120.0f) * area.getHeight();
+
+    if (!started)
+      path.startNewSubPath(x, y);
+    else
+      path.lineTo(x, y);
+
+    started = true;
+  }
+
+  g.setColour(juce::Colours::orange);
+  g.strokePath(path, juce::PathStrokeType(1.0f));
+}
@@ -0,0 +1,32 @@
+// analyzerView.h
+
+#pragma once
+
+#include <JuceHeader.h>
+#include "TubeAnalyzer.h"
+
+/**
+    Overlay that draws a TubeAnalyzer snapshot: the transfer curve, the per-stage
+    Vgk/Vp scatter with plate levels, and the output spectrum with its harmonics.
+    Painting only reads the snapshot, nothing here touches the audio thread.
+*/
+class AnalyzerView : public juce::Component
+{
+public:
+  AnalyzerView() = default;
+  ~AnalyzerView() override = default;
+
+  // Pulls the latest snapshot from the analyzer and repaints if it changed
+  void refresh(TubeAnalyzer& analyzer);
+
+  void paint(juce::Graphics& g) override;
+
+private:
+  void drawTransferCurve(juce::Graphics& g, juce::Rectangle<float> area);
+  void drawStageScatter(juce::Graphics& g, juce::Rectangle<float> area);
+  void drawSpectrum(juce::Graphics& g, juce::Rectangle<float> area);
+
+  TubeAnalyzer::Snapshot snapshot;
+
+  JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(AnalyzerView)
+};
@@ -0,0 +1,78 @@
+// arenaBiquad.h
+
+#pragma once
+
+#include <JuceHeader.h>
+#include "DspArena.h"
+
+/**
+    Direct form II transposed biquad whose coefficients and per-channel state live
+    in a DspArena, next to each other. Takes coefficients in the
+    IIR::ArrayCoefficients layout { b0, b1, b2, a0, a1, a2 }, so nothing is
+    ref-counted or heap allocated when they change.
+*/
+class ArenaBiquad
+{
+public:
+  void allocate(DspArena& arena, int channels, const char* name)
+  {
+    numChannels = channels;
+    memory = arena.allocate<float>(numCoefficients + 2 * (size_t)channels, name);
+  }
+
+  void setCoefficients(const std::array<float, 6>& c) noexcept
+  {
+    const float a0 = 1.0f / c[3];
+    memory[0] = c[0] * a0;
+    memory[1] = c[1] * a0;
+    memory[2] = c[2] * a0;
+    memory[3] = c[4] * a0;
+    memory[4] = c[5] * a0;
+  }
+
+  void reset() noexcept
+  {
+    if (memory != nullptr)
+      std::fill(memory + numCoefficients, memory + numCoefficients + 2 * numChannels, 0.0f);
+  }
+
+  // Makes one channel carry on exactly like another
+  void copyChannelState(int from, int to) noexcept
+  {
+    std::copy_n(memory + numCoefficients + 2 * from, 2, memory + numCoefficients + 2 * to);
+  }
+
+  float processSample(float x, int channel) noexcept
+  {
+    float* s = memory + numCoefficients + 2 * channel;
+    const float y = memory[0] * x + s[0];
+    s[0] = memory[1] * x - memory[3] * y + s[1];
+    s[1] = memory[2] * x - memory[4] * y;
+    return y;
+  }
+
+  void process(float* data, size_t numSamples, int channel) noexcept
+  {
+    const float b0 = memory[0], b1 = memory[1], b2 = memory[2], a1 = memory[3], a2 = memory[4];
+    float* s = memory + numCoefficients + 2 * channel;
+    float s0 = s[0], s1 = s[1];
+
+    for (size_t i = 0; i < numSamples; ++i)
+    {
+      const float x = data[i];
+      const float y = b0 * x + s0;
+      s0 = b1 * x - a1 * y + s1;
+      s1 = b2 * x - a2 * y;
+      data[i] = y;
+    }
+
+    s[0] = s0;
+    s[1] = s1;
+  }
+
+private:
+  static constexpr int numCoefficients = 5;
+
+  float* memory = nullptr;   // b0 b1 b2 a1 a2, then two state values per channel
+  int numChannels = 0;
+};
@@ -0,0 +1,109 @@
+// biasDrift.cpp
+
+#include "BiasDrift.h"
+
+namespace
+{
+  // Rates of the sines, one per stage in between, and their share of the offset
+  // (the noise has the rest)
+  constexpr double minRateHz = 0.02;
+  constexpr double maxRateHz = 0.1;
+  constexpr float sineShare = 0.5f;
+
+  // Integer hash (lowbias32): a well mixed function of its input, no state
+  juce::uint32 hash(juce::uint32 x) noexcept
+  {
+    x ^= x >> 16;
+    x *= 0x7feb352dU;
+    x ^= x >> 15;
+    x *= 0x846ca68bU;
+    x ^= x >> 16;
+    return x;
+  }
+
+  // Uniform in [0, 1) for a seed, stage and index
+  double unitHash(juce::uint32 seed, int stage, juce::uint32 index) noexcept
+  {
+    return (double)hash(seed ^ hash((juce::uint32)stage * 0x9e3779b9U + hash(index))) / 4294967296.0;
+  }
+}
+
+void BiasDrift::allocate(DspArena& arena)
+{
+  progress = arena.allocate<Progress>(1, "bias drift");
+}
+
+void BiasDrift::prepare(double sampleRate) noexcept
+{
+  sliceLength = juce::jmax(1, juce::roundToInt(sliceSeconds * sampleRate));
+}
+
+void BiasDrift::reset(juce::uint32 seed) noexcept
+{
+  if (progress == nullptr)
+    return;
+
+  auto& state = *progress;
+  state.seed = seed;
+  state.slice = 0;
+  state.position = 0;
+
+  for (int slice = 0; slice < numTargets; ++slice)
+    computeTarget(slice);
+}
+
+void BiasDrift::computeTarget(int slice) noexcept
+{
+  auto& state = *progress;
+  auto& target = state.targets[(size_t)(slice % numTargets)];
+
+  for (int n = 0; n < maxStages; ++n)
+  {
+    // Index 0 is the stage's sine, slices count from 1
+    const double rate = minRateHz + (maxRateHz - minRateHz) * unitHash(state.seed, n, 0);
+    const double phase = unitHash(state.seed, n, 0x5bd1e995U);
+    const double time = slice * sliceSeconds;
+
+    const auto sine = (float)std::sin(juce::MathConstants<double>::twoPi * (phase + rate * time));
+    const auto noise = (float)(2.0 * unitHash(state.seed, n, (juce::uint32)slice + 1) - 1.0);
+
+    target[(size_t)n] = sineShare * sine + (1.0f - sineShare) * noise;
+  }
+}
+
+const float* BiasDrift::getTarget(int slice) const noexcept
+{
+  jassert(slice >= progress->slice && slice < progress->slice + numTargets);
+  return progress->targets[(size_t)(slice % numTargets)].data();
+}
+
+float BiasDrift::getWeight() const noexcept
+{
+  const double fraction = (double)progress->position / (double)sliceLength;
+  return (float)(0.5 - 0.5 * std::cos(juce::MathConstants<double>::pi * fraction));
+}
+
+void BiasDrift::getOffsets(float* offsets) const noexcept
+{
+  const float* from = getTarget(progress->slice);
+  const float* to = getTarget(progress->slice + 1);
+  const float weight = getWeight();
+
+  for (int n = 0; n < maxStages; ++n)
+    offsets[n] = from[n] + weight * (to[n] - from[n]);
+}
+
+bool BiasDrift::advance(int numSamples, bool mayStartNextSlice) noexcept
+{
+  auto& state = *progress;
+  state.position = juce::jmin(state.position + numSamples, sliceLength);
+
+  if (state.position < sliceLength || !mayStartNextSlice)
+    return false;
+
+  // The slice that ended is the oldest target; its place goes to the next one's end
+  ++state.slice;
+  state.position = 0;
+  computeTarget(state.slice + 2);
+  return true;
+}
@@ -0,0 +1,71 @@
+// biasDrift.h
+
+#pragma once
+
+#include <JuceHeader.h>
+#include "DspArena.h"
+
+/**
+    Slow drift of every triode stage's operating point, the way tubes wander with
+    heat and age.
+
+    Each stage's offset (in units, scaled to grid volts by the owner) is a slow
+    sine with its own rate and phase plus smooth random noise. It moves in slices
+    of sliceSeconds: every slice boundary has a target per stage, and within a
+    slice the offsets go from one target to the next along a raised cosine. So
+    anything that depends on the biases can be precomputed at the targets and
+    interpolated by getWeight(), with the next target's being built meanwhile; a
+    slice only ends once the owner says the next one is ready.
+
+    The targets are a function of the seed and the slice number, so besides where
+    it is the drift holds no state. That position and the targets at hand live in
+    a DspArena. Evaluated at control rate (per sub-block), never per sample.
+*/
+class BiasDrift
+{
+public:
+  static constexpr int maxStages = 5;
+  static constexpr double sliceSeconds = 1.5;
+
+  // Targets kept at a time: the slice's start and end, and the next slice's end
+  static constexpr int numTargets = 3;
+
+  void allocate(DspArena& arena);
+  void prepare(double sampleRate) noexcept;
+
+  // Back to slice 0 of the drift seed gives
+  void reset(juce::uint32 seed) noexcept;
+
+  // Slice k goes from target k to target k + 1
+  int getSlice() const noexcept { return progress->slice; }
+
+  // Unit offsets (within -1..1) of every stage at the start of a slice, from the
+  // current one to two ahead
+  const float* getTarget(int slice) const noexcept;
+
+  // How far the current slice has gone from its start target to its end target
+  float getWeight() const noexcept;
+
+  // Unit offsets of every stage at the current position
+  void getOffsets(float* offsets) const noexcept;
+
+  // Moves on by numSamples. At the end of a slice the next one only starts if
+  // mayStartNextSlice, otherwise the offsets hold there. Returns true when a new
+  // slice started.
+  bool advance(int numSamples, bool mayStartNextSlice) noexcept;
+
+private:
+  struct Progress
+  {
+    juce::uint32 seed = 0;
+    int slice = 0;
+    int position = 0;   // samples into the slice
+    std::array<std::array<float, maxStages>, numTargets> targets;
+  };
+
+  // Fills in the target of a slice
+  void computeTarget(int slice) noexcept;
+
+  Progress* progress = nullptr;
+  int sliceLength = 1;
+};
@@ -0,0 +1,580 @@
+// cabinetConvolver.cpp
+
+#include "CabinetConvolver.h"
+
+static_assert(CabinetConvolver::headLength == CabinetConvolver::earlyBlockSize,
+  "The early level's first partition starts where the head ends");
+static_assert(CabinetConvolver::lateOffset % CabinetConvolver::earlyBlockSize == 0
+  && CabinetConvolver::lateBlockSize % CabinetConvolver::earlyBlockSize == 0,
+  "Late blocks end on early block boundaries");
+
+namespace
+{
+  // The impulse's first numChannels channels at sampleRate (band-limited when it
+  // goes down)
+  juce::AudioBuffer<float> resample(const CabinetImpulse& impulse, int numChannels, double sampleRate)
+  {
+    const int numSamples = impulse.samples.getNumSamples();
+    juce::AudioBuffer<float> source(numChannels, numSamples);
+
+    for (int ch = 0; ch < numChannels; ++ch)
+      source.copyFrom(ch, 0, impulse.samples, ch, 0, numSamples);
+
+    if (impulse.sampleRate == sampleRate)
+      return source;
+
+    const double ratio = impulse.sampleRate / sampleRate;
+    const int length = (int)std::ceil((double)numSamples / ratio);
+
+    juce::MemoryAudioSource memorySource(source, false);
+    juce::ResamplingAudioSource resampler(&memorySource, false, numChannels);
+    resampler.setResamplingRatio(ratio);
+    resampler.prepareToPlay(length, sampleRate);
+
+    juce::AudioBuffer<float> result(numChannels, length);
+    resampler.getNextAudioBlock(juce::AudioSourceChannelInfo(result));
+    return result;
+  }
+
+  // accumulator += x * h, over interleaved complex bins
+  void multiplyAccumulate(float* accumulator, const float* x, const float* h, int numBins) noexcept
+  {
+    for (int k = 0; k < 2 * numBins; k += 2)
+    {
+      accumulator[k] += x[k] * h[k] - x[k + 1] * h[k + 1];
+      accumulator[k + 1] += x[k] * h[k + 1] + x[k + 1] * h[k];
+    }
+  }
+}
+
+//==============================================================================
+std::shared_ptr<const CabinetImpulse> CabinetImpulse::loadFromFile(const juce::File& file, juce::String& error)
+{
+  juce::AudioFormatManager formatManager;
+  formatManager.registerBasicFormats();
+
+  std::unique_ptr<juce::AudioFormatReader> reader(formatManager.createReaderFor(file));
+
+  if (reader == nullptr)
+  {
+    error = "Can't read " + file.getFullPathName();
+    return nullptr;
+  }
+
+  const auto length = (int)juce::jmin(reader->lengthInSamples, (juce::int64)(maxSeconds * reader->sampleRate));
+
+  if (length <= 0 || reader->numChannels == 0)
+  {
+    error = file.getFileName() + " is empty";
+    return nullptr;
+  }
+
+  auto impulse = std::make_shared<CabinetImpulse>();
+  impulse->samples.setSize(juce::jmin(2, (int)reader->numChannels), length);
+  reader->read(&impulse->samples, 0, length, 0, true, true);
+  impulse->sampleRate = reader->sampleRate;
+  impulse->name = file.getFileNameWithoutExtension();
+
+  if (impulse->samples.getMagnitude(0, length) == 0.0f)
+  {
+    error = file.getFileName() + " is silent";
+    return nullptr;
+  }
+
+  return impulse;
+}
+
+//==============================================================================
+/** The thread every convolver's late blocks run on. It looks for posted jobs
+    every millisecond while any convolver has a late level; the audio thread only
+    ever stores to an atomic, it never wakes anything. */
+class CabinetConvolver::Worker : public juce::Thread
+{
+public:
+  Worker() : juce::Thread("Eldur cabinet tail") {}
+  ~Worker() override { stopThread(1000); }
+
+  void add(CabinetConvolver* convolver)
+  {
+    {
+      const juce::ScopedLock lock(convolversLock);
+      convolvers.add(convolver);
+    }
+
+    startThread();
+    notify();
+  }
+
+  // Once this returns, the worker is done with the convolver
+  void remove(CabinetConvolver* convolver)
+  {
+    const juce::ScopedLock lock(convolversLock);
+    convolvers.removeFirstMatchingValue(convolver);
+  }
+
+  void run() override
+  {
+    while (!threadShouldExit())
+    {
+      bool idle = true;
+
+      {
+        const juce::ScopedLock lock(convolversLock);
+        idle = convolvers.isEmpty();
+
+        for (auto* convolver : convolvers)
+          convolver->runLateJobs();
+      }
+
+      wait(idle ? -1 : pollMilliseconds);
+    }
+  }
+
+private:
+  static constexpr int pollMilliseconds = 1;
+
+  juce::CriticalSection convolversLock;
+  juce::Array<CabinetConvolver*> convolvers;
+};
+
+//==============================================================================
+CabinetConvolver::Level::Level(int blockSizeToUse, int firstTap, bool onWorker)
+  : blockSize(blockSizeToUse),
+    fftSize(2 * blockSizeToUse),
+    spectrumSize(2 * blockSizeToUse + 2),
+    offset(firstTap),
+    background(onWorker),
+    transform(juce::findHighestSetBit((juce::uint32)(2 * blockSizeToUse))),
+    workerTransform(juce::findHighestSetBit((juce::uint32)(2 * blockSizeToUse)))
+{
+}
+
+CabinetConvolver::CabinetConvolver() = default;
+
+CabinetConvolver::~CabinetConvolver()
+{
+  if (registered)
+    worker->remove(this);
+}
+
+void CabinetConvolver::prepare(const CabinetImpulse* impulse, double sampleRate, int numChannelsToUse)
+{
+  // No worker jobs on the old layout from here on
+  if (registered)
+  {
+    worker->remove(this);
+    registered = false;
+  }
+
+  numChannels = juce::jlimit(1, maxChannels, numChannelsToUse);
+  numImpulseChannels = 0;
+  impulseLength = 0;
+  headTaps = 0;
+  resampled = juce::AudioBuffer<float>();
+
+  for (auto& level : levels)
+  {
+    level.numPartitions = 0;
+    level.historySize = 0;
+  }
+
+  if (impulse == nullptr || impulse->samples.getNumSamples() == 0)
+    return;
+
+  numImpulseChannels = juce::jmin(numChannels, impulse->samples.getNumChannels());
+  resampled = resample(*impulse, numImpulseChannels, sampleRate);
+
+  // Unit energy (averaged over the channels): the cabinet shapes the tone, the
+  // level stays about where it was
+  double energy = 0.0;
+  for (int ch = 0; ch < numImpulseChannels; ++ch)
+    for (int i = 0; i < resampled.getNumSamples(); ++i)
+      energy += (double)resampled.getSample(ch, i) * resampled.getSample(ch, i);
+
+  energy /= numImpulseChannels;
+
+  if (!(energy > 0.0))
+  {
+    numImpulseChannels = 0;
+    return;
+  }
+
+  resampled.applyGain((float)(1.0 / std::sqrt(energy)));
+
+  impulseLength = resampled.getNumSamples();
+  headTaps = juce::jmin(headLength, impulseLength);
+
+  for (auto& level : levels)
+  {
+    const int end = level.background ? impulseLength : juce::jmin(impulseLength, lateOffset);
+    level.numPartitions = juce::jmax(0, (end - level.offset + level.blockSize - 1) / level.blockSize);
+
+    // Two spare entries: a late block still being worked on keeps its oldest
+    // entry for two more writes
+    level.historySize = level.numPartitions + 2;
+  }
+}
+
+void CabinetConvolver::allocate(DspArena& arena)
+{
+  progress = nullptr;
+
+  if (!isActive())
+    return;
+
+  progress = arena.allocate<Progress>(1, "cabinet progress");
+
+  for (int ch = 0; ch < numImpulseChannels; ++ch)
+    head[ch] = arena.allocate<float>((size_t)headTaps, "cabinet head taps");
+
+  for (int ch = 0; ch < numChannels; ++ch)
+    headHistory[ch] = arena.allocate<float>((size_t)(headLength - 1 + earlyBlockSize), "cabinet head history");
+
+  for (auto& level : levels)
+    allocateLevel(arena, level);
+}
+
+void CabinetConvolver::allocateLevel(DspArena& arena, Level& level)
+{
+  if (level.numPartitions == 0)
+    return;
+
+  const auto spectrumSize = (size_t)level.spectrumSize;
+  const auto blockSize = (size_t)level.blockSize;
+
+  for (int ch = 0; ch < numImpulseChannels; ++ch)
+    level.spectra[ch] = arena.allocate<float>((size_t)level.numPartitions * spectrumSize, "cabinet spectra");
+
+  for (int ch = 0; ch < numChannels; ++ch)
+  {
+    level.history[ch] = arena.allocate<float>((size_t)level.historySize * spectrumSize, "cabinet history");
+    level.input[ch] = arena.allocate<float>(2 * blockSize, "cabinet input");
+    level.output[ch] = arena.allocate<float>(blockSize, "cabinet output");
+  }
+
+  level.transformBuffer = arena.allocate<float>(2 * (size_t)level.fftSize, "cabinet transform");
+  level.accumulator = arena.allocate<float>(spectrumSize, "cabinet accumulator");
+
+  if (!level.background)
+    return;
+
+  for (auto& slot : level.slotOutput)
+    for (int ch = 0; ch < numChannels; ++ch)
+      slot[ch] = arena.allocate<float>(blockSize, "cabinet worker output");
+
+  level.workerTransformBuffer = arena.allocate<float>(2 * (size_t)level.fftSize, "cabinet worker transform");
+  level.workerAccumulator = arena.allocate<float>(spectrumSize, "cabinet worker accumulator");
+}
+
+void CabinetConvolver::loadImpulse()
+{
+  if (!isActive())
+    return;
+
+  for (int ch = 0; ch < numImpulseChannels; ++ch)
+    std::copy(resampled.getReadPointer(ch), resampled.getReadPointer(ch) + headTaps, head[ch]);
+
+  for (auto& level : levels)
+    loadLevel(level, resampled);
+
+  resampled = juce::AudioBuffer<float>();
+  reset();
+
+  if (late.numPartitions > 0)
+  {
+    worker->add(this);
+    registered = true;
+  }
+}
+
+void CabinetConvolver::loadLevel(Level& level, const juce::AudioBuffer<float>& taps)
+{
+  float* buffer = level.transformBuffer;
+
+  for (int ch = 0; ch < numImpulseChannels; ++ch)
+  {
+    for (int p = 0; p < level.numPartitions; ++p)
+    {
+      // The partition's taps, zero-padded to the FFT size
+      const int first = level.offset + p * level.blockSize;
+      const int count = juce::jmin(level.blockSize, impulseLength - first);
+
+      std::fill(buffer, buffer + 2 * level.fftSize, 0.0f);
+      std::copy(taps.getReadPointer(ch, first), taps.getReadPointer(ch, first) + count, buffer);
+      level.transform.performRealOnlyForwardTransform(buffer, true);
+
+      std::copy(buffer, buffer + level.spectrumSize, level.spectra[ch] + (size_t)p * (size_t)level.spectrumSize);
+    }
+  }
+}
+
+void CabinetConvolver::reset() noexcept
+{
+  if (!isActive())
+    return;
+
+  // Whatever the worker is on now reads the old history: it throws the result away
+  late.writes.store(late.writes.load(std::memory_order_relaxed) + (juce::uint32)late.historySize + 1,
+    std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+
+  *progress = Progress();
+
+  for (int ch = 0; ch < numChannels; ++ch)
+    juce::FloatVectorOperations::clear(headHistory[ch], headLength - 1 + earlyBlockSize);
+
+  for (auto& level : levels)
+  {
+    if (level.numPartitions == 0)
+      continue;
+
+    for (int ch = 0; ch < numChannels; ++ch)
+    {
+      juce::FloatVectorOperations::clear(level.history[ch], level.historySize * level.spectrumSize);
+      juce::FloatVectorOperations::clear(level.input[ch], 2 * level.blockSize);
+      juce::FloatVectorOperations::clear(level.output[ch], level.blockSize);
+    }
+  }
+
+  due = Due::nothing;
+  lateBlockStats = {};
+}
+
+void CabinetConvolver::copyChannelState(int from, int to) noexcept
+{
+  if (!isActive())
+    return;
+
+  juce::FloatVectorOperations::copy(headHistory[to], headHistory[from], headLength - 1 + earlyBlockSize);
+
+  for (auto& level : levels)
+  {
+    if (level.numPartitions == 0)
+      continue;
+
+    juce::FloatVectorOperations::copy(level.history[to], level.history[from], level.historySize * level.spectrumSize);
+    juce::FloatVectorOperations::copy(level.input[to], level.input[from], 2 * level.blockSize);
+    juce::FloatVectorOperations::copy(level.output[to], level.output[from], level.blockSize);
+  }
+
+  // A late block posted meanwhile only has the from channel
+  discardLateWork();
+}
+
+void CabinetConvolver::discardLateWork() noexcept
+{
+  // Computing it from the history is right whatever the history holds
+  if (isActive() && late.numPartitions > 0)
+    due = Due::audioThread;
+}
+
+//==============================================================================
+void CabinetConvolver::process(const juce::dsp::AudioBlock<float>& block) noexcept
+{
+  if (!isActive())
+    return;
+
+  const int numBlockChannels = juce::jmin((int)block.getNumChannels(), numChannels);
+  const int numSamples = (int)block.getNumSamples();
+  auto& state = *progress;
+
+  // In chunks that end on early block boundaries (late ones are boundaries too)
+  for (int start = 0; start < numSamples;)
+  {
+    const int chunk = juce::jmin(numSamples - start, earlyBlockSize - state.position[0]);
+
+    for (int ch = 0; ch < numBlockChannels; ++ch)
+      processChunk(block.getChannelPointer((size_t)ch) + start, chunk, ch);
+
+    start += chunk;
+
+    for (int l = 0; l < 2; ++l)
+    {
+      auto& level = levels[l];
+      state.position[l] += chunk;
+
+      if (state.position[l] < level.blockSize)
+        continue;
+
+      state.position[l] = 0;
+
+      if (level.numPartitions > 0)
+        completeBlock(level, l, numBlockChannels);
+    }
+  }
+}
+
+void CabinetConvolver::processChunk(float* samples, int numSamples, int channel) noexcept
+{
+  const auto& state = *progress;
+  float* history = headHistory[channel];
+  float* chunkInput = history + headLength - 1;
+
+  juce::FloatVectorOperations::copy(chunkInput, samples, numSamples);
+
+  for (int l = 0; l < 2; ++l)
+    if (levels[l].numPartitions > 0)
+      juce::FloatVectorOperations::copy(levels[l].input[channel] + levels[l].blockSize + state.position[l], samples, numSamples);
+
+  // The partitions' share of these samples, computed at the last block boundaries
+  if (early.numPartitions > 0)
+    juce::FloatVectorOperations::copy(samples, early.output[channel] + state.position[0], numSamples);
+  else
+    juce::FloatVectorOperations::clear(samples, numSamples);
+
+  if (late.numPartitions > 0)
+    juce::FloatVectorOperations::add(samples, late.output[channel] + state.position[1], numSamples);
+
+  // The head, a tap at a time over the whole chunk
+  const float* taps = head[juce::jmin(channel, numImpulseChannels - 1)];
+
+  for (int k = 0; k < headTaps; ++k)
+    juce::FloatVectorOperations::addWithMultiply(samples, chunkInput - k, taps[k], numSamples);
+
+  // The last headLength - 1 inputs stay for the next chunk
+  std::memmove(history, history + numSamples, (size_t)(headLength - 1) * sizeof(float));
+}
+
+void CabinetConvolver::completeBlock(Level& level, int levelIndex, int numBlockChannels) noexcept
+{
+  auto& state = *progress;
+  const int entry = state.newest[levelIndex] + 1 == level.historySize ? 0 : state.newest[levelIndex] + 1;
+
+  // Counted before the write (as a seqlock): a worker that reads the write sees
+  // the count
+  if (level.background)
+  {
+    level.writes.store(level.writes.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+  }
+
+  for (int ch = 0; ch < numBlockChannels; ++ch)
+  {
+    float* input = level.input[ch];
+
+    std::copy(input, input + level.fftSize, level.transformBuffer);
+    level.transform.performRealOnlyForwardTransform(level.transformBuffer, true);
+    std::copy(level.transformBuffer, level.transformBuffer + level.spectrumSize,
+      level.history[ch] + (size_t)entry * (size_t)level.spectrumSize);
+
+    // The block becomes the previous one
+    std::copy(input + level.blockSize, input + level.fftSize, input);
+  }
+
+  state.newest[levelIndex] = entry;
+
+  if (!level.background)
+  {
+    computeBlock(level, entry, level.output, numBlockChannels, level.transformBuffer, level.accumulator, level.transform);
+    return;
+  }
+
+  collectLateBlock(numBlockChannels);
+  postLateBlock(numBlockChannels);
+}
+
+void CabinetConvolver::computeBlock(const Level& level, int newest, float* const* destination, int numBlockChannels,
+  float* transformBuffer, float* accumulator, const juce::dsp::FFT& transform) const noexcept
+{
+  const auto spectrumSize = (size_t)level.spectrumSize;
+
+  for (int ch = 0; ch < numBlockChannels; ++ch)
+  {
+    const float* spectra = level.spectra[juce::jmin(ch, numImpulseChannels - 1)];
+    const float* history = level.history[ch];
+    int entry = newest;
+
+    std::fill(accumulator, accumulator + spectrumSize, 0.0f);
+
+    for (int p = 0; p < level.numPartitions; ++p)
+    {
+      multiplyAccumulate(accumulator, history + (size_t)entry * spectrumSize, spectra + (size_t)p * spectrumSize,
+        level.spectrumSize / 2);
+      entry = entry == 0 ? level.historySize - 1 : entry - 1;
+    }
+
+    // Overlap-save: the second half is the block's output
+    std::copy(accumulator, accumulator + spectrumSize, transformBuffer);
+    transform.performRealOnlyInverseTransform(transformBuffer);
+    std::copy(transformBuffer + level.blockSize, transformBuffer + level.fftSize, destination[ch]);
+  }
+}
+
+//==============================================================================
+void CabinetConvolver::collectLateBlock(int numBlockChannels) noexcept
+{
+  if (due == Due::nothing)
+    return;
+
+  if (due == Due::workerSlot)
+  {
+    // Taken back if the worker hasn't started it, used if it has finished it
+    auto expected = packSlot(dueTicket, postedSlot);
+
+    if (!late.slotState[dueSlot].compare_exchange_strong(expected, packSlot(dueTicket, freeSlot),
+      std::memory_order_acquire) && expected == packSlot(dueTicket, doneSlot))
+    {
+      for (int ch = 0; ch < numBlockChannels; ++ch)
+        juce::FloatVectorOperations::copy(late.output[ch], late.slotOutput[dueSlot][ch], late.blockSize);
+
+      ++lateBlockStats.onWorker;
+      return;
+    }
+  }
+
+  // The block posted one boundary ago, for the entry before the newest
+  const int newest = progress->newest[1];
+  const int entry = newest == 0 ? late.historySize - 1 : newest - 1;
+
+  computeBlock(late, entry, late.output, numBlockChannels, late.transformBuffer, late.accumulator, late.transform);
+  ++lateBlockStats.onAudioThread;
+}
+
+void CabinetConvolver::postLateBlock(int numBlockChannels) noexcept
+{
+  dueSlot ^= 1;
+  auto& slotState = late.slotState[dueSlot];
+
+  // Still running a block from two boundaries ago: the worker is far behind
+  if ((slotState.load(std::memory_order_acquire) & 3) == runningSlot)
+  {
+    due = Due::audioThread;
+    return;
+  }
+
+  late.slotNewest[dueSlot] = progress->newest[1];
+  late.slotChannels[dueSlot] = numBlockChannels;
+  late.slotWrites[dueSlot] = late.writes.load(std::memory_order_relaxed);
+
+  dueTicket = ++nextTicket;
+  slotState.store(packSlot(dueTicket, postedSlot), std::memory_order_release);
+  due = Due::workerSlot;
+}
+
+void CabinetConvolver::runLateJobs() noexcept
+{
+  for (int slot = 0; slot < 2; ++slot)
+  {
+    auto& slotState = late.slotState[slot];
+    auto posted = slotState.load(std::memory_order_relaxed);
+
+    if ((posted & 3) != postedSlot)
+      continue;
+
+    const auto ticket = posted >> 2;
+
+    if (!slotState.compare_exchange_strong(posted, packSlot(ticket, runningSlot), std::memory_order_acquire))
+      continue;
+
+    computeBlock(late, late.slotNewest[slot], late.slotOutput[slot], late.slotChannels[slot],
+      late.workerTransformBuffer, late.workerAccumulator, late.workerTransform);
+
+    // The ring keeps the oldest entry the block read for historySize -
+    // numPartitions more writes; after that the result may be torn
+    std::atomic_thread_fence(std::memory_order_acquire);
+    const auto writesSince = late.writes.load(std::memory_order_relaxed) - late.slotWrites[slot];
+    const bool intact = writesSince <= (juce::uint32)(late.historySize - late.numPartitions);
+
+    slotState.store(packSlot(ticket, intact ? doneSlot : freeSlot), std::memory_order_release);
+  }
+}
@@ -0,0 +1,216 @@
+// cabinetConvolver.h
+
+#pragma once
+
+#include <JuceHeader.h>
+#include "DspArena.h"
+
+/**
+    A cabinet impulse response as read from a file, at the file's own rate. It is
+    never changed once loaded, so every engine built with it can share it; each
+    engine resamples it to its own rate when it is prepared.
+*/
+struct CabinetImpulse
+{
+  juce::AudioBuffer<float> samples;   // one channel, or two for a stereo cabinet
+  double sampleRate = 44100.0;
+  juce::String name;
+
+  static constexpr double maxSeconds = 2.0;
+
+  // Reads any of the basic formats (WAV, AIFF...), at most maxSeconds of it.
+  // Returns nullptr and says why if the file can't be used.
+  static std::shared_ptr<const CabinetImpulse> loadFromFile(const juce::File& file, juce::String& error);
+};
+
+/**
+    Zero-latency convolution with a cabinet impulse response, non-uniformly
+    partitioned:
+
+    - the first headLength taps run as a direct-form FIR, sample by sample;
+    - taps from headLength up to lateOffset run in FFT partitions of
+      earlyBlockSize, computed on the audio thread every earlyBlockSize samples;
+    - the rest runs in partitions of lateBlockSize, computed on a worker thread
+      shared by every convolver in the process. A late block posted when its input
+      is complete is only needed one block later, so the worker has a whole block
+      period for it.
+
+    The audio thread never waits for the worker: a late block that isn't done by
+    the time it is needed is computed on the audio thread instead (same arithmetic,
+    so the output doesn't depend on who computed it). That happens when the host's
+    blocks are longer than lateBlockSize or the worker falls behind.
+
+    Handles one or two channels. All state, the impulse's spectra and the buffers
+    come from the owner's DspArena; the impulse is resampled and normalised to unit
+    energy in prepare(), off the audio thread.
+*/
+class CabinetConvolver
+{
+public:
+  static constexpr int maxChannels = 2;
+
+  static constexpr int headLength = 64;
+  static constexpr int earlyBlockSize = 64;
+  static constexpr int lateBlockSize = 1024;
+  static constexpr int lateOffset = 2 * lateBlockSize;
+
+  CabinetConvolver();
+  ~CabinetConvolver();
+
+  // Resamples the impulse (nullptr for none) to sampleRate and works out the
+  // partitions, before allocate()
+  void prepare(const CabinetImpulse* impulse, double sampleRate, int numChannels);
+
+  // Takes the spectra, state and buffers from the owner's arena
+  void allocate(DspArena& arena);
+
+  // After the arena is built: transforms the impulse into it and starts taking
+  // worker jobs
+  void loadImpulse();
+
+  void reset() noexcept;
+
+  bool isActive() const noexcept { return impulseLength > 0; }
+  bool hasStereoImpulse() const noexcept { return numImpulseChannels > 1; }
+  int getImpulseLength() const noexcept { return impulseLength; }
+
+  // In place, any number of samples. Zero latency.
+  void process(const juce::dsp::AudioBlock<float>& block) noexcept;
+
+  // Makes one channel carry on exactly like another (mono impulse only: both
+  // channels convolve with the same taps)
+  void copyChannelState(int from, int to) noexcept;
+
+  // After the arena's contents were replaced (a State restore): work in flight
+  // is for the old contents, so the audio thread computes the next late block
+  void discardLateWork() noexcept;
+
+  // Late blocks since reset(), by who computed them (audio thread only)
+  struct LateBlockStats
+  {
+    int onWorker = 0;
+    int onAudioThread = 0;
+  };
+
+  const LateBlockStats& getLateBlockStats() const noexcept { return lateBlockStats; }
+
+private:
+  class Worker;
+
+  /** One uniformly partitioned part of the impulse (overlap-save, FFT size twice
+      the block size) with its frequency-domain delay line. Every block's output
+      comes from the newest history entry backwards, partition p with entry
+      newest - p. */
+  struct Level
+  {
+    Level(int blockSizeToUse, int firstTap, bool onWorker);
+
+    const int blockSize;
+    const int fftSize;
+    const int spectrumSize;   // floats: fftSize / 2 + 1 interleaved complex bins
+    const int offset;
+    const bool background;
+
+    int numPartitions = 0;
+    int historySize = 0;      // entries in the delay line
+
+    float* spectra[maxChannels] = {};   // per impulse channel: numPartitions spectra
+    float* history[maxChannels] = {};   // historySize spectra
+    float* input[maxChannels] = {};     // the last two blocks of input
+    float* output[maxChannels] = {};    // this block's output
+    float* transformBuffer = nullptr;   // 2 * fftSize, audio thread
+    float* accumulator = nullptr;       // spectrumSize, audio thread
+
+    juce::dsp::FFT transform;
+
+    // Worker side: its own buffers and transform, and two job slots. A slot's
+    // state is its job's ticket times four plus the Slot value.
+    float* slotOutput[2][maxChannels] = {};
+    float* workerTransformBuffer = nullptr;
+    float* workerAccumulator = nullptr;
+    juce::dsp::FFT workerTransform;
+
+    std::atomic<juce::uint32> slotState[2]{};
+    int slotNewest[2] = {};
+    int slotChannels[2] = {};
+    juce::uint32 slotWrites[2] = {};
+
+    // History writes so far, counted before each one. A job whose oldest entry
+    // got overwritten while it ran throws its result away.
+    std::atomic<juce::uint32> writes{ 0 };
+  };
+
+  enum Slot : juce::uint32
+  {
+    freeSlot,
+    postedSlot,
+    runningSlot,
+    doneSlot
+  };
+
+  // What the late level's next block comes from
+  enum class Due
+  {
+    nothing,   // silence since reset
+    audioThread,
+    workerSlot
+  };
+
+  // Audio-thread progress, in the arena: position in each level's block and its
+  // newest history entry
+  struct Progress
+  {
+    int position[2];
+    int newest[2];
+  };
+
+  void allocateLevel(DspArena& arena, Level& level);
+  void loadLevel(Level& level, const juce::AudioBuffer<float>& taps);
+
+  // A whole block of input is in: into the history, and the next block's output
+  void completeBlock(Level& level, int levelIndex, int numBlockChannels) noexcept;
+
+  // Sum over the partitions for the history entry newest, into destination
+  void computeBlock(const Level& level, int newest, float* const* destination, int numBlockChannels,
+    float* transformBuffer, float* accumulator, const juce::dsp::FFT& transform) const noexcept;
+
+  // Late level: takes the block that is due now, then hands the next to the worker
+  void collectLateBlock(int numBlockChannels) noexcept;
+  void postLateBlock(int numBlockChannels) noexcept;
+
+  // Worker thread: runs any job posted to this convolver
+  void runLateJobs() noexcept;
+
+  void processChunk(float* samples, int numSamples, int channel) noexcept;
+
+  static juce::uint32 packSlot(juce::uint32 ticket, Slot slot) noexcept { return (ticket << 2) | slot; }
+
+  juce::SharedResourcePointer<Worker> worker;
+  bool registered = false;
+
+  Level levels[2]{ { earlyBlockSize, headLength, false }, { lateBlockSize, lateOffset, true } };
+  Level& early = levels[0];
+  Level& late = levels[1];
+
+  int numChannels = 0;
+  int numImpulseChannels = 0;
+  int impulseLength = 0;
+  int headTaps = 0;
+
+  // The impulse at the engine's rate, between prepare() and loadImpulse()
+  juce::AudioBuffer<float> resampled;
+
+  Progress* progress = nullptr;
+  float* head[maxChannels] = {};          // per impulse channel: the first taps
+  float* headHistory[maxChannels] = {};   // headLength - 1 past samples, then the chunk
+
+  // Audio thread: the late block due next and the slot it was posted to (the
+  // next one goes to the other)
+  Due due = Due::nothing;
+  int dueSlot = 0;
+  juce::uint32 dueTicket = 0;
+  juce::uint32 nextTicket = 0;
+  LateBlockStats lateBlockStats;
+
+  JUCE_DECLARE_NON_COPYABLE(CabinetConvolver)
+};
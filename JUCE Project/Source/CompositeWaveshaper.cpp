@@ -0,0 +1,228 @@
+// compositeWaveshaper.cpp
+
+#include "CompositeWaveshaper.h"
+
+void CompositeWaveshaper::allocate(DspArena& arena)
+{
+  progress = arena.allocate<Progress>(1, "composite build");
+  cells = arena.allocate<Cell>(numCells, "composite cells");
+  nodes = arena.allocate<Node>(maxNodes, "composite nodes");
+  midpoints = arena.allocate<Node>((size_t)1 << maxDepth, "composite midpoints");
+}
+
+void CompositeWaveshaper::setStages(const KorenTriodeModel::Stage* stages, int numStages) noexcept
+{
+  if (progress == nullptr)
+    return;
+
+  auto& state = *progress;
+  state = Progress();
+  state.numStages = juce::jlimit(0, maxStages, numStages);
+
+  for (int n = 0; n < state.numStages; ++n)
+  {
+    state.stages[(size_t)n] = stages[n];
+    state.plate[(size_t)n] = stages[n].B_plus;
+  }
+
+  // Output units are the last plate's volts scaled by its gain
+  if (state.numStages > 0)
+    state.tolerance = tolerance * stages[state.numStages - 1].gainVal / 300.0f;
+
+  state.failed = !(state.tolerance > 0.0f);
+}
+
+CompositeWaveshaper::Node CompositeWaveshaper::evaluate(const Progress& state, double x, double* plate) noexcept
+{
+  double value = x;
+  double slope = 1.0;
+
+  for (int n = 0; n < state.numStages; ++n)
+  {
+    double stageSlope = 0.0;
+    value = KorenTriodeModel::processSamplePrecise(value, state.stages[(size_t)n], plate[n], stageSlope);
+    slope *= stageSlope;
+  }
+
+  return { (float)value, (float)slope };
+}
+
+//==============================================================================
+bool CompositeWaveshaper::buildSome(int maxEvaluations) noexcept
+{
+  if (progress == nullptr)
+    return false;
+
+  auto& state = *progress;
+
+  if (state.numStages == 0)
+    return false;
+
+  for (int evaluations = 0; evaluations < maxEvaluations && !state.ready && !state.failed;)
+  {
+    if (state.depth < 0)
+    {
+      beginCell();
+      evaluations += 2;
+      continue;
+    }
+
+    const int numSegments = 1 << state.depth;
+
+    if (state.segment == numSegments)
+    {
+      endPass();
+      continue;
+    }
+
+    // Each midpoint checks the spline of its segment, and is the segment's new
+    // middle node if any check fails. Half the tolerance at the midpoint leaves
+    // room for the rest of the segment and the float lookup.
+    const double h = cellWidth / numSegments;
+    const double cellStart = -inputRange + state.cell * cellWidth;
+    const Node* cellNodes = nodes + state.usedNodes;
+    const int segment = state.segment++;
+
+    const Node& a = cellNodes[segment];
+    const Node& b = cellNodes[segment + 1];
+    const Node mid = evaluate(state, cellStart + (segment + 0.5) * h, state.plate.data());
+    ++evaluations;
+
+    const double spline = 0.5 * ((double)a.value + b.value) + 0.125 * h * ((double)a.slope - b.slope);
+    if (std::abs(spline - mid.value) > 0.5 * state.tolerance)
+      state.refine = true;
+
+    midpoints[segment] = mid;
+  }
+
+  return state.ready;
+}
+
+void CompositeWaveshaper::beginCell() noexcept
+{
+  auto& state = *progress;
+
+  if (state.usedNodes + 2 > maxNodes)
+  {
+    state.failed = true;
+    return;
+  }
+
+  const double cellStart = -inputRange + state.cell * cellWidth;
+  Node* cellNodes = nodes + state.usedNodes;
+  cellNodes[0] = evaluate(state, cellStart, state.plate.data());
+  cellNodes[1] = evaluate(state, cellStart + cellWidth, state.plate.data());
+
+  state.depth = 0;
+  state.segment = 0;
+  state.refine = false;
+}
+
+void CompositeWaveshaper::endPass() noexcept
+{
+  auto& state = *progress;
+  const int numSegments = 1 << state.depth;
+  Node* cellNodes = nodes + state.usedNodes;
+
+  if (!state.refine)
+  {
+    // Slopes per segment from here on, so a lookup needs no cell width
+    const float h = (float)(cellWidth / numSegments);
+    for (int i = 0; i <= numSegments; ++i)
+      cellNodes[i].slope *= h;
+
+    cells[state.cell] = { state.usedNodes, (float)numSegments };
+    state.usedNodes += numSegments + 1;
+    state.depth = -1;
+
+    if (++state.cell == numCells)
+      state.ready = true;
+
+    return;
+  }
+
+  if (state.depth == maxDepth || state.usedNodes + 2 * numSegments + 1 > maxNodes)
+  {
+    state.failed = true;
+    return;
+  }
+
+  // Twice the segments: the nodes move to the even places (from the back, so
+  // nothing is overwritten before it is moved), the midpoints fill the odd ones
+  for (int i = numSegments; i > 0; --i)
+    cellNodes[2 * i] = cellNodes[i];
+
+  for (int i = 0; i < numSegments; ++i)
+    cellNodes[2 * i + 1] = midpoints[i];
+
+  ++state.depth;
+  state.segment = 0;
+  state.refine = false;
+}
+
+//==============================================================================
+float CompositeWaveshaper::lookup(float x) const noexcept
+{
+  // The position in double: on the steepest curves a float's rounding of
+  // x + inputRange alone is worth a few millivolts at the plate
+  const double u = ((double)x + inputRange) * (1.0 / cellWidth);
+
+  // Outside the table: on along the end node's tangent (slopes are per segment)
+  if (!(u >= 0.0))
+  {
+    const Node& first = nodes[cells[0].firstNode];
+    return first.value + (float)(u * cells[0].numSegments) * first.slope;
+  }
+
+  if (u >= (double)numCells)
+  {
+    const Cell& cell = cells[numCells - 1];
+    const Node& last = nodes[cell.firstNode + (int)cell.numSegments];
+    return last.value + (float)((u - numCells) * cell.numSegments) * last.slope;
+  }
+
+  const int c = (int)u;
+  const Cell cell = cells[c];
+  const double s = (u - c) * cell.numSegments;
+  const int segment = juce::jmin((int)s, (int)cell.numSegments - 1);
+  const float t = (float)(s - segment);
+
+  const Node& a = nodes[cell.firstNode + segment];
+  const Node& b = nodes[cell.firstNode + segment + 1];
+  const float dy = b.value - a.value;
+
+  return a.value + t * (a.slope + t * (3.0f * dy - 2.0f * a.slope - b.slope
+    + t * (a.slope + b.slope - 2.0f * dy)));
+}
+
+void CompositeWaveshaper::processAudioBlock(const juce::dsp::AudioBlock<float>& block) const noexcept
+{
+  const auto numChannels = block.getNumChannels();
+  const auto numSamples = block.getNumSamples();
+
+  for (size_t ch = 0; ch < numChannels; ++ch)
+  {
+    float* data = block.getChannelPointer(ch);
+
+    for (size_t i = 0; i < numSamples; ++i)
+      data[i] = lookup(data[i]);
+  }
+}
+
+void CompositeWaveshaper::processAudioBlock(const juce::dsp::AudioBlock<float>& block,
+  const CompositeWaveshaper& from, const CompositeWaveshaper& to, float weight) noexcept
+{
+  const auto numChannels = block.getNumChannels();
+  const auto numSamples = block.getNumSamples();
+
+  for (size_t ch = 0; ch < numChannels; ++ch)
+  {
+    float* data = block.getChannelPointer(ch);
+
+    for (size_t i = 0; i < numSamples; ++i)
+    {
+      const float y = from.lookup(data[i]);
+      data[i] = y + weight * (to.lookup(data[i]) - y);
+    }
+  }
+}
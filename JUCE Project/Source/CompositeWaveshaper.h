@@ -0,0 +1,118 @@
+// compositeWaveshaper.h
+
+#pragma once
+
+#include <JuceHeader.h>
+#include "KorenTriodeModel.h"
+#include "DspArena.h"
+
+/**
+    Consecutive memoryless triode stages as one static curve.
+
+    Stages 1-4 have no filtering in between, so for a given drive and bias they
+    are a single function of the chain input. This tabulates the converged
+    composition on [-inputRange, inputRange] as a cubic Hermite spline (value and
+    slope at every node). The range is split into numCells cells and each cell
+    into 2^depth equal segments, with the depth as low as keeps the spline within
+    tolerance of the converged stages at every segment's midpoint: the flat,
+    saturated parts take a few nodes, the steep transitions many. A lookup is an
+    index computation and one cubic; inputs outside the range carry on along the
+    tangent at the table's end, where the chain is long saturated.
+
+    A build takes a few thousand stage solves, so it runs in slices (buildSome)
+    and the owner keeps using the separate stages until isReady(). The table, the
+    build progress and the stage settings all live in a DspArena.
+*/
+class CompositeWaveshaper
+{
+public:
+  static constexpr int maxStages = 4;
+
+  // Chain input covered by the table (+6 dBFS)
+  static constexpr float inputRange = 2.0f;
+
+  // Largest spline error, in volts at the last stage's plate (as the small-signal
+  // expansion's, see KorenTriodeModel::smallSignalTolerance)
+  static constexpr float tolerance = 1.0e-3f;
+
+  static constexpr int numCells = 64;
+  static constexpr int maxDepth = 10;
+  static constexpr int maxNodes = 2048;
+
+  void allocate(DspArena& arena);
+
+  // Drops the table and starts building one for these stages, applied in order
+  void setStages(const KorenTriodeModel::Stage* stages, int numStages) noexcept;
+
+  // Does at most maxEvaluations evaluations of the stages towards the table.
+  // Returns true once the table is ready.
+  bool buildSome(int maxEvaluations) noexcept;
+
+  bool isReady() const noexcept { return progress != nullptr && progress->ready; }
+
+  // Neither ready nor given up on (too steep) yet
+  bool isBuilding() const noexcept
+  {
+    return progress != nullptr && progress->numStages > 0 && !progress->ready && !progress->failed;
+  }
+
+  // Nodes in the finished table, for reporting
+  int getNumNodes() const noexcept { return progress != nullptr ? progress->usedNodes : 0; }
+
+  // Runs the composed stages on the block, in place. Only once isReady().
+  void processAudioBlock(const juce::dsp::AudioBlock<float>& block) const noexcept;
+
+  // Two curves (e.g. for two bias settings) blended: from + weight * (to - from).
+  // Both have to be ready.
+  static void processAudioBlock(const juce::dsp::AudioBlock<float>& block, const CompositeWaveshaper& from,
+    const CompositeWaveshaper& to, float weight) noexcept;
+
+private:
+  struct Node
+  {
+    float value = 0.0f;
+    float slope = 0.0f;   // per input unit while building, per segment once the cell is done
+  };
+
+  struct Cell
+  {
+    int firstNode = 0;
+    float numSegments = 1.0f;
+  };
+
+  struct Progress
+  {
+    std::array<KorenTriodeModel::Stage, maxStages> stages;
+    int numStages = 0;
+    float tolerance = 0.0f;   // in output units
+
+    int cell = 0;             // cell being built
+    int depth = -1;           // its depth being tried, -1 before its end nodes
+    int segment = 0;          // next midpoint to evaluate at that depth
+    bool refine = false;      // a midpoint so far was off
+    int usedNodes = 0;        // nodes of the finished cells
+    bool ready = false;
+    bool failed = false;      // too steep for the table: stay on the separate stages
+
+    std::array<double, maxStages> plate;   // warm start of each stage's solve
+  };
+
+  static constexpr double cellWidth = 2.0 * inputRange / numCells;
+
+  // The composed stages at x, converged, with their slope
+  static Node evaluate(const Progress& state, double x, double* plate) noexcept;
+
+  // Starts the current cell with its two end nodes
+  void beginCell() noexcept;
+
+  // Done with the current depth: keep the cell, or halve its segments
+  void endPass() noexcept;
+
+  // The curve at x
+  float lookup(float x) const noexcept;
+
+  Progress* progress = nullptr;
+  Cell* cells = nullptr;
+  Node* nodes = nullptr;
+  Node* midpoints = nullptr;   // of the pass being evaluated
+};
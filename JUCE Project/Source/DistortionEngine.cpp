@@ -1,79 +1,404 @@
 // distortionEngine.cpp
 
 #include "DistortionEngine.h"
+#include "MakeupGain.h"
 
-void DistortionEngine::prepare(const juce::dsp::ProcessSpec& spec, int oversamplingFactor)
+namespace
 {
-  oversampler = std::make_unique<juce::dsp::Oversampling<float>>
-    ((int)spec.numChannels,
-      (uint32_t)oversamplingFactor,
-      juce::dsp::Oversampling<float>::filterHalfBandPolyphaseIIR);
+  // DC high-pass corner. Like the tone stack's corners, this is where it has
+  // always been heard (20 Hz designed at the host rate, run at 2x).
+  constexpr float highPassFrequency = 40.0f;
 
-  oversampler->initProcessing((size_t)spec.maximumBlockSize);
+  // How long both channels have to be identical before one channel can stand in
+  // for both: the DC high-pass, the slowest filter in the chain (4 ms time
+  // constant), has then decayed to float rounding
+  constexpr double monoSettleSeconds = 0.1;
+
+  // Least time between two small-signal refits (a dozen or more double solves
+  // each), so a knob move doesn't put one in every sub-block
+  constexpr double smallSignalRefitSeconds = 0.005;
+
+  // Multiband crossover: each band is two Butterworth sections (LR4), the highest
+  // crossover a fraction of the host rate
+  constexpr float crossoverQ = 0.70710678f;
+  constexpr double maxCrossoverRatio = 0.25;
+
+  // Oversampling level each triode stage runs at, by cap (the prepared factor:
+  // 2x, 4x, 8x, 16x) and drive, at a 44.1 kHz host rate. Measured with the tools'
+  // alias-scan command: every stage is as low as it goes while the aliasing
+  // stays within 0.5 dB of running everything at the cap, worst case over the
+  // bias range, and never below the cap under it. A drive between two rows uses
+  // the higher level of the two. A host rate twice as high uses the next cap's
+  // row, one level lower.
+  constexpr float planReferenceRate = 44100.0f;
+  constexpr float planDrives[] = { 0.25f, 0.375f, 0.5f, 0.625f, 0.75f, 0.875f, 1.0f };
+  constexpr int planMaxCap = 4;
+  constexpr int planLevels[planMaxCap][std::size(planDrives)][DistortionEngine::numTriodeStages] =
+  {
+  {   // 2x
+    { 1, 1, 1, 1, 0 },
+    { 1, 1, 1, 1, 0 },
+    { 1, 1, 1, 1, 0 },
+    { 1, 1, 1, 1, 0 },
+    { 1, 1, 1, 1, 1 },
+    { 1, 1, 1, 1, 1 },
+    { 1, 1, 1, 1, 1 },
+  },
+  {   // 4x
+    { 2, 2, 2, 2, 2 },
+    { 2, 1, 1, 1, 0 },
+    { 2, 1, 1, 1, 0 },
+    { 2, 1, 1, 1, 0 },
+    { 2, 2, 2, 2, 2 },
+    { 2, 1, 1, 1, 1 },
+    { 2, 1, 1, 1, 1 },
+  },
+  {   // 8x
+    { 3, 3, 2, 2, 2 },
+    { 3, 2, 2, 1, 0 },
+    { 3, 3, 3, 3, 0 },
+    { 3, 1, 1, 1, 1 },
+    { 3, 3, 3, 3, 3 },
+    { 3, 2, 2, 2, 2 },
+    { 3, 2, 2, 2, 2 },
+  },
+  {   // 16x
+    { 3, 3, 2, 2, 2 },
+    { 4, 4, 4, 4, 4 },
+    { 4, 3, 3, 3, 0 },
+    { 4, 1, 1, 1, 1 },
+    { 4, 4, 4, 4, 4 },
+    { 4, 4, 4, 4, 4 },
+    { 4, 3, 3, 3, 3 },
+  }
+  };
+}
+
+void DistortionEngine::prepare(const juce::dsp::ProcessSpec& hostSpec, int oversamplingFactor,
+  HalfBandOversampler::Phase phase)
+{
+  numChannels = juce::jlimit(1, maxChannels, (int)hostSpec.numChannels);
+  hostSampleRate = hostSpec.sampleRate;
+
+  // Everything inside runs on sub-blocks, so it is sized for those and not for
+  // the host's maximum block size
+  const juce::dsp::ProcessSpec spec{ hostSpec.sampleRate, (juce::uint32)subBlockSize, (juce::uint32)numChannels };
+
+  oversampler.configure(oversamplingFactor, (size_t)spec.maximumBlockSize, phase);
+  latencySamples = juce::roundToInt(oversampler.getLatencyInSamples());
+
+  compensateDry = phase == HalfBandOversampler::Phase::linearPhase && latencySamples > 0;
+  dryDelayLength = compensateDry ? latencySamples : 0;
 
   toneStack.prepare(spec);
+  biasDrift.prepare(hostSpec.sampleRate);
+  cabinet.prepare(cabinetImpulse.get(), hostSpec.sampleRate, numChannels);
 
-  // Prepare the highPassFilters internal states
-  highPassFilter.prepare(spec);
-  highPassFilter.reset();
-  *highPassFilter.state = *juce::dsp::IIR::Coefficients<float>::makeHighPass(spec.sampleRate, 20.0f);
+  // Multiband: the low band's oversampler is never above the main one, and its
+  // output waits for the main chain's
+  lowBandSplit = lowBandParam.crossoverHz > 0.0f;
+  lowOversampler.configure(lowBandSplit ? juce::jlimit(0, oversampler.getNumStages(), lowBandParam.oversamplingFactor) : 0,
+    (size_t)spec.maximumBlockSize, phase);
+  lowDelayLength = lowBandSplit
+    ? juce::jmax(0, juce::roundToInt(oversampler.getLatencyInSamples() - lowOversampler.getLatencyInSamples()))
+    : 0;
+
+  if (lowBandSplit)
+    lowToneStack.prepare(spec);
+
+  // One allocation for the whole engine, in the order the audio thread touches
+  // things most: filter coefficients and state, then the block-sized buffers
+  arena.build([this](DspArena& memory)
+  {
+    highPassFilter.allocate(memory, numChannels, "high-pass filter");
+    toneStack.allocate(memory);
+    biasDrift.allocate(memory);
+
+    for (auto& composite : composites)
+      composite.allocate(memory);
+
+    oversampler.allocate(memory);
+    cabinet.allocate(memory);
+
+    if (lowBandSplit)
+    {
+      for (int section = 0; section < 2; ++section)
+      {
+        crossoverLow[section].allocate(memory, numChannels, "crossover low");
+        crossoverHigh[section].allocate(memory, numChannels, "crossover high");
+      }
+
+      lowToneStack.allocate(memory);
+      lowComposite.allocate(memory);
+      lowOversampler.allocate(memory);
+    }
+
+    const size_t accumulateSize = accumulateBlocks ? (size_t)subBlockSize : 0;
+
+    for (int ch = 0; ch < numChannels; ++ch)
+    {
+      dryBuffer[ch] = memory.allocate<float>((size_t)subBlockSize, "dry buffer");
+      accumulateIn[ch] = memory.allocate<float>(accumulateSize, "accumulation input");
+      accumulateOut[ch] = memory.allocate<float>(accumulateSize, "accumulation output");
+      dryDelayLine[ch] = memory.allocate<float>((size_t)dryDelayLength, "dry delay");
+      lowBandBuffer[ch] = memory.allocate<float>(lowBandSplit ? (size_t)subBlockSize : 0, "low band");
+      lowDelayLine[ch] = memory.allocate<float>((size_t)lowDelayLength, "low band delay");
+    }
+  });
+
+  // The highPassFilter's coefficients
+  highPassFilter.setCoefficients(juce::dsp::IIR::ArrayCoefficients<float>::makeHighPass(spec.sampleRate, highPassFrequency));
+  cabinet.loadImpulse();
+
+  if (lowBandSplit)
+  {
+    const float crossover = (float)juce::jmin((double)lowBandParam.crossoverHz, maxCrossoverRatio * spec.sampleRate);
+
+    for (int section = 0; section < 2; ++section)
+    {
+      crossoverLow[section].setCoefficients(juce::dsp::IIR::ArrayCoefficients<float>::makeLowPass(spec.sampleRate, crossover, crossoverQ));
+      crossoverHigh[section].setCoefficients(juce::dsp::IIR::ArrayCoefficients<float>::makeHighPass(spec.sampleRate, crossover, crossoverQ));
+    }
+  }
+
+  lowStagesDrive = -1.0f;
+  accumulatedSamples = 0;
+  // Linked channels share a mono cabinet too, so its tail has to die out as well
+  monoSettleSamples = (int)std::ceil(monoSettleSeconds * hostSpec.sampleRate)
+    + (cabinet.hasStereoImpulse() ? 0 : cabinet.getImpulseLength());
+
+  // The plan depends on the rate and factor, make the next sub-block pick it again
+  stagesDrive = -1.0f;
+  ratePlan = makeValidPlan(useFixedPlan ? fixedPlan : choosePlan(driveParam));
+
+  if (accumulateBlocks)
+    latencySamples += subBlockSize;
+}
 
-  // Pre-allocate the dryBuffer at the max size,
-  // so we can re-use it without new allocations:
-  dryBuffer.setSize((int)spec.numChannels, (int)spec.maximumBlockSize);
+int DistortionEngine::computeLatencyInSamples(int oversamplingFactor, HalfBandOversampler::Phase phase,
+  bool accumulateBlocks)
+{
+  HalfBandOversampler filters;
+  filters.configure(oversamplingFactor, (size_t)subBlockSize, phase);
+  return juce::roundToInt(filters.getLatencyInSamples()) + (accumulateBlocks ? subBlockSize : 0);
 }
 
 void DistortionEngine::reset()
 {
-  if (oversampler)
-    oversampler->reset();
+  oversampler.reset();
+
+  for (int ch = 0; ch < numChannels; ++ch)
+  {
+    if (accumulateBlocks)
+    {
+      std::fill(accumulateIn[ch], accumulateIn[ch] + subBlockSize, 0.0f);
+      std::fill(accumulateOut[ch], accumulateOut[ch] + subBlockSize, 0.0f);
+    }
+
+    if (dryDelayLength > 0)
+      std::fill(dryDelayLine[ch], dryDelayLine[ch] + dryDelayLength, 0.0f);
+  }
+
+  accumulatedSamples = 0;
+  dryDelayPosition = 0;
+  channelsLinked = false;
+  identicalSamples = 0;
 
   toneStack.reset();
   highPassFilter.reset();
+  cabinet.reset();
+
+  if (lowBandSplit)
+  {
+    for (int section = 0; section < 2; ++section)
+    {
+      crossoverLow[section].reset();
+      crossoverHigh[section].reset();
+    }
+
+    lowOversampler.reset();
+    lowToneStack.reset();
+
+    for (int ch = 0; ch < numChannels; ++ch)
+      std::fill(lowDelayLine[ch], lowDelayLine[ch] + lowDelayLength, 0.0f);
+  }
+
+  lowDelayPosition = 0;
+
+  // From the start of the seed's drift, with the curves for its first targets
+  biasDrift.reset(driftSeed);
+
+  if (isDrifting())
+    stagesDrift = -1.0f;
+}
+
+void DistortionEngine::saveState(State& state) const
+{
+  state.arena.assign(arena.getData(), arena.getData() + arena.getSize());
+
+  state.drive = driveParam;
+  state.bias = biasParam;
+  state.mix = mixParam;
+  state.drift = driftParam;
+  state.midSide = midSideParam;
+  state.sideEconomy = sideEconomyParam;
+
+  state.stages = stages;
+  state.smallSignal = smallSignal;
+  state.smallSignalFitted = smallSignalFitted;
+  state.smallSignalRefitWait = smallSignalRefitWait;
+  state.stagesDrive = stagesDrive;
+  state.stageBias = stageBias;
+  state.stagesBias = stagesBias;
+  state.stagesDrift = stagesDrift;
+  state.sideBypassGain = sideBypassGain;
+  state.sideBypassInOffset = sideBypassInOffset;
+  state.sideBypassOutOffset = sideBypassOutOffset;
+  state.sideBypassValid = sideBypassValid;
+  state.toneStackDrive = toneStack.getCoefficientsDrive();
+  state.toneStackRate = toneStack.getCoefficientsRate();
+  state.ratePlan = ratePlan;
+
+  state.lowBand = lowBandParam;
+  state.lowStages = lowStages;
+  state.lowSmallSignal = lowSmallSignal;
+  state.lowStandInGain = lowStandIn.gain;
+  state.lowStandInInOffset = lowStandIn.inOffset;
+  state.lowStandInOutOffset = lowStandIn.outOffset;
+  state.lowStagesDrive = lowStagesDrive;
+  state.lowStagesBias = lowStagesBias;
+  state.lowStagesCount = lowStagesCount;
+  state.lowBandGain = lowBandGain;
+  state.lowBandOffset = lowBandOffset;
+  state.lowGainDrive = lowGainDrive;
+  state.lowGainBias = lowGainBias;
+  state.lowToneStackDrive = lowToneStack.getCoefficientsDrive();
+  state.lowToneStackRate = lowToneStack.getCoefficientsRate();
+  state.lowDelayPosition = lowDelayPosition;
+
+  state.channelsLinked = channelsLinked;
+  state.identicalSamples = identicalSamples;
+
+  state.accumulatedSamples = accumulatedSamples;
+  state.accumulateSwapped = accumulateSwapped;
+  state.dryDelayPosition = dryDelayPosition;
 }
 
-void DistortionEngine::encodeToMS(juce::AudioBuffer<float>& buffer)
+bool DistortionEngine::restoreState(const State& state)
 {
-  const int numChannels = buffer.getNumChannels();
-  if (numChannels < 2) return;
+  if (state.arena.size() != arena.getSize())
+    return false;
+
+  // The arena holds everything else: coefficients, filter and oversampler state, buffers
+  std::copy(state.arena.begin(), state.arena.end(), arena.getData());
+
+  driveParam = state.drive;
+  biasParam = state.bias;
+  mixParam = state.mix;
+  driftParam = state.drift;
+  midSideParam = state.midSide;
+  sideEconomyParam = state.sideEconomy;
+
+  stages = state.stages;
+  smallSignal = state.smallSignal;
+  smallSignalFitted = state.smallSignalFitted;
+  smallSignalRefitWait = state.smallSignalRefitWait;
+  stagesDrive = state.stagesDrive;
+  stageBias = state.stageBias;
+  stagesBias = state.stagesBias;
+  stagesDrift = state.stagesDrift;
+  sideBypassGain = state.sideBypassGain;
+  sideBypassInOffset = state.sideBypassInOffset;
+  sideBypassOutOffset = state.sideBypassOutOffset;
+  sideBypassValid = state.sideBypassValid;
+  toneStack.setCoefficientsDrive(state.toneStackDrive);
+  toneStack.setCoefficientsRate(state.toneStackRate);
+  ratePlan = state.ratePlan;
 
-  int numSamples = buffer.getNumSamples();
-  for (int i = 0; i < numSamples; ++i)
+  // The crossover and factor came with the layout; the rest is per block
+  lowBandParam = state.lowBand;
+  lowStages = state.lowStages;
+  lowSmallSignal = state.lowSmallSignal;
+  lowStandIn = { state.lowStandInGain, state.lowStandInInOffset, state.lowStandInOutOffset };
+  lowStagesDrive = state.lowStagesDrive;
+  lowStagesBias = state.lowStagesBias;
+  lowStagesCount = state.lowStagesCount;
+  lowBandGain = state.lowBandGain;
+  lowBandOffset = state.lowBandOffset;
+  lowGainDrive = state.lowGainDrive;
+  lowGainBias = state.lowGainBias;
+  lowToneStack.setCoefficientsDrive(state.lowToneStackDrive);
+  lowToneStack.setCoefficientsRate(state.lowToneStackRate);
+  lowDelayPosition = state.lowDelayPosition;
+
+  // Byte-copied accumulation buffers only line up if the in/out roles do too
+  if (accumulateSwapped != state.accumulateSwapped)
   {
-    float L = buffer.getSample(0, i);
-    float R = buffer.getSample(1, i);
-    float M = 0.5f * (L + R);
-    float S = 0.5f * (L - R);
-    buffer.setSample(0, i, M);
-    buffer.setSample(1, i, S);
+    std::swap(accumulateIn, accumulateOut);
+    accumulateSwapped = state.accumulateSwapped;
   }
+
+  channelsLinked = state.channelsLinked;
+  identicalSamples = state.identicalSamples;
+
+  accumulatedSamples = state.accumulatedSamples;
+  dryDelayPosition = state.dryDelayPosition;
+
+  // The cabinet's worker may be on a block of the contents just replaced
+  cabinet.discardLateWork();
+  return true;
+}
+
+juce::String DistortionEngine::getMemoryReport() const
+{
+  juce::String report;
+  report << "DistortionEngine object: " << (int)sizeof(*this) << " bytes\n";
+  report << arena.getReport();
+  report << "total: " << (int)getMemoryFootprint() << " bytes\n";
+  return report;
 }
 
-void DistortionEngine::decodeFromMS(juce::AudioBuffer<float>& buffer)
+void DistortionEngine::encodeToMS(const juce::dsp::AudioBlock<float>& block)
 {
-  const int numChannels = buffer.getNumChannels();
-  if (numChannels < 2) return;
+  if (block.getNumChannels() < 2) return;
+
+  // Raw channel pointers and no per-sample accessors, so this loop vectorises
+  float* left = block.getChannelPointer(0);
+  float* right = block.getChannelPointer(1);
+  const auto numSamples = block.getNumSamples();
 
-  int numSamples = buffer.getNumSamples();
-  for (int i = 0; i < numSamples; ++i)
+  for (size_t i = 0; i < numSamples; ++i)
   {
-    float M = buffer.getSample(0, i);
-    float S = buffer.getSample(1, i);
+    const float L = left[i];
+    const float R = right[i];
+    left[i] = 0.5f * (L + R);   // M
+    right[i] = 0.5f * (L - R);  // S
+  }
+}
+
+void DistortionEngine::decodeFromMS(const juce::dsp::AudioBlock<float>& block)
+{
+  if (block.getNumChannels() < 2) return;
 
-    float L = M + S;
-    float R = M - S;
+  float* mid = block.getChannelPointer(0);
+  float* side = block.getChannelPointer(1);
+  const auto numSamples = block.getNumSamples();
 
-    buffer.setSample(0, i, L);
-    buffer.setSample(1, i, R);
+  for (size_t i = 0; i < numSamples; ++i)
+  {
+    const float M = mid[i];
+    const float S = side[i];
+    mid[i] = M + S;   // L
+    side[i] = M - S;  // R
   }
 }
 
-void DistortionEngine::applyTriodeStages(float sampleRate, juce::dsp::AudioBlock<float>& oversampledBlock,
-  float drive, float bias)
+std::array<KorenTriodeModel::Stage, 5> DistortionEngine::makeStages(float drive, float bias)
 {
+  std::array<KorenTriodeModel::Stage, 5> table;
+
   // Stage 1 12AX7
-  KorenTriodeModel::processAudioBlock(
-    oversampledBlock,
+  table[0] = {
     /* gainVal   */ 0.3f,
     /* bias      */ 0.0f,
     /* drive     */ 1.0f + (drive * 60.0f),
@@ -83,12 +408,10 @@ void DistortionEngine::applyTriodeStages(float sampleRate, juce::dsp::AudioBlock
     /* P         */ 1.5f,
     /* B_plus    */ 200.0f,
     /* Rp        */ 130000.0f
-    // maxIter + tol using defaults
-  );
+  };
 
   // Stage 2 12AX7
-  KorenTriodeModel::processAudioBlock(
-    oversampledBlock,
+  table[1] = {
     /* gainVal   */ 0.3f,
     /* bias      */  1.25f * bias,
     /* drive     */ 1.0f + (drive * 40.0f),
@@ -98,11 +421,10 @@ void DistortionEngine::applyTriodeStages(float sampleRate, juce::dsp::AudioBlock
     /* P         */ 1.5f,
     /* B_plus    */ 300.0f,
     /* Rp        */ 200000.0f
-  );
+  };
 
   // Stage 3 12AT7
-  KorenTriodeModel::processAudioBlock(
-    oversampledBlock,
+  table[2] = {
     /* gainVal   */ drive * 0.65f,
     /* bias      */ -1.35f * bias,
     /* drive     */ 1.0f + (drive * 30.0f),
@@ -112,11 +434,10 @@ void DistortionEngine::applyTriodeStages(float sampleRate, juce::dsp::AudioBlock
     /* P         */ 1.5f,
     /* B_plus    */ 350.0f,
     /* Rp        */ 160000.0f
-  );
+  };
 
   // Stage 4 12AT7
-  KorenTriodeModel::processAudioBlock(
-    oversampledBlock,
+  table[3] = {
     /* gainVal   */ drive * 0.55f,
     /* bias      */ 1.5f * bias,
     /* drive     */ 1.0f + (drive * 30.0f),
@@ -126,15 +447,10 @@ void DistortionEngine::applyTriodeStages(float sampleRate, juce::dsp::AudioBlock
     /* P         */ 1.5f,
     /* B_plus    */ 400.0f,
     /* Rp        */ 120000.0f
-  );
-
-  // Tone stack in between
-  toneStack.setDrive(drive);
-  toneStack.processAudioBlock(sampleRate, oversampledBlock);
+  };
 
   // Stage 5 12AU7
-  KorenTriodeModel::processAudioBlock(
-    oversampledBlock,
+  table[4] = {
     /* gainVal   */ 0.5f,
     /* bias      */ -1.25f * bias,
     /* drive     */ 1.0f + (drive * 20.0f),
@@ -144,42 +460,737 @@ void DistortionEngine::applyTriodeStages(float sampleRate, juce::dsp::AudioBlock
     /* P         */ 1.5f,
     /* B_plus    */ 400.0f,
     /* Rp        */ 150000.0f
-  );
+  };
+
+  return table;
+}
+
+void DistortionEngine::updateStages(float drive, float bias, float drift)
+{
+  stages = makeStages(drive, bias);
+  stagesDrive = drive;
+  stagesBias = bias;
+  stagesDrift = drift;
+  sideBypassValid = false;
+
+  for (int n = 0; n < numTriodeStages; ++n)
+    stageBias[(size_t)n] = stages[(size_t)n].bias;
+
+  // Expanded where the drift has the stages now
+  if (isDrifting())
+    applyDriftOffsets();
+
+  updateSmallSignal();
+
+  // Stages 1-4, up to the tone stack: as they are, or at the targets of the
+  // current drift slice and the next
+  if (compositeParam)
+  {
+    if (isDrifting())
+    {
+      for (int slice = biasDrift.getSlice(); slice < biasDrift.getSlice() + BiasDrift::numTargets; ++slice)
+        setCompositeSlice(slice);
+    }
+    else
+    {
+      composites[0].setStages(stages.data(), 4);
+    }
+  }
+
+  ratePlan = makeValidPlan(useFixedPlan ? fixedPlan : choosePlan(drive));
+}
+
+DistortionEngine::RatePlan DistortionEngine::choosePlan(float drive) const
+{
+  RatePlan plan;
+  const int maxLevel = oversampler.getNumStages();
+
+  if (!multiRateParam)
+  {
+    plan.stageLevels.fill(maxLevel);
+    plan.toneStackLevel = maxLevel;
+    return plan;
+  }
+
+  // The rows either side of the drive, worst case of the two
+  int row = 0;
+  while (row < (int)std::size(planDrives) - 1 && drive > planDrives[row])
+    ++row;
+
+  const int rowBelow = drive < planDrives[row] ? juce::jmax(0, row - 1) : row;
+
+  // Higher host rates leave more room above the audio band for the harmonics
+  int hostShift = 0;
+  for (double rate = planReferenceRate * 2.0; hostSampleRate >= rate * 0.99; rate *= 2.0)
+    ++hostShift;
+
+  const int cap = juce::jlimit(1, planMaxCap, maxLevel + hostShift);
+
+  // A stage never runs lower than the caps below would have it
+  for (int n = 0; n < numTriodeStages; ++n)
+  {
+    int level = 0;
+    for (int c = 0; c < cap; ++c)
+      level = juce::jmax(level, planLevels[c][row][n], planLevels[c][rowBelow][n]);
+
+    plan.stageLevels[(size_t)n] = level - hostShift;
+  }
+
+  // The tone stack is linear: the lowest rate it is exact at will do
+  while (plan.toneStackLevel < maxLevel
+    && hostSampleRate * (double)(1 << plan.toneStackLevel) < (double)ToneStack::minimumSampleRate)
+    ++plan.toneStackLevel;
+
+  return plan;
+}
+
+DistortionEngine::RatePlan DistortionEngine::makeValidPlan(RatePlan plan) const
+{
+  const int maxLevel = oversampler.getNumStages();
+  auto& levels = plan.stageLevels;
+
+  for (auto& level : levels)
+    level = juce::jlimit(0, maxLevel, level);
+
+  // Stages 1-4 have to be at least as high as the tone stack wants to be, and no
+  // stage lower than a later one (the later one needs those harmonics too)
+  plan.toneStackLevel = juce::jlimit(levels[4], maxLevel, plan.toneStackLevel);
+  levels[3] = juce::jmax(levels[3], plan.toneStackLevel);
+
+  for (int n = numTriodeStages - 2; n >= 0; --n)
+    levels[(size_t)n] = juce::jmax(levels[(size_t)n], levels[(size_t)n + 1]);
+
+  return plan;
+}
+
+int DistortionEngine::getTriodeWorkPerSample() const noexcept
+{
+  int work = 0;
+  for (const auto level : ratePlan.stageLevels)
+    work += 1 << level;
+
+  return work;
+}
+
+void DistortionEngine::updateSmallSignal()
+{
+  if (!smallSignalParam)
+  {
+    smallSignal.fill({});
+    smallSignalFitted = false;
+    return;
+  }
+
+  // An expansion is of the tube's curve, which drive and bias don't change, only
+  // where on it the stage sits: once fitted, the expansions just follow that
+  if (smallSignalFitted)
+  {
+    recenterSmallSignal();
+    return;
+  }
+
+  expandStages(stages, stagesDrive, smallSignal);
+  smallSignalFitted = true;
+}
+
+void DistortionEngine::expandStages(const std::array<KorenTriodeModel::Stage, 5>& stageTable, float drive,
+  std::array<KorenTriodeModel::SmallSignal, 5>& expansions)
+{
+  // Quiescent input of each stage with no signal: the previous stage's output at
+  // its own quiescent point (c0 is the plate voltage there). The tone stack in
+  // front of stage 5 scales DC by its low shelf.
+  float quiescent = 0.0f;
+
+  for (int n = 0; n < numTriodeStages; ++n)
+  {
+    if (n == 4)
+      quiescent *= ToneStack::getShelfGain(drive);
+
+    expansions[(size_t)n] = KorenTriodeModel::computeSmallSignal(stageTable[(size_t)n], quiescent);
+    quiescent = expansions[(size_t)n].c0 * (stageTable[(size_t)n].gainVal / 300.0f);
+  }
+}
+
+void DistortionEngine::recenterSmallSignal()
+{
+  if (!smallSignalParam)
+    return;
+
+  // The operating points as updateSmallSignal finds them, but through the
+  // expansions already there rather than a solve per stage
+  float quiescent = 0.0f;
+
+  for (int n = 0; n < numTriodeStages; ++n)
+  {
+    if (n == 4)
+      quiescent *= ToneStack::getShelfGain(stagesDrive);
+
+    auto& expansion = smallSignal[(size_t)n];
+    const auto& stage = stages[(size_t)n];
+    const float d = quiescent * stage.drive + stage.bias - expansion.center;
+
+    // Half the window: the signal swings around the operating point, and the
+    // stages after this one are only moved once it is
+    if (expansion.window > 0.0f && std::abs(d) > 0.5f * expansion.window)
+    {
+      if (smallSignalRefitWait > 0)
+        return;
+
+      expansion = KorenTriodeModel::computeSmallSignal(stage, quiescent);
+      smallSignalRefitWait = juce::roundToInt(smallSignalRefitSeconds * hostSampleRate);
+      return;
+    }
+
+    quiescent = (expansion.c0 + d * (expansion.c1 + d * (expansion.c2 + d * expansion.c3))) * (stage.gainVal / 300.0f);
+  }
+}
+
+void DistortionEngine::applyDriftOffsets()
+{
+  float offsets[BiasDrift::maxStages];
+  biasDrift.getOffsets(offsets);
+
+  const float depth = stagesDrift * maxDriftVolts;
+
+  for (int n = 0; n < numTriodeStages; ++n)
+    stages[(size_t)n].bias = stageBias[(size_t)n] + depth * offsets[n];
+}
+
+void DistortionEngine::updateDrift(int numSamples)
+{
+  // A slice only ends once the curve for the next one's end target is built (or
+  // never will be, in which case the separate stages take over anyway)
+  const auto& next = composites[(size_t)((biasDrift.getSlice() + 2) % BiasDrift::numTargets)];
+
+  if (biasDrift.advance(numSamples, !compositeParam || !next.isBuilding()))
+  {
+    if (compositeParam)
+      setCompositeSlice(biasDrift.getSlice() + 2);
+
+    sideBypassValid = false;
+  }
+
+  applyDriftOffsets();
+  recenterSmallSignal();
+}
+
+void DistortionEngine::buildComposites()
+{
+  if (!isDrifting())
+  {
+    composites[0].buildSome(compositeBuildBudget);
+    return;
+  }
+
+  // The two curves in use come first, at the full budget
+  const int slice = biasDrift.getSlice();
+
+  for (int k = slice; k <= slice + 1; ++k)
+  {
+    auto& composite = composites[(size_t)(k % BiasDrift::numTargets)];
+
+    if (composite.isBuilding())
+    {
+      composite.buildSome(compositeBuildBudget);
+      return;
+    }
+  }
+
+  composites[(size_t)((slice + 2) % BiasDrift::numTargets)].buildSome(driftBuildBudget);
+}
+
+void DistortionEngine::setCompositeSlice(int slice)
+{
+  const float* target = biasDrift.getTarget(slice);
+  const float depth = stagesDrift * maxDriftVolts;
+
+  std::array<KorenTriodeModel::Stage, 4> drifted;
+
+  for (int n = 0; n < 4; ++n)
+  {
+    drifted[(size_t)n] = stages[(size_t)n];
+    drifted[(size_t)n].bias = stageBias[(size_t)n] + depth * target[n];
+  }
 
-  juce::dsp::ProcessContextReplacing<float> context(oversampledBlock);
-  highPassFilter.process(context);
+  composites[(size_t)(slice % BiasDrift::numTargets)].setStages(drifted.data(), 4);
+}
+
+DistortionEngine::AffineStandIn DistortionEngine::lineariseStages(
+  const std::array<KorenTriodeModel::Stage, 5>& stageTable, int first, int last)
+{
+  // Operating point with no signal: the input of stage first
+  float q = 0.0f;
+  for (int n = 0; n < first; ++n)
+    q = KorenTriodeModel::processSample(q, stageTable[(size_t)n]);
+
+  auto run = [&](float x)
+  {
+    for (int n = first; n < last; ++n)
+      x = KorenTriodeModel::processSample(x, stageTable[(size_t)n]);
+
+    return x;
+  };
+
+  // Small-signal gain of the run (central difference around its operating point)
+  const float h = 0.01f;
+
+  AffineStandIn standIn;
+  standIn.gain = (run(q + h) - run(q - h)) / (2.0f * h);
+  standIn.inOffset = q;
+  standIn.outOffset = run(q);
+  return standIn;
+}
+
+void DistortionEngine::updateSideBypass()
+{
+  const auto standIn = lineariseStages(stages, 2, 4);
+  sideBypassGain = standIn.gain;
+  sideBypassInOffset = standIn.inOffset;
+  sideBypassOutOffset = standIn.outOffset;
+  sideBypassValid = true;
+}
+
+int DistortionEngine::getLowBandWorkPerSample() const noexcept
+{
+  if (!lowBandSplit)
+    return 0;
+
+  return juce::jlimit(1, numTriodeStages, lowBandParam.numStages) << lowOversampler.getNumStages();
+}
+
+void DistortionEngine::updateLowStages()
+{
+  lowStages = makeStages(lowBandParam.drive, lowBandParam.bias);
+  lowStagesDrive = lowBandParam.drive;
+  lowStagesBias = lowBandParam.bias;
+  lowStagesCount = juce::jlimit(1, numTriodeStages, lowBandParam.numStages);
+
+  if (smallSignalParam)
+    expandStages(lowStages, lowStagesDrive, lowSmallSignal);
+  else
+    lowSmallSignal.fill({});
+
+  if (compositeParam && lowStagesCount > 1)
+    lowComposite.setStages(lowStages.data(), lowStagesCount - 1);
+
+  // The stages of 1-4 that don't run
+  lowStandIn = lineariseStages(lowStages, lowStagesCount - 1, 4);
+  updateLowBandGain();
+}
+
+void DistortionEngine::updateLowBandGain()
+{
+  lowGainDrive = stagesDrive;
+  lowGainBias = stagesBias;
+
+  // The table's gains take the chain's output back to its input level, so their
+  // difference takes the low band's output to the main chain's
+  lowBandGain = juce::Decibels::decibelsToGain(MakeupGain::getGainDb(lowStagesDrive, lowStagesBias)
+                                               - MakeupGain::getGainDb(stagesDrive, stagesBias));
+
+  // No input: stages 1-4 at their operating point, the tone stack at its DC gain, stage 5
+  const float quiescent = lineariseStages(lowStages, 0, 4).outOffset * ToneStack::getShelfGain(lowStagesDrive);
+  lowBandOffset = KorenTriodeModel::processSample(quiescent, lowStages[4]);
+}
+
+void DistortionEngine::splitBands(const juce::dsp::AudioBlock<float>& chain)
+{
+  const auto numSamples = chain.getNumSamples();
+
+  for (size_t ch = 0; ch < chain.getNumChannels(); ++ch)
+  {
+    float* high = chain.getChannelPointer(ch);
+    float* low = lowBandBuffer[ch];
+    juce::FloatVectorOperations::copy(low, high, (int)numSamples);
+
+    for (int section = 0; section < 2; ++section)
+    {
+      crossoverLow[section].process(low, numSamples, (int)ch);
+      crossoverHigh[section].process(high, numSamples, (int)ch);
+    }
+  }
+}
+
+void DistortionEngine::processLowBand(float sampleRate, size_t numChannelsToProcess, size_t numSamples)
+{
+  lowOversampler.begin(juce::dsp::AudioBlock<float>(lowBandBuffer, numChannelsToProcess, numSamples));
+
+  // Every stage at the band's own rate: with nothing high in the band, a rate
+  // plan would save next to nothing
+  auto block = lowOversampler.moveToLevel(lowOversampler.getNumStages());
+  const int numRunning = lowStagesCount - 1;
+
+  if (numRunning > 0 && compositeParam && lowComposite.isReady())
+  {
+    lowComposite.processAudioBlock(block);
+  }
+  else
+  {
+    for (int n = 0; n < numRunning; ++n)
+      processStageBlock(block, lowStages[(size_t)n], lowSmallSignal[(size_t)n]);
+  }
+
+  if (numRunning < 4)
+  {
+    for (size_t ch = 0; ch < block.getNumChannels(); ++ch)
+    {
+      float* data = block.getChannelPointer(ch);
+
+      for (size_t i = 0; i < block.getNumSamples(); ++i)
+        data[i] = lowStandIn.outOffset + lowStandIn.gain * (data[i] - lowStandIn.inOffset);
+    }
+  }
+
+  lowToneStack.setDrive(lowStagesDrive);
+  lowToneStack.processAudioBlock(sampleRate * (float)(1 << lowOversampler.getNumStages()), block);
+
+  processStageBlock(block, lowStages[4], lowSmallSignal[4]);
+  lowOversampler.moveToLevel(0);
+
+  for (size_t ch = 0; ch < numChannelsToProcess; ++ch)
+  {
+    juce::FloatVectorOperations::add(lowBandBuffer[ch], -lowBandOffset, (int)numSamples);
+    juce::FloatVectorOperations::multiply(lowBandBuffer[ch], lowBandGain, (int)numSamples);
+  }
+}
+
+void DistortionEngine::addLowBand(const juce::dsp::AudioBlock<float>& chain)
+{
+  const int numSamples = (int)chain.getNumSamples();
+  int position = lowDelayPosition;
+
+  for (size_t ch = 0; ch < chain.getNumChannels(); ++ch)
+  {
+    float* out = chain.getChannelPointer(ch);
+    const float* low = lowBandBuffer[ch];
+
+    if (lowDelayLength == 0)
+    {
+      juce::FloatVectorOperations::add(out, low, numSamples);
+      continue;
+    }
+
+    float* line = lowDelayLine[ch];
+    position = lowDelayPosition;
+
+    for (int i = 0; i < numSamples; ++i)
+    {
+      out[i] += line[position];
+      line[position] = low[i];
+
+      if (++position == lowDelayLength)
+        position = 0;
+    }
+  }
+
+  lowDelayPosition = position;
+}
+
+void DistortionEngine::processStageBlock(const juce::dsp::AudioBlock<float>& block, const KorenTriodeModel::Stage& stage,
+  const KorenTriodeModel::SmallSignal& stageSmallSignal)
+{
+  if (preciseSolve)
+  {
+    KorenTriodeModel::processAudioBlockPrecise(block, stage);
+    fastPathStats.solvedSamples += (int)(block.getNumChannels() * block.getNumSamples());
+    return;
+  }
+
+  KorenTriodeModel::processAudioBlock(block, stage, stageSmallSignal, fastPathStats, solverMaxIterations, solverTolerance);
+}
+
+void DistortionEngine::applyTriodeStages(float sampleRate, size_t numSamples, bool sideEconomy)
+{
+  const int maxLevel = oversampler.getNumStages();
+  auto block = oversampler.moveToLevel(ratePlan.stageLevels[0]);
+
+  // Analyzer capture (channel 0, decimated, bounded per block), indexed at the top rate
+  const bool capture = analysisTap != nullptr && analysisTap->beginBlock(numSamples << maxLevel);
+
+  if (capture)
+    analysisTap->captureChainInput(block.getChannelPointer(0), maxLevel - oversampler.getCurrentLevel());
+
+  // While drifting, the curves at the start and end targets of the slice
+  const bool drifting = isDrifting();
+  const int slice = drifting ? biasDrift.getSlice() : 0;
+  const auto& composite = composites[(size_t)(slice % BiasDrift::numTargets)];
+  const auto& nextComposite = composites[(size_t)((slice + 1) % BiasDrift::numTargets)];
+
+  // The analyzer wants every stage's operating point, so it gets the separate stages
+  lastSubBlockComposite = compositeParam && composite.isReady() && (!drifting || nextComposite.isReady()) && !capture;
+
+  auto processStage = [&](int stage)
+  {
+    block = oversampler.moveToLevel(ratePlan.stageLevels[(size_t)stage]);
+    const int rateShift = maxLevel - oversampler.getCurrentLevel();
+
+    // With side economy only the mid channel gets stages 3 and 4
+    const auto stageBlock = sideEconomy && (stage == 2 || stage == 3) ? block.getSingleChannelBlock(0) : block;
+
+    if (capture)
+      analysisTap->captureStageInput(stage, block.getChannelPointer(0), stages[(size_t)stage], rateShift);
+
+    processStageBlock(stageBlock, stages[(size_t)stage], smallSignal[(size_t)stage]);
+
+    if (capture)
+      analysisTap->captureStageOutput(stage, block.getChannelPointer(0), stages[(size_t)stage], rateShift);
+  };
+
+  auto applySideBypass = [&]
+  {
+    if (!sideBypassValid)
+      updateSideBypass();
+
+    // Side channel: linear stand-in for stages 3+4
+    float* side = block.getChannelPointer(1);
+    const auto numBlockSamples = block.getNumSamples();
+    for (size_t i = 0; i < numBlockSamples; ++i)
+      side[i] = sideBypassOutOffset + sideBypassGain * (side[i] - sideBypassInOffset);
+  };
+
+  if (lastSubBlockComposite)
+  {
+    // Stages 1-4 in one lookup, at stage 1's level (the highest of the four)
+    const auto compositeBlock = sideEconomy ? block.getSingleChannelBlock(0) : block;
+
+    if (drifting)
+      CompositeWaveshaper::processAudioBlock(compositeBlock, composite, nextComposite, biasDrift.getWeight());
+    else
+      composite.processAudioBlock(compositeBlock);
+
+    if (sideEconomy)
+    {
+      const auto side = block.getSingleChannelBlock(1);
+      processStageBlock(side, stages[0], smallSignal[0]);
+      processStageBlock(side, stages[1], smallSignal[1]);
+      applySideBypass();
+    }
+  }
+  else
+  {
+    processStage(0);
+    processStage(1);
+
+    if (sideEconomy)
+    {
+      block = oversampler.moveToLevel(ratePlan.stageLevels[2]);
+      applySideBypass();
+    }
+
+    processStage(2);
+    processStage(3);
+  }
+
+  // Tone stack in between, at its own (lower or equal) rate
+  block = oversampler.moveToLevel(ratePlan.toneStackLevel);
+  auto toneBlock = sideEconomy ? block.getSingleChannelBlock(0) : block;
+  toneStack.setDrive(stagesDrive);
+  toneStack.processAudioBlock(sampleRate * (float)(1 << ratePlan.toneStackLevel), toneBlock);
+
+  processStage(4);
+
+  if (capture)
+  {
+    analysisTap->captureChainOutput(block.getChannelPointer(0), maxLevel - oversampler.getCurrentLevel());
+    analysisTap->endBlock();
+  }
 }
 
 
 void DistortionEngine::processBlock(float sampleRate, juce::AudioBuffer<float>& buffer)
+{
+  juce::dsp::AudioBlock<float> block(buffer);
+  block = block.getSubsetChannelBlock(0, juce::jmin(block.getNumChannels(), (size_t)numChannels));
+
+  const size_t numSamples = block.getNumSamples();
+  const size_t fixedSize = (size_t)subBlockSize;
+
+  fastPathStats = {};
+
+  if (!accumulateBlocks)
+  {
+    // Split into sub-blocks, so nothing inside ever sees more than subBlockSize
+    // samples, whatever the host sends
+    for (size_t start = 0; start < numSamples; start += fixedSize)
+      processSubBlock(sampleRate, block.getSubBlock(start, juce::jmin(fixedSize, numSamples - start)));
+
+    return;
+  }
+
+  // Accumulate into whole sub-blocks: every sub-block has the same cost, at the
+  // price of subBlockSize samples of latency
+  const size_t numBlockChannels = block.getNumChannels();
+
+  for (size_t pos = 0; pos < numSamples;)
+  {
+    const size_t count = juce::jmin(numSamples - pos, fixedSize - accumulatedSamples);
+
+    for (size_t ch = 0; ch < numBlockChannels; ++ch)
+    {
+      float* io = block.getChannelPointer(ch) + pos;
+      juce::FloatVectorOperations::copy(accumulateIn[ch] + accumulatedSamples, io, (int)count);
+      juce::FloatVectorOperations::copy(io, accumulateOut[ch] + accumulatedSamples, (int)count);
+    }
+
+    accumulatedSamples += count;
+    pos += count;
+
+    if (accumulatedSamples == fixedSize)
+    {
+      processSubBlock(sampleRate, juce::dsp::AudioBlock<float>(accumulateIn, numBlockChannels, fixedSize));
+      std::swap(accumulateIn, accumulateOut);
+      accumulateSwapped = !accumulateSwapped;
+      accumulatedSamples = 0;
+    }
+  }
+}
+
+void DistortionEngine::delayDry(int numBlockChannels, int numSamples)
+{
+  int position = dryDelayPosition;
+
+  for (int ch = 0; ch < numBlockChannels; ++ch)
+  {
+    float* dry = dryBuffer[ch];
+    float* line = dryDelayLine[ch];
+    position = dryDelayPosition;
+
+    for (int i = 0; i < numSamples; ++i)
+    {
+      const float delayed = line[position];
+      line[position] = dry[i];
+      dry[i] = delayed;
+
+      if (++position == dryDelayLength)
+        position = 0;
+    }
+  }
+
+  dryDelayPosition = position;
+}
+
+bool DistortionEngine::channelsIdentical(const juce::dsp::AudioBlock<float>& block) noexcept
+{
+  if (block.getNumChannels() < 2)
+    return false;
+
+  return std::memcmp(block.getChannelPointer(0), block.getChannelPointer(1),
+    block.getNumSamples() * sizeof(float)) == 0;
+}
+
+void DistortionEngine::processSubBlock(float sampleRate, const juce::dsp::AudioBlock<float>& block)
 {
   // 1) Copy the input (dry) signal into dryBuffer
-  const int numChannels = buffer.getNumChannels();
-  const int numSamples = buffer.getNumSamples();
+  const int numBlockChannels = (int)block.getNumChannels();
+  const int numSamples = (int)block.getNumSamples();
 
   // We'll copy each channel
-  for (int ch = 0; ch < numChannels; ++ch)
-    dryBuffer.copyFrom(ch, 0, buffer, ch, 0, numSamples);
+  for (int ch = 0; ch < numBlockChannels; ++ch)
+    juce::FloatVectorOperations::copy(dryBuffer[ch], block.getChannelPointer((size_t)ch), numSamples);
 
-  // 2) Convert to AudioBlock & oversample
-  juce::dsp::AudioBlock<float> block(buffer);
-  auto subset = block.getSubsetChannelBlock(0, juce::jmin(2, (int)block.getNumChannels()));
-  auto oversampledBlock = oversampler->processSamplesUp(subset);
+  if (compensateDry)
+    delayDry(numBlockChannels, numSamples);
+
+  updateControl(numSamples);
 
-  // 3) Triode processing
-  applyTriodeStages(sampleRate, oversampledBlock, driveParam, biasParam);
+  // 2) M/S encode & oversample
+  auto subset = block.getSubsetChannelBlock(0, juce::jmin((size_t)2, block.getNumChannels()));
 
-  // 4) Downsample
-  oversampler->processSamplesDown(subset);
+  const bool midSide = midSideParam && subset.getNumChannels() == 2;
 
-  // 5) Mix the result with the original DRY buffer
+  // Mono source: L/R runs one channel for both, M/S skips the silent side
+  const bool identical = monoDetectionParam && channelsIdentical(subset);
+  identicalSamples = identical ? juce::jmin(identicalSamples + numSamples, monoSettleSamples) : 0;
+
+  const bool settled = identical && identicalSamples >= monoSettleSamples;
+  const bool linkChannels = settled && !midSide;
+  const bool skipSide = settled && midSide;
+
+  if (channelsLinked && !linkChannels)
+  {
+    oversampler.copyChannelState(0, 1);
+    toneStack.copyChannelState(0, 1);
+    highPassFilter.copyChannelState(0, 1);
+
+    if (!cabinet.hasStereoImpulse())
+      cabinet.copyChannelState(0, 1);
+
+    if (lowBandSplit)
+    {
+      for (int section = 0; section < 2; ++section)
+      {
+        crossoverLow[section].copyChannelState(0, 1);
+        crossoverHigh[section].copyChannelState(0, 1);
+      }
+
+      lowOversampler.copyChannelState(0, 1);
+      lowToneStack.copyChannelState(0, 1);
+      std::copy_n(lowDelayLine[0], lowDelayLength, lowDelayLine[1]);
+    }
+  }
+
+  channelsLinked = linkChannels;
+  lastSubBlockMono = linkChannels || skipSide;
+
+  if (midSide)
+    encodeToMS(subset);
+
+  const auto chain = lastSubBlockMono ? subset.getSingleChannelBlock(0) : subset;
+
+  // Multiband: the low band leaves the chain here and comes back after it
+  if (lowBandSplit)
+    splitBands(chain);
+
+  oversampler.begin(chain);
+
+  // 3) Triode processing, each stage at its level of the oversampler
+  applyTriodeStages(sampleRate, chain.getNumSamples(), midSide && sideEconomyParam && !skipSide);
+
+  // 4) Downsample, low band back in, DC high-pass at the host rate & M/S decode
+  oversampler.moveToLevel(0);
+
+  if (lowBandSplit)
+  {
+    processLowBand(sampleRate, chain.getNumChannels(), chain.getNumSamples());
+    addLowBand(chain);
+  }
+
+  for (size_t ch = 0; ch < chain.getNumChannels(); ++ch)
+    highPassFilter.process(chain.getChannelPointer(ch), chain.getNumSamples(), (int)ch);
+
+  // A settled silent side chain puts out (within rounding) nothing
+  if (skipSide)
+    juce::FloatVectorOperations::clear(subset.getChannelPointer(1), numSamples);
+
+  if (linkChannels)
+    juce::FloatVectorOperations::copy(subset.getChannelPointer(1), subset.getChannelPointer(0), numSamples);
+
+  if (midSide)
+    decodeFromMS(subset);
+
+  if (analysisTap != nullptr)
+    analysisTap->pushSignal(dryBuffer[0], block.getChannelPointer(0), numSamples);
+
+  // 5) Cabinet, after the tap so the analyzer sees the tubes alone. Linked
+  // channels share one convolution unless the impulse is stereo.
+  if (linkChannels && !cabinet.hasStereoImpulse())
+  {
+    cabinet.process(chain);
+    juce::FloatVectorOperations::copy(subset.getChannelPointer(1), subset.getChannelPointer(0), numSamples);
+  }
+  else
+  {
+    cabinet.process(subset);
+  }
+
+  // 6) Mix the result with the original DRY buffer
   const float wetGain = mixParam;        // e.g. 0.0..1.0
   const float dryGain = 1.0f - wetGain;
 
-  for (int ch = 0; ch < numChannels; ++ch)
+  for (int ch = 0; ch < numBlockChannels; ++ch)
   {
-    float* wetData = buffer.getWritePointer(ch);
-    const float* dryData = dryBuffer.getReadPointer(ch);
+    float* wetData = block.getChannelPointer((size_t)ch);
+    const float* dryData = dryBuffer[ch];
 
     for (int i = 0; i < numSamples; ++i)
     {
@@ -190,3 +1201,42 @@ void DistortionEngine::processBlock(float sampleRate, juce::AudioBuffer<float>&
   }
 }
 
+void DistortionEngine::updateControl(int numSamples)
+{
+  smallSignalRefitWait = juce::jmax(0, smallSignalRefitWait - numSamples);
+
+  if (driveParam != stagesDrive || biasParam != stagesBias || driftParam != stagesDrift)
+  {
+    updateStages(driveParam, biasParam, driftParam);
+  }
+  else
+  {
+    if (compositeParam)
+      buildComposites();
+
+    // Catches up with the last change (the drift recentres as it goes)
+    if (!isDrifting())
+      recenterSmallSignal();
+  }
+
+  if (isDrifting())
+    updateDrift(numSamples);
+
+  if (lowBandSplit)
+  {
+    if (lowBandParam.drive != lowStagesDrive || lowBandParam.bias != lowStagesBias || lowBandParam.numStages != lowStagesCount)
+      updateLowStages();
+    else if (compositeParam)
+      lowComposite.buildSome(compositeBuildBudget);
+
+    // The main drive sets the level the low band is matched to
+    if (stagesDrive != lowGainDrive || stagesBias != lowGainBias)
+      updateLowBandGain();
+  }
+}
+
+void DistortionEngine::advanceControl(juce::int64 numSamples)
+{
+  for (juce::int64 done = 0; done < numSamples; done += subBlockSize)
+    updateControl((int)juce::jmin((juce::int64)subBlockSize, numSamples - done));
+}
@@ -2,8 +2,15 @@
 #pragma once
 
 #include <JuceHeader.h>
-#include "korenTriodeModel.h"
+#include "KorenTriodeModel.h"
 #include "ToneStack.h"
+#include "CompositeWaveshaper.h"
+#include "BiasDrift.h"
+#include "CabinetConvolver.h"
+#include "AnalysisTap.h"
+#include "HalfBandOversampler.h"
+#include "ArenaBiquad.h"
+#include "DspArena.h"
 
 class DistortionEngine
 {
@@ -11,34 +18,408 @@ public:
   DistortionEngine() = default;
   ~DistortionEngine() = default;
 
-  void prepare(const juce::dsp::ProcessSpec& spec, int oversamplingFactor = 1);
+  // oversamplingFactor is a power of two (1 = 2x, 2 = 4x, 3 = 8x)
+  void prepare(const juce::dsp::ProcessSpec& spec, int oversamplingFactor = 1,
+    HalfBandOversampler::Phase phase = HalfBandOversampler::Phase::minimumPhase);
   void reset();
 
+  // Latency introduced by the oversampler (and block accumulation), in host-rate
+  // samples (rounded)
+  int getLatencyInSamples() const noexcept { return latencySamples; }
+
+  // The latency prepare() gives for these settings, without preparing anything
+  static int computeLatencyInSamples(int oversamplingFactor, HalfBandOversampler::Phase phase, bool accumulateBlocks);
+
+  // Host blocks are processed in fixed sub-blocks of at most this many samples
+  static constexpr int subBlockSize = 64;
+
+  // Channels processed (any further host channels are left untouched)
+  static constexpr int maxChannels = 2;
+
+  static constexpr int numTriodeStages = 5;
+
+  // Multi-rate: the oversampling level (2x steps above the host rate) of each
+  // triode stage and the tone stack; levels only fall along the chain
+  struct RatePlan
+  {
+    std::array<int, numTriodeStages> stageLevels{};
+    int toneStackLevel = 0;
+  };
+
+  // Off: everything runs at the full oversampled rate (the reference)
+  void setMultiRate(bool shouldUseMultiRate) { multiRateParam = shouldUseMultiRate; stagesDrive = -1.0f; }
+
+  // Overrides the drive-based plan (for measurements). Levels are clamped to the
+  // prepared factor and made to fall along the chain.
+  void setFixedRatePlan(const RatePlan& plan) { fixedPlan = plan; useFixedPlan = true; stagesDrive = -1.0f; }
+  void clearFixedRatePlan() { useFixedPlan = false; stagesDrive = -1.0f; }
+
+  const RatePlan& getRatePlan() const noexcept { return ratePlan; }
+
+  // Triode stage evaluations per host sample and channel for the current plan
+  int getTriodeWorkPerSample() const noexcept;
+
+  // The plan for a drive setting: every stage at the lowest level that keeps its
+  // aliasing within the measured threshold (see the tools' alias-scan command)
+  RatePlan choosePlan(float drive) const;
+
+  // Small-signal fast path: a cubic expansion instead of the Newton solve near each
+  // stage's quiescent point (see KorenTriodeModel::SmallSignal)
+  void setSmallSignalFastPath(bool shouldUseFastPath) { smallSignalParam = shouldUseFastPath; stagesDrive = -1.0f; lowStagesDrive = -1.0f; }
+
+  // Newton solve limits for every stage that isn't on a fast path (for
+  // measurements, see the tools' quality-scan command)
+  void setSolverLimits(int maxIterations, float tolerance) { solverMaxIterations = maxIterations; solverTolerance = tolerance; }
+
+  static constexpr int defaultSolverMaxIterations = 8;
+  static constexpr float defaultSolverTolerance = 1.0e-5f;
+
+  // Every solved sample converged in double precision instead, ignoring the
+  // limits above. Many times slower: a reference for measurements only.
+  void setPreciseSolve(bool shouldSolvePrecisely) { preciseSolve = shouldSolvePrecisely; }
+
+  // Fast path hits over the last processBlock call, all stages and channels
+  const KorenTriodeModel::FastPathStats& getFastPathStats() const noexcept { return fastPathStats; }
+
+  // Composite stages: stages 1-4 as one precomputed curve (see CompositeWaveshaper),
+  // rebuilt a slice per sub-block after drive or bias change
+  void setCompositeStages(bool shouldCompose) { compositeParam = shouldCompose; stagesDrive = -1.0f; lowStagesDrive = -1.0f; }
+
+  // Whether the last sub-block ran stages 1-4 as the composite curve
+  bool isUsingComposite() const noexcept { return lastSubBlockComposite; }
+
+  // Stage evaluations spent on building the curve per sub-block, at most
+  static constexpr int compositeBuildBudget = 48;
+
+  // Bias drift, 0..1: every stage's grid bias wanders slowly by up to
+  // maxDriftVolts (see BiasDrift)
+  void setDrift(float drift) { driftParam = drift; }
+
+  // Engines with different seeds drift differently. Used from the next reset().
+  void setDriftSeed(juce::uint32 seed) { driftSeed = seed; }
+
+  static constexpr float maxDriftVolts = 0.1f;
+  static constexpr int driftBuildBudget = 8;
+
+  // Multiband: an LR4 crossover ahead of the stages; the low band runs a chain of
+  // its own and is added back before the DC high-pass
+  struct LowBand
+  {
+    float crossoverHz = 0.0f;        // 0: no split
+    float drive = 0.2f;
+    float bias = 0.5f;
+
+    // Stage 5 always runs, and the first numStages - 1 of stages 1-4; the
+    // remaining ones are replaced by their linearisation around the operating point
+    int numStages = numTriodeStages;
+
+    // A power of two like prepare()'s (0 = the host rate), at most the main factor
+    int oversamplingFactor = 0;
+
+    bool operator==(const LowBand& other) const noexcept
+    {
+      return crossoverHz == other.crossoverHz && drive == other.drive && bias == other.bias
+        && numStages == other.numStages && oversamplingFactor == other.oversamplingFactor;
+    }
+  };
+
+  // The crossover and the factor are used from the next prepare(), the rest from
+  // the next sub-block
+  void setLowBand(const LowBand& settings) { lowBandParam = settings; }
+
+  bool isMultiband() const noexcept { return lowBandSplit; }
+
+  // Triode stage evaluations per host sample and channel in the low band (0
+  // without a split); getTriodeWorkPerSample() counts the rest of the chain
+  int getLowBandWorkPerSample() const noexcept;
+
+  // Gain on the low band's output: the calibrated level difference between its
+  // drive and the main one
+  float getLowBandGain() const noexcept { return lowBandGain; }
+
+  // Cabinet impulse response (nullptr for none), convolved after the DC high-pass
+  // with no added latency. Used from the next prepare().
+  void setCabinet(std::shared_ptr<const CabinetImpulse> impulse) { cabinetImpulse = std::move(impulse); }
+
+  bool hasCabinet() const noexcept { return cabinet.isActive(); }
+
+  // Bytes used by this instance: the object itself plus its arena
+  size_t getMemoryFootprint() const noexcept { return sizeof(*this) + arena.getCapacity(); }
+  juce::String getMemoryReport() const;
+
+  // When on, small host blocks are accumulated into whole sub-blocks so every
+  // sub-block costs the same. Adds subBlockSize samples of latency; call before prepare().
+  void setBlockAccumulation(bool shouldAccumulate) { accumulateBlocks = shouldAccumulate; }
+
   void setDrive(float drive) { driveParam = drive; }
   void setBias(float bias) { biasParam = bias; }
   void setMix(float mix) { mixParam = mix; }
 
+  // Mid/Side processing: L/R is encoded to M/S right before upsampling and
+  // decoded right after downsampling.
+  void setMidSide(bool shouldUseMidSide) { midSideParam = shouldUseMidSide; }
+
+  // In M/S mode, run the side channel through a cheaper chain that skips the
+  // two 12AT7 stages and the tone stack (only the mid gets full tube modelling).
+  void setSideEconomy(bool shouldUseEconomy) { sideEconomyParam = shouldUseEconomy; }
+
+  // Mono sources on stereo tracks: once L and R have been identical long enough,
+  // the chain runs on the left channel only and the result is copied
+  void setMonoDetection(bool shouldDetectMono) { monoDetectionParam = shouldDetectMono; }
+
+  // Whether the last sub-block ran the chain on one channel only
+  bool isProcessingMono() const noexcept { return lastSubBlockMono; }
+
+  // Optional tap for the analyzer (owned by the processor, may be nullptr)
+  void setAnalysisTap(AnalysisTap* tap) { analysisTap = tap; }
+
   // The main entry point
   void processBlock(float sampleRate, juce::AudioBuffer<float>& buffer);
 
+  // Offline only: moves the stage table, drift and curves on as numSamples of
+  // whole sub-blocks would, without any audio (filters and buffers stay as they are)
+  void advanceControl(juce::int64 numSamples);
+
+  // Complete processing state, arena included; only for engines prepared alike
+  struct State
+  {
+    std::vector<char> arena;
+
+    float drive = 0.0f, bias = 0.0f, mix = 0.0f, drift = 0.0f;
+    bool midSide = false, sideEconomy = false;
+
+    std::array<KorenTriodeModel::Stage, 5> stages{};
+    std::array<KorenTriodeModel::SmallSignal, 5> smallSignal{};
+    bool smallSignalFitted = false;
+    int smallSignalRefitWait = 0;
+    std::array<float, 5> stageBias{};
+    float stagesDrive = -1.0f, stagesBias = -1.0f, stagesDrift = -1.0f;
+    float sideBypassGain = 1.0f, sideBypassInOffset = 0.0f, sideBypassOutOffset = 0.0f;
+    bool sideBypassValid = false;
+    float toneStackDrive = 0.0f, toneStackRate = 0.0f;
+    RatePlan ratePlan;
+
+    LowBand lowBand;
+    std::array<KorenTriodeModel::Stage, 5> lowStages{};
+    std::array<KorenTriodeModel::SmallSignal, 5> lowSmallSignal{};
+    float lowStandInGain = 1.0f, lowStandInInOffset = 0.0f, lowStandInOutOffset = 0.0f;
+    float lowStagesDrive = -1.0f, lowStagesBias = -1.0f;
+    int lowStagesCount = 0;
+    float lowBandGain = 1.0f, lowBandOffset = 0.0f, lowGainDrive = -1.0f, lowGainBias = -1.0f;
+    float lowToneStackDrive = 0.0f, lowToneStackRate = 0.0f;
+    int lowDelayPosition = 0;
+
+    bool channelsLinked = false;
+    int identicalSamples = 0;
+
+    size_t accumulatedSamples = 0;
+    bool accumulateSwapped = false;
+    int dryDelayPosition = 0;
+  };
+
+  // Allocates when the state is used for the first time, not for the audio thread
+  void saveState(State& state) const;
+
+  // Returns false (and changes nothing) if the state comes from a different layout
+  bool restoreState(const State& state);
+
 private:
-  void encodeToMS(juce::AudioBuffer<float>& buffer);
-  void decodeFromMS(juce::AudioBuffer<float>& buffer);
+  // Processes at most subBlockSize samples in place
+  void processSubBlock(float sampleRate, const juce::dsp::AudioBlock<float>& block);
+
+  // The control-rate part of a sub-block: parameters, curve builds, drift
+  void updateControl(int numSamples);
+
+  // True if both channels of the block hold the same samples
+  static bool channelsIdentical(const juce::dsp::AudioBlock<float>& block) noexcept;
+
+  // Ring-buffer delay of the dry copy by dryDelayLength samples
+  void delayDry(int numBlockChannels, int numSamples);
+
+  void encodeToMS(const juce::dsp::AudioBlock<float>& block);
+  void decodeFromMS(const juce::dsp::AudioBlock<float>& block);
+
+  // The five stages' operating parameters for a drive/bias setting, without drift
+  static std::array<KorenTriodeModel::Stage, 5> makeStages(float drive, float bias);
+
+  // Recomputes the per-stage operating parameters (and the rate plan) for a
+  // drive/bias/drift setting
+  void updateStages(float drive, float bias, float drift);
+
+  // Expansions around the quiescent point of every stage, for the fast path:
+  // fitted the first time, after that only recentred
+  void updateSmallSignal();
+  static void expandStages(const std::array<KorenTriodeModel::Stage, 5>& stageTable, float drive,
+    std::array<KorenTriodeModel::SmallSignal, 5>& expansions);
+
+  // Moves the first expansion that has drifted too far from its stage's
+  // operating point (one per call, once smallSignalRefitWait has run out)
+  void recenterSmallSignal();
+
+  // Every stage's bias where the drift is now
+  void applyDriftOffsets();
+
+  // Advances the drift and sets every stage's bias for this sub-block
+  void updateDrift(int numSamples);
+
+  // A slice of the composite build, the curves the drift is between first
+  void buildComposites();
+
+  // Starts the composite curve at a drift slice's target
+  void setCompositeSlice(int slice);
+
+  bool isDrifting() const noexcept { return stagesDrift > 0.0f; }
+
+  // Levels clamped to the prepared factor, falling along the chain, with the tone
+  // stack in between its neighbours
+  RatePlan makeValidPlan(RatePlan plan) const;
+
+  // triode stages to call sequentially, each at its level of the oversampler
+  void applyTriodeStages(float sampleRate, size_t numSamples, bool sideEconomy);
 
-  // triode stages to call sequentially
-  void applyTriodeStages(float sampleRate, juce::dsp::AudioBlock<float>& oversampledBlock, float drive, float bias);
+  // One stage over a block, through its fast path and the solve the limits ask for
+  void processStageBlock(const juce::dsp::AudioBlock<float>& block, const KorenTriodeModel::Stage& stage,
+    const KorenTriodeModel::SmallSignal& stageSmallSignal);
+
+  // Affine stand-in for a run of stages: out = outOffset + gain * (in - inOffset)
+  struct AffineStandIn
+  {
+    float gain = 1.0f;
+    float inOffset = 0.0f;
+    float outOffset = 0.0f;
+  };
+
+  // Linearises stages first..last-1 around their operating point with no signal,
+  // so the stand-in keeps the level, polarity and DC of the stages it replaces
+  static AffineStandIn lineariseStages(const std::array<KorenTriodeModel::Stage, 5>& stageTable, int first, int last);
+
+  // Stages 3+4 for the economy side chain
+  void updateSideBypass();
+
+  // Multiband: splits chain into the low band buffers and the high band in place,
+  // runs the low band's chain and adds it back (delayed to the main chain's latency)
+  void splitBands(const juce::dsp::AudioBlock<float>& chain);
+  void processLowBand(float sampleRate, size_t numChannelsToProcess, size_t numSamples);
+  void addLowBand(const juce::dsp::AudioBlock<float>& chain);
+  void updateLowStages();
+  void updateLowBandGain();
+
+  // The five triode stages, recomputed only when drive, bias or drift change.
+  // Their biases move with the drift; stageBias holds them without.
+  std::array<KorenTriodeModel::Stage, 5> stages{};
+  std::array<float, 5> stageBias{};
+  float stagesDrive = -1.0f;
+  float stagesBias = -1.0f;
+  float stagesDrift = -1.0f;
+
+  BiasDrift biasDrift;
+  juce::uint32 driftSeed = 1;
+
+  std::array<KorenTriodeModel::SmallSignal, 5> smallSignal{};
+  bool smallSignalFitted = false;
+  int smallSignalRefitWait = 0;   // host samples until the next refit may run
+  KorenTriodeModel::FastPathStats fastPathStats;
+  bool smallSignalParam = true;
+
+  int solverMaxIterations = defaultSolverMaxIterations;
+  float solverTolerance = defaultSolverTolerance;
+  bool preciseSolve = false;
+
+  // Without drift only the first; with it, the curve at drift slice k is
+  // composites[k % BiasDrift::numTargets]
+  std::array<CompositeWaveshaper, BiasDrift::numTargets> composites;
+  bool compositeParam = true;
+  bool lastSubBlockComposite = false;
 
   /** Our tone stack (HP, shelves, peak). */
   ToneStack toneStack;
-  juce::dsp::ProcessorDuplicator<juce::dsp::IIR::Filter<float>, juce::dsp::IIR::Coefficients<float>> highPassFilter;
+  ArenaBiquad highPassFilter;
+
+  std::shared_ptr<const CabinetImpulse> cabinetImpulse;
+  CabinetConvolver cabinet;
 
   // e.g. 2x oversampling
-  std::unique_ptr<juce::dsp::Oversampling<float>> oversampler;
+  HalfBandOversampler oversampler;
+  int latencySamples = 0;
+  double hostSampleRate = 44100.0;
+
+  RatePlan ratePlan;
+  RatePlan fixedPlan;
+  bool useFixedPlan = false;
+  bool multiRateParam = true;
 
-  juce::AudioBuffer<float> dryBuffer;
+  // All filter state and buffers live in here, allocated once in prepare()
+  DspArena arena;
+  int numChannels = 0;
+
+  float* dryBuffer[maxChannels] = {};
+
+  // Block accumulation: input being filled, and the last processed sub-block
+  // being played out
+  float* accumulateIn[maxChannels] = {};
+  float* accumulateOut[maxChannels] = {};
+  size_t accumulatedSamples = 0;
+  bool accumulateSwapped = false;
+  bool accumulateBlocks = false;
+
+  // Linear phase only: delays the dry signal by the oversampler latency so the
+  // mix does not comb filter
+  float* dryDelayLine[maxChannels] = {};
+  int dryDelayLength = 0;
+  int dryDelayPosition = 0;
+  bool compensateDry = false;
+
+  AnalysisTap* analysisTap = nullptr;
+
+  // Mono detection: the right channel's state is stale while linked. The chain
+  // counts as settled after monoSettleSamples of identical input.
+  bool monoDetectionParam = true;
+  bool channelsLinked = false;
+  bool lastSubBlockMono = false;
+  int identicalSamples = 0;
+  int monoSettleSamples = 0;
 
   float driveParam = 0.2f;
   float biasParam = 0.5f;
+  float driftParam = 0.0f;
   float mixParam = 1.0f;
+  bool midSideParam = false;
+  bool sideEconomyParam = false;
+
+  // Affine stand-in for stages 3+4 on the economy side chain:
+  // out = sideBypassOutOffset + sideBypassGain * (in - sideBypassInOffset)
+  float sideBypassGain = 1.0f;
+  float sideBypassInOffset = 0.0f;
+  float sideBypassOutOffset = 0.0f;
+  bool sideBypassValid = false;
+
+  // Multiband (see LowBand). Crossover: two Butterworth sections per band.
+  LowBand lowBandParam;
+  bool lowBandSplit = false;
+  ArenaBiquad crossoverLow[2];
+  ArenaBiquad crossoverHigh[2];
+  HalfBandOversampler lowOversampler;
+  ToneStack lowToneStack;
+  float* lowBandBuffer[maxChannels] = {};
+
+  // Lines the low band up with the main oversampler's latency
+  float* lowDelayLine[maxChannels] = {};
+  int lowDelayLength = 0;
+  int lowDelayPosition = 0;
+
+  std::array<KorenTriodeModel::Stage, 5> lowStages{};
+  std::array<KorenTriodeModel::SmallSignal, 5> lowSmallSignal{};
+  CompositeWaveshaper lowComposite;
+  AffineStandIn lowStandIn;   // for stages numStages..4 of the low band
+  float lowStagesDrive = -1.0f;
+  float lowStagesBias = -1.0f;
+  int lowStagesCount = -1;
+
+  // The low band's output is lowBandGain * (out - lowBandOffset), so the gain
+  // doesn't scale up its DC; for the main drive and bias in lowGain*
+  float lowBandGain = 1.0f;
+  float lowBandOffset = 0.0f;
+  float lowGainDrive = -1.0f;
+  float lowGainBias = -1.0f;
 };
 
@@ -0,0 +1,72 @@
+// dspArena.cpp
+
+#include "DspArena.h"
+
+namespace
+{
+  size_t roundUpToAlignment(size_t numBytes)
+  {
+    return (numBytes + DspArena::alignment - 1) & ~(DspArena::alignment - 1);
+  }
+}
+
+void DspArena::beginMeasure()
+{
+  measuring = true;
+  used = 0;
+  numEntries = 0;
+}
+
+void DspArena::beginAssign()
+{
+  measured = used;
+
+  if (measured > capacity)
+  {
+    storage.free();
+    storage.allocate(measured + alignment, false);
+
+    const auto address = reinterpret_cast<juce::pointer_sized_uint>(storage.get());
+    base = storage.get() + (roundUpToAlignment((size_t)address) - (size_t)address);
+    capacity = measured;
+  }
+
+  if (capacity > 0)
+    std::memset(base, 0, capacity);
+
+  measuring = false;
+  used = 0;
+  numEntries = 0;
+}
+
+void DspArena::endAssign()
+{
+  // The layout has to ask for the same things in both passes
+  jassert(used == measured);
+}
+
+void* DspArena::allocateBytes(size_t numBytes, const char* name)
+{
+  const size_t offset = used;
+  used += roundUpToAlignment(numBytes);
+
+  if (numEntries < maxEntries)
+    entries[(size_t)numEntries++] = { name, numBytes };
+
+  if (measuring || numBytes == 0)
+    return nullptr;
+
+  jassert(used <= capacity);
+  return base + offset;
+}
+
+juce::String DspArena::getReport() const
+{
+  juce::String report;
+
+  for (int i = 0; i < numEntries; ++i)
+    report << entries[(size_t)i].name << ": " << (int)entries[(size_t)i].bytes << " bytes\n";
+
+  report << "arena: " << (int)used << " bytes used, " << (int)capacity << " allocated\n";
+  return report;
+}
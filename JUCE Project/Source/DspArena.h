@@ -0,0 +1,81 @@
+// dspArena.h
+
+#pragma once
+
+#include <JuceHeader.h>
+
+/**
+    One contiguous, cache-line aligned block of memory for an engine's buffers and
+    filter state.
+
+    The owner describes its layout in a single function and build() runs it twice:
+    the first pass only measures, the second hands out pointers into one allocation.
+    Allocations are laid out in call order, each starting on a new cache line, so
+    whatever the layout asks for first ends up together at the front (hot state
+    first). Nothing is allocated after build(), and build() only reallocates when the
+    layout has grown.
+*/
+class DspArena
+{
+public:
+  static constexpr size_t alignment = 64;
+
+  DspArena() = default;
+  ~DspArena() = default;
+
+  template <typename LayoutFunction>
+  void build(LayoutFunction&& layout)
+  {
+    beginMeasure();
+    layout(*this);
+    beginAssign();
+    layout(*this);
+    endAssign();
+  }
+
+  // count zero-initialised Ts on a fresh cache line; nullptr while measuring
+  template <typename T>
+  T* allocate(size_t count, const char* name)
+  {
+    static_assert(std::is_trivially_destructible<T>::value, "Arena memory is never destructed");
+    static_assert(alignof(T) <= alignment, "Over-aligned type");
+    return static_cast<T*>(allocateBytes(count * sizeof(T), name));
+  }
+
+  bool isMeasuring() const noexcept { return measuring; }
+
+  // Bytes in use (including alignment padding) and bytes allocated
+  size_t getSize() const noexcept { return used; }
+  const char* getData() const noexcept { return base; }
+  char* getData() noexcept { return base; }
+  size_t getCapacity() const noexcept { return capacity; }
+
+  // One line per named allocation, in layout order
+  juce::String getReport() const;
+
+private:
+  void beginMeasure();
+  void beginAssign();
+  void endAssign();
+  void* allocateBytes(size_t numBytes, const char* name);
+
+  struct Entry
+  {
+    const char* name = nullptr;
+    size_t bytes = 0;
+  };
+
+  static constexpr int maxEntries = 96;
+
+  juce::HeapBlock<char> storage;
+  char* base = nullptr;          // storage, rounded up to the alignment
+  size_t capacity = 0;
+  size_t used = 0;
+  size_t measured = 0;
+  bool measuring = false;
+
+  std::array<Entry, maxEntries> entries{};
+  int numEntries = 0;
+
+  JUCE_DECLARE_NON_COPYABLE(DspArena)
+};
@@ -0,0 +1,473 @@
+// engineSwitcher.cpp
+
+#include "EngineSwitcher.h"
+
+//==============================================================================
+class EngineSwitcher::BuildJob : public juce::ThreadPoolJob
+{
+public:
+  explicit BuildJob(EngineSwitcher& s)
+    : juce::ThreadPoolJob("Eldur engine build"), switcher(s)
+  {
+  }
+
+  JobStatus runJob() override
+  {
+    switcher.build(*this);
+    return jobHasFinished;
+  }
+
+  EngineSwitcher& switcher;
+};
+
+//==============================================================================
+EngineSwitcher::EngineSwitcher()
+  : driftSeed((juce::uint32)juce::Random::getSystemRandom().nextInt())
+{
+}
+
+EngineSwitcher::~EngineSwitcher()
+{
+  // This switcher's jobs only: the pool carries on for the other instances
+  struct OwnJobs : juce::ThreadPool::JobSelector
+  {
+    explicit OwnJobs(EngineSwitcher& s) : switcher(s) {}
+
+    bool isJobSuitable(juce::ThreadPoolJob* job) override
+    {
+      auto* buildJob = dynamic_cast<BuildJob*>(job);
+      return buildJob != nullptr && &buildJob->switcher == &switcher;
+    }
+
+    EngineSwitcher& switcher;
+  } ownJobs(*this);
+
+  buildPool->removeAllJobs(true, -1, &ownJobs);
+
+  delete pending.exchange(nullptr);
+  deleteRetired();
+}
+
+//==============================================================================
+void EngineSwitcher::prepare(const juce::dsp::ProcessSpec& spec)
+{
+  prepareTicks = juce::Time::getHighResolutionTicks();
+  firstAudioTicks.store(-1, std::memory_order_relaxed);
+
+  deleteRetired();
+  outgoing.reset();
+  active.reset();
+  crossfading = false;
+  processedSincePrepare = false;
+
+  {
+    const juce::ScopedLock lock(requestLock);
+    preparedSpec = spec;
+    prepared = true;
+    ++generation;   // a build still running is for the old spec, it gets dropped
+
+    // Under the lock, so nothing for the old spec can be published after this
+    delete pending.exchange(nullptr);
+
+    activeConfig = requestedConfig;
+    latestLatency.store(requestedConfig.alignedLatency, std::memory_order_relaxed);
+    buildRequested = true;
+
+    if (!synchronousBuilds)
+      startBuildJob();
+  }
+
+  if (synchronousBuilds)
+    buildNow();
+
+  passThroughDelay.setLength((int)spec.numChannels, activeConfig.alignedLatency);
+  crossfadeBuffer.setSize(DistortionEngine::maxChannels, juce::jmax(1, (int)spec.maximumBlockSize));
+  crossfadeLength = juce::jmax(1, juce::roundToInt(crossfadeSeconds * spec.sampleRate));
+  crossfadePosition = 0;
+}
+
+void EngineSwitcher::reset()
+{
+  outgoing.reset();
+  crossfading = false;
+  passThroughDelay.clear();
+
+  if (active != nullptr)
+  {
+    active->engine.reset();
+    active->delay.clear();
+  }
+}
+
+void EngineSwitcher::requestConfig(const Config& config)
+{
+  deleteRetired();
+
+  {
+    const juce::ScopedLock lock(requestLock);
+
+    if (config == requestedConfig)
+      return;
+
+    requestedConfig = config;
+
+    if (!prepared)
+      return;
+
+    ++generation;
+    buildRequested = true;
+
+    if (!synchronousBuilds)
+    {
+      startBuildJob();
+      return;
+    }
+  }
+
+  buildNow();
+}
+
+EngineSwitcher::Config EngineSwitcher::getRequestedConfig() const
+{
+  const juce::ScopedLock lock(requestLock);
+  return requestedConfig;
+}
+
+double EngineSwitcher::getTimeToFirstAudio() const noexcept
+{
+  const auto ticks = firstAudioTicks.load(std::memory_order_relaxed);
+  return ticks < 0 ? -1.0 : juce::Time::highResolutionTicksToSeconds(ticks);
+}
+
+std::unique_ptr<EngineSwitcher::Slot> EngineSwitcher::createSlot(const Config& config,
+  const juce::dsp::ProcessSpec& spec) const
+{
+  auto slot = std::make_unique<Slot>();
+  slot->config = config;
+
+  auto& engine = slot->engine;
+  engine.setBlockAccumulation(config.blockAccumulation);
+  engine.setMultiRate(config.multiRate);
+  engine.setDriftSeed(driftSeed);
+  engine.setCabinet(config.cabinet);
+  engine.setLowBand(config.lowBand);
+  engine.prepare(spec, config.oversamplingFactor, config.phase);
+  engine.reset();
+
+  const int engineLatency = engine.getLatencyInSamples();
+  slot->delay.setLength((int)spec.numChannels, config.alignedLatency - engineLatency);
+  slot->latency = juce::jmax(engineLatency, config.alignedLatency);
+  return slot;
+}
+
+void EngineSwitcher::applyParameters(DistortionEngine& engine) const noexcept
+{
+  engine.setDrive(parameters.drive);
+  engine.setBias(parameters.bias);
+  engine.setDrift(parameters.drift);
+  engine.setMix(parameters.mix);
+  engine.setMidSide(parameters.midSide);
+  engine.setSideEconomy(parameters.sideEconomy);
+}
+
+//==============================================================================
+void EngineSwitcher::startBuildJob()
+{
+  if (buildQueued)
+    return;
+
+  buildQueued = true;
+  buildPool->addJob(new BuildJob(*this), true);
+}
+
+void EngineSwitcher::build(const BuildJob& job)
+{
+  for (;;)
+  {
+    deleteRetired();
+
+    Config config;
+    juce::dsp::ProcessSpec spec;
+    juce::uint32 buildGeneration = 0;
+
+    {
+      const juce::ScopedLock lock(requestLock);
+
+      // Cleared under the same lock a request checks, so none is missed
+      if (job.shouldExit() || !takeRequest(config, spec, buildGeneration))
+      {
+        buildQueued = false;
+        return;
+      }
+    }
+
+    publish(createSlot(config, spec), buildGeneration);
+  }
+}
+
+void EngineSwitcher::buildNow()
+{
+  Config config;
+  juce::dsp::ProcessSpec spec;
+  juce::uint32 buildGeneration = 0;
+
+  {
+    const juce::ScopedLock lock(requestLock);
+
+    if (!takeRequest(config, spec, buildGeneration))
+      return;
+  }
+
+  publish(createSlot(config, spec), buildGeneration);
+}
+
+bool EngineSwitcher::takeRequest(Config& config, juce::dsp::ProcessSpec& spec, juce::uint32& buildGeneration)
+{
+  if (!buildRequested)
+    return false;
+
+  buildRequested = false;
+  config = requestedConfig;
+  spec = preparedSpec;
+  buildGeneration = generation;
+  return true;
+}
+
+void EngineSwitcher::publish(std::unique_ptr<Slot> slot, juce::uint32 buildGeneration)
+{
+  const int latency = slot->latency;
+  bool ready = false;
+
+  {
+    const juce::ScopedLock lock(requestLock);
+
+    // Publish only if nothing newer was asked for meanwhile. A ready engine the
+    // audio thread has not taken yet is simply replaced.
+    if (buildGeneration == generation)
+    {
+      delete pending.exchange(slot.release());
+      latestLatency.store(latency, std::memory_order_relaxed);
+      ready = true;
+    }
+  }
+
+  if (ready && onEngineReady != nullptr)
+    onEngineReady();
+}
+
+void EngineSwitcher::deleteRetired()
+{
+  for (Slot* slot = retired.exchange(nullptr, std::memory_order_acquire); slot != nullptr;)
+  {
+    Slot* next = slot->nextRetired;
+    delete slot;
+    slot = next;
+  }
+}
+
+//==============================================================================
+void EngineSwitcher::Delay::setLength(int numChannels, int length)
+{
+  line.setSize(juce::jmax(1, numChannels), juce::jmax(0, length));
+  clear();
+}
+
+void EngineSwitcher::Delay::clear()
+{
+  line.clear();
+  position = 0;
+}
+
+void EngineSwitcher::Delay::process(juce::AudioBuffer<float>& block) noexcept
+{
+  const int length = line.getNumSamples();
+  if (length == 0)
+    return;
+
+  const int numChannels = juce::jmin(block.getNumChannels(), line.getNumChannels());
+  const int numSamples = block.getNumSamples();
+  int end = position;
+
+  for (int ch = 0; ch < numChannels; ++ch)
+  {
+    float* samples = block.getWritePointer(ch);
+    float* delayed = line.getWritePointer(ch);
+    end = position;
+
+    for (int i = 0; i < numSamples; ++i)
+    {
+      const float sample = delayed[end];
+      delayed[end] = samples[i];
+      samples[i] = sample;
+
+      if (++end == length)
+        end = 0;
+    }
+  }
+
+  position = end;
+}
+
+void EngineSwitcher::processSlot(Slot& slot, float sampleRate, juce::AudioBuffer<float>& block, int start,
+  int numSamples) const noexcept
+{
+  slot.engine.processBlock(sampleRate, block);
+  slot.delay.process(block);
+
+  const float step = (parameters.outputGainEnd - parameters.outputGainStart) / (float)juce::jmax(1, numSamples);
+  const float startGain = parameters.outputGainStart + step * (float)start;
+
+  if (step == 0.0f)
+    block.applyGain(startGain);
+  else
+    block.applyGainRamp(0, block.getNumSamples(), startGain, startGain + step * (float)block.getNumSamples());
+}
+
+//==============================================================================
+void EngineSwitcher::setAnalysisTap(AnalysisTap* tap) noexcept
+{
+  analysisTap = tap;
+
+  if (active != nullptr)
+    active->engine.setAnalysisTap(tap);
+}
+
+void EngineSwitcher::beginSwitch() noexcept
+{
+  Slot* next = pending.exchange(nullptr, std::memory_order_acq_rel);
+  if (next == nullptr)
+    return;
+
+  // The first engine since prepare(): the end of the pass-through
+  if (active == nullptr)
+    firstAudioTicks.store(juce::Time::getHighResolutionTicks() - prepareTicks, std::memory_order_relaxed);
+
+  outgoing = std::move(active);
+  active.reset(next);
+  activeConfig = active->config;
+
+  // Only one engine feeds the analyzer
+  if (outgoing != nullptr)
+    outgoing->engine.setAnalysisTap(nullptr);
+
+  active->engine.setAnalysisTap(analysisTap);
+
+  // Nothing has been heard yet to fade from (a synchronous build)
+  crossfading = outgoing != nullptr || processedSincePrepare;
+  crossfadePosition = 0;
+}
+
+void EngineSwitcher::processBlock(float sampleRate, juce::AudioBuffer<float>& buffer)
+{
+  if (!crossfading)
+    beginSwitch();
+
+  processedSincePrepare = true;
+
+  // Passes the audio through until the first engine is ready
+  if (active == nullptr)
+  {
+    passThroughDelay.process(buffer);
+    return;
+  }
+
+  applyParameters(active->engine);
+
+  if (!crossfading)
+  {
+    processSlot(*active, sampleRate, buffer, 0, buffer.getNumSamples());
+    return;
+  }
+
+  if (outgoing != nullptr)
+    applyParameters(outgoing->engine);
+
+  // In pieces of at most the crossfade buffer's size, in case the host goes over
+  // its maximum block size
+  const int numSamples = buffer.getNumSamples();
+  const int maxChunk = crossfadeBuffer.getNumSamples();
+
+  for (int start = 0; start < numSamples;)
+  {
+    const int chunk = crossfading ? juce::jmin(maxChunk, numSamples - start) : numSamples - start;
+
+    if (crossfading)
+    {
+      processCrossfade(sampleRate, buffer, start, chunk);
+    }
+    else
+    {
+      float* channels[DistortionEngine::maxChannels] = {};
+      const int numChannels = juce::jmin(buffer.getNumChannels(), DistortionEngine::maxChannels);
+
+      for (int ch = 0; ch < numChannels; ++ch)
+        channels[ch] = buffer.getWritePointer(ch, start);
+
+      juce::AudioBuffer<float> rest(channels, numChannels, chunk);
+      processSlot(*active, sampleRate, rest, start, numSamples);
+    }
+
+    start += chunk;
+  }
+}
+
+void EngineSwitcher::processCrossfade(float sampleRate, juce::AudioBuffer<float>& buffer, int start, int numSamples)
+{
+  const int numChannels = juce::jmin(buffer.getNumChannels(), DistortionEngine::maxChannels);
+
+  float* outChannels[DistortionEngine::maxChannels] = {};
+  float* inChannels[DistortionEngine::maxChannels] = {};
+
+  // The incoming engine gets a copy of the input, the outgoing one runs in place
+  // (without one, the delayed input itself is faded out)
+  for (int ch = 0; ch < numChannels; ++ch)
+  {
+    outChannels[ch] = buffer.getWritePointer(ch, start);
+    inChannels[ch] = crossfadeBuffer.getWritePointer(ch);
+    juce::FloatVectorOperations::copy(inChannels[ch], outChannels[ch], numSamples);
+  }
+
+  juce::AudioBuffer<float> outgoingBlock(outChannels, numChannels, numSamples);
+  juce::AudioBuffer<float> incomingBlock(inChannels, numChannels, numSamples);
+
+  if (outgoing != nullptr)
+    processSlot(*outgoing, sampleRate, outgoingBlock, start, buffer.getNumSamples());
+  else
+    passThroughDelay.process(outgoingBlock);
+
+  processSlot(*active, sampleRate, incomingBlock, start, buffer.getNumSamples());
+
+  // Linear: both sides come from the same input, so they are correlated
+  const int fadeSamples = juce::jmin(numSamples, crossfadeLength - crossfadePosition);
+  const float step = 1.0f / (float)crossfadeLength;
+
+  for (int ch = 0; ch < numChannels; ++ch)
+  {
+    float* out = outChannels[ch];
+    const float* in = inChannels[ch];
+
+    for (int i = 0; i < fadeSamples; ++i)
+    {
+      const float gain = (float)(crossfadePosition + i + 1) * step;
+      out[i] += gain * (in[i] - out[i]);
+    }
+
+    juce::FloatVectorOperations::copy(out + fadeSamples, in + fadeSamples, numSamples - fadeSamples);
+  }
+
+  crossfadePosition += fadeSamples;
+
+  if (crossfadePosition < crossfadeLength)
+    return;
+
+  crossfading = false;
+
+  // Onto the retired list for the next build, request or prepare to delete
+  if (Slot* slot = outgoing.release())
+  {
+    slot->nextRetired = retired.load(std::memory_order_relaxed);
+    while (!retired.compare_exchange_weak(slot->nextRetired, slot, std::memory_order_release, std::memory_order_relaxed))
+    {
+    }
+  }
+}
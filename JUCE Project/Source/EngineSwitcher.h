@@ -0,0 +1,242 @@
+// engineSwitcher.h
+
+#pragma once
+
+#include <JuceHeader.h>
+#include "DistortionEngine.h"
+
+/**
+    Runs a DistortionEngine and replaces it, without a glitch, when a setting that
+    needs a new prepare() changes (sample rate, block size, oversampling factor,
+    filter phase, rate plan, cabinet, band split, block accumulation).
+
+    New engines are built and prepared as jobs on a thread pool shared by all the
+    switchers in the process, then handed over through an atomic pointer. The audio
+    thread picks one up at the start of a block and crossfades from the old engine
+    to the new one over crossfadeSeconds, both running on the same input. The old
+    engine goes back through a lock-free list and is deleted with the next build,
+    request or prepare: the audio thread never allocates, frees, locks or waits for
+    a build.
+
+    prepare() only starts a build too, so a session with many instances opens (and
+    changes sample rate) without every instance building its engine on the host's
+    thread in turn. Until the first engine is ready the audio passes through dry,
+    then fades into the engine's output.
+
+    Offline renders can't wait for a background build: the output would depend on
+    when it finished. With synchronous builds on, prepare() and requestConfig()
+    build on the calling thread and return with the engine ready, and the first
+    block starts on it without a fade.
+
+    Every engine's output (and the dry signal passed through) is delayed to the
+    config's alignedLatency, so the engines a crossfade runs between line up and
+    the latency stays the same from one config to the next. An engine with more
+    latency than that reports its own, as does a config with another
+    alignedLatency (its crossfade runs between outputs that don't line up); the
+    owner is told the latency once the new engine is ready (onEngineReady).
+
+    Engines' outputs get the parameters' output gain (e.g. a makeup gain for the
+    settings) ahead of the crossfade; the dry signal passed through stays at unity.
+*/
+class EngineSwitcher
+{
+public:
+  /** Everything that needs the engine prepared again. */
+  struct Config
+  {
+    int oversamplingFactor = 1;   // power of two, as DistortionEngine::prepare
+    HalfBandOversampler::Phase phase = HalfBandOversampler::Phase::minimumPhase;
+    bool multiRate = true;
+
+    // Shared by every engine built with it, compared by identity
+    std::shared_ptr<const CabinetImpulse> cabinet;
+
+    // Multiband split; the low band's drive, bias and stages come with it
+    DistortionEngine::LowBand lowBand;
+
+    // Whole sub-blocks whatever the host block size, for subBlockSize samples of
+    // latency (see DistortionEngine::setBlockAccumulation)
+    bool blockAccumulation = false;
+
+    // Host-rate samples every engine's output is delayed to at least (e.g. the
+    // most any preset's config has), so switching doesn't change the latency
+    int alignedLatency = 0;
+
+    bool operator==(const Config& other) const noexcept
+    {
+      return oversamplingFactor == other.oversamplingFactor && phase == other.phase && multiRate == other.multiRate
+        && cabinet == other.cabinet && lowBand == other.lowBand && blockAccumulation == other.blockAccumulation
+        && alignedLatency == other.alignedLatency;
+    }
+
+    bool operator!=(const Config& other) const noexcept { return !(*this == other); }
+  };
+
+  /** Per-block settings, applied to every running engine. */
+  struct Parameters
+  {
+    float drive = 0.2f;
+    float bias = 0.5f;
+    float mix = 1.0f;
+    bool midSide = false;
+    bool sideEconomy = false;
+    float drift = 0.0f;
+
+    // On every engine's output, a linear ramp from start to end over the block
+    float outputGainStart = 1.0f;
+    float outputGainEnd = 1.0f;
+  };
+
+  static constexpr double crossfadeSeconds = 0.005;
+
+  EngineSwitcher();
+  ~EngineSwitcher();
+
+  //==============================================================================
+  // Message thread, audio stopped
+
+  // Drops the running engine and any switch in flight and starts building one for
+  // the requested config; the audio passes through until it is ready.
+  // maximumBlockSize also sizes the crossfade buffer.
+  void prepare(const juce::dsp::ProcessSpec& spec);
+  void reset();
+
+  // Builds on the calling thread from now on (e.g. for an offline render)
+  void setSynchronousBuilds(bool shouldBuildSynchronously) noexcept { synchronousBuilds = shouldBuildSynchronously; }
+  bool isBuildingSynchronously() const noexcept { return synchronousBuilds; }
+
+  //==============================================================================
+  // Message thread
+
+  // Builds an engine for config in the background and switches to it once ready.
+  // A newer request replaces one that has not been switched to yet. Before
+  // prepare() this only sets the config prepare() will use.
+  void requestConfig(const Config& config);
+  Config getRequestedConfig() const;
+
+  // Latency of the most recently built engine, delay included, in host-rate
+  // samples (the requested alignedLatency until one is built)
+  int getLatencyInSamples() const noexcept { return latestLatency.load(std::memory_order_relaxed); }
+
+  // Seconds from the last prepare() to the first block its engine processed, or
+  // -1 while the audio still passes through
+  double getTimeToFirstAudio() const noexcept;
+
+  // Called on a pool thread when an engine for a new config is ready to be
+  // switched to (e.g. to report the new latency to the host)
+  std::function<void()> onEngineReady;
+
+  //==============================================================================
+  // Audio thread
+
+  void setParameters(const Parameters& newParameters) noexcept { parameters = newParameters; }
+  void setAnalysisTap(AnalysisTap* tap) noexcept;
+
+  void processBlock(float sampleRate, juce::AudioBuffer<float>& buffer);
+
+  // The config of the engine the output comes from (the incoming one while fading,
+  // the one being built while passing through)
+  const Config& getActiveConfig() const noexcept { return activeConfig; }
+  bool isCrossfading() const noexcept { return crossfading; }
+  bool isPassingThrough() const noexcept { return active == nullptr; }
+
+private:
+  // A delay line, for lining an engine or the dry signal up with alignedLatency
+  struct Delay
+  {
+    juce::AudioBuffer<float> line;
+    int position = 0;
+
+    void setLength(int numChannels, int length);
+    void clear();
+    void process(juce::AudioBuffer<float>& block) noexcept;
+  };
+
+  struct Slot
+  {
+    DistortionEngine engine;
+    Config config;
+    Delay delay;        // up to alignedLatency
+    int latency = 0;    // engine and delay
+    Slot* nextRetired = nullptr;
+  };
+
+  class BuildJob;
+
+  // The builders of every switcher in the process: half the cores, so that
+  // opening a big session leaves the rest to the host
+  struct BuildPool : juce::ThreadPool
+  {
+    BuildPool() : juce::ThreadPool(juce::jmax(1, juce::SystemStats::getNumCpus() / 2)) {}
+  };
+
+  // Builds engines until no request is left (on a pool thread)
+  void build(const BuildJob& job);
+
+  // Builds the requested engine on the calling thread (synchronous builds)
+  void buildNow();
+
+  // Under requestLock: takes the request to build, if there is one
+  bool takeRequest(Config& config, juce::dsp::ProcessSpec& spec, juce::uint32& buildGeneration);
+
+  // Hands a built engine to the audio thread unless a newer request came in
+  // meanwhile; tells onEngineReady
+  void publish(std::unique_ptr<Slot> slot, juce::uint32 buildGeneration);
+
+  // Under requestLock: queues a build job unless one is queued or running
+  void startBuildJob();
+
+  // Deletes the engines the audio thread has finished with
+  void deleteRetired();
+
+  std::unique_ptr<Slot> createSlot(const Config& config, const juce::dsp::ProcessSpec& spec) const;
+  void applyParameters(DistortionEngine& engine) const noexcept;
+
+  // The engine, then its delay and the output gain. block starts at start in the
+  // host block, which is numSamples long (for where it is on the gain ramp).
+  void processSlot(Slot& slot, float sampleRate, juce::AudioBuffer<float>& block, int start, int numSamples) const noexcept;
+
+  // Takes a ready engine, if any, and starts fading to it
+  void beginSwitch() noexcept;
+  void processCrossfade(float sampleRate, juce::AudioBuffer<float>& buffer, int start, int numSamples);
+
+  juce::SharedResourcePointer<BuildPool> buildPool;
+
+  // Every engine of this switcher drifts the same way, other instances differently
+  const juce::uint32 driftSeed;
+
+  // Build requests: written by the message thread, read by the build jobs
+  juce::CriticalSection requestLock;
+  Config requestedConfig;
+  juce::dsp::ProcessSpec preparedSpec{};
+  bool prepared = false;
+  juce::uint32 generation = 0;
+  bool buildRequested = false;
+  bool buildQueued = false;
+  std::atomic<bool> synchronousBuilds{ false };
+
+  // Hand-over between the build jobs and the audio thread
+  std::atomic<Slot*> pending{ nullptr };
+  std::atomic<Slot*> retired{ nullptr };
+  std::atomic<int> latestLatency{ 0 };
+
+  // Time to first audio: ticks at prepare(), and from there to the first block
+  juce::int64 prepareTicks = 0;
+  std::atomic<juce::int64> firstAudioTicks{ -1 };
+
+  // Audio thread
+  std::unique_ptr<Slot> active;
+  std::unique_ptr<Slot> outgoing;   // null while fading in from the dry signal
+  Config activeConfig;
+  bool crossfading = false;
+  bool processedSincePrepare = false;
+  Parameters parameters;
+  AnalysisTap* analysisTap = nullptr;
+
+  Delay passThroughDelay;
+  juce::AudioBuffer<float> crossfadeBuffer;
+  int crossfadeLength = 1;
+  int crossfadePosition = 0;
+
+  JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(EngineSwitcher)
+};
@@ -0,0 +1,653 @@
+// halfBandOversampler.cpp
+
+#include "HalfBandOversampler.h"
+
+namespace
+{
+  // Transition width of the first stage, relative to its output rate:
+  // passband to 0.225 * 2fs (19.8 kHz at 44.1 kHz)
+  constexpr double firstStageTransition = 0.05;
+
+  double getStageTransition(int stage)
+  {
+    if (stage == 0)
+      return firstStageTransition;
+
+    // Later stages only have to keep the band below the first stage's stopband
+    // edge (0.5 + tw0, in host-rate units) free of images/aliases
+    const double ratio = (double)(1 << stage);
+    const double stopbandEdge = (ratio - (0.5 + firstStageTransition)) / (2.0 * ratio);
+    return 2.0 * (stopbandEdge - 0.25);
+  }
+
+  double getStageAttenuation(int stage)
+  {
+    return stage == 0 ? 80.0 : (stage == 1 ? 70.0 : 60.0);
+  }
+
+  double ipow(double x, int n)
+  {
+    double result = 1.0;
+    for (int i = 0; i < n; ++i)
+      result *= x;
+    return result;
+  }
+
+  void computeTransitionParameters(double transition, double& k, double& q)
+  {
+    k = std::tan((1.0 - transition * 2.0) * juce::MathConstants<double>::pi / 4.0);
+    k *= k;
+
+    const double kksqrt = std::pow(1.0 - k * k, 0.25);
+    const double e = 0.5 * (1.0 - kksqrt) / (1.0 + kksqrt);
+    const double e2 = e * e;
+    const double e4 = e2 * e2;
+    q = e * (1.0 + e4 * (2.0 + e4 * (15.0 + 150.0 * e4)));
+  }
+
+  double computeAllpassCoefficient(int index, double k, double q, int order)
+  {
+    const int c = index + 1;
+    const double pi = juce::MathConstants<double>::pi;
+
+    double numerator = 0.0;
+    {
+      int i = 0;
+      double sign = 1.0;
+      double term;
+      do
+      {
+        term = ipow(q, i * (i + 1)) * std::sin((double)((i * 2 + 1) * c) * pi / (double)order) * sign;
+        numerator += term;
+        sign = -sign;
+        ++i;
+      } while (std::abs(term) > 1e-100);
+    }
+
+    double denominator = 0.0;
+    {
+      int i = 1;
+      double sign = -1.0;
+      double term;
+      do
+      {
+        term = ipow(q, i * i) * std::cos((double)(i * 2 * c) * pi / (double)order) * sign;
+        denominator += term;
+        sign = -sign;
+        ++i;
+      } while (std::abs(term) > 1e-100);
+    }
+
+    const double ww = (numerator * std::pow(q, 0.25)) / (denominator + 0.5);
+    const double wwsq = ww * ww;
+    const double x = std::sqrt((1.0 - wwsq * k) * (1.0 - wwsq / k)) / (1.0 + wwsq);
+
+    return (1.0 - x) / (1.0 + x);
+  }
+
+  double besselI0(double x)
+  {
+    double sum = 1.0, term = 1.0;
+    for (int n = 1; n < 64; ++n)
+    {
+      term *= (x / (2.0 * n)) * (x / (2.0 * n));
+      sum += term;
+      if (term < sum * 1e-16)
+        break;
+    }
+    return sum;
+  }
+}
+
+//==============================================================================
+int HalfBandOversampler::computeNumAllpassCoefficients(double attenuationDb, double transition)
+{
+  double k, q;
+  computeTransitionParameters(transition, k, q);
+
+  const double attenuationPower = std::pow(10.0, -attenuationDb / 10.0);
+  const double a = attenuationPower / (1.0 - attenuationPower);
+
+  int order = (int)std::ceil(std::log(a * a / 16.0) / std::log(q));
+  if ((order & 1) == 0)
+    ++order;
+  if (order == 1)
+    order = 3;
+
+  // Round up to an even count so both branches have the same number of
+  // sections and share the SIMD lanes without padding
+  int numCoefficients = (order - 1) / 2;
+  return numCoefficients + (numCoefficients & 1);
+}
+
+std::vector<double> HalfBandOversampler::designAllpassCoefficients(int numCoefficients, double transition)
+{
+  double k, q;
+  computeTransitionParameters(transition, k, q);
+
+  const int order = numCoefficients * 2 + 1;
+  std::vector<double> coefficients((size_t)numCoefficients);
+
+  for (int i = 0; i < numCoefficients; ++i)
+    coefficients[(size_t)i] = computeAllpassCoefficient(i, k, q, order);
+
+  return coefficients;
+}
+
+std::vector<float> HalfBandOversampler::designHalfBandFir(double attenuationDb, double transition)
+{
+  // Kaiser estimate, then rounded up to a length of 4k + 3 so the centre tap
+  // sits at an odd index and the even taps carry the filter
+  const double estimate = (attenuationDb - 7.95) / (14.36 * transition) + 1.0;
+  int centre = juce::jmax(1, (int)std::ceil((estimate - 1.0) / 2.0));
+  if ((centre & 1) == 0)
+    ++centre;
+
+  const int length = 2 * centre + 1;
+  const double beta = attenuationDb > 50.0 ? 0.1102 * (attenuationDb - 8.7)
+    : 0.5842 * std::pow(attenuationDb - 21.0, 0.4) + 0.07886 * (attenuationDb - 21.0);
+  const double norm = besselI0(beta);
+
+  std::vector<float> taps((size_t)length, 0.0f);
+  for (int j = 0; j < length; ++j)
+  {
+    const int n = j - centre;
+    if (n == 0)
+    {
+      taps[(size_t)j] = 0.5f;
+      continue;
+    }
+
+    // Half-band: every other tap is exactly zero
+    if ((n & 1) == 0)
+      continue;
+
+    const double x = juce::MathConstants<double>::pi * (double)n / 2.0;
+    const double sinc = std::sin(x) / x;
+    const double r = (double)n / (double)centre;
+    const double window = besselI0(beta * std::sqrt(juce::jmax(0.0, 1.0 - r * r))) / norm;
+    taps[(size_t)j] = (float)(0.5 * sinc * window);
+  }
+
+  return taps;
+}
+
+//==============================================================================
+void HalfBandOversampler::prepare(int newNumStages, size_t maximumBlockSize, Phase newPhase)
+{
+  configure(newNumStages, maximumBlockSize, newPhase);
+  ownArena.build([this](DspArena& arena) { allocate(arena); });
+  reset();
+}
+
+void HalfBandOversampler::configure(int newNumStages, size_t maximumBlockSize, Phase newPhase)
+{
+  jassert(newNumStages >= 0 && newNumStages <= maxStages);
+
+  phase = newPhase;
+  maxBlockSize = maximumBlockSize;
+  numStages = juce::jlimit(0, maxStages, newNumStages);
+  latency = 0.0f;
+
+  for (int s = 0; s < numStages; ++s)
+  {
+    auto& stage = stages[(size_t)s];
+    stage = {};
+
+    const double transition = getStageTransition(s);
+    const double attenuation = getStageAttenuation(s);
+    double stageDelay = 0.0;   // at the stage's output rate, one direction
+
+    if (phase == Phase::minimumPhase)
+    {
+      const int numCoefficients = computeNumAllpassCoefficients(attenuation, transition);
+      const auto designed = designAllpassCoefficients(numCoefficients, transition);
+      stage.numSections = numCoefficients / 2;
+
+      double delayEven = 0.0, delayOdd = 0.0;
+      for (int n = 0; n < stage.numSections; ++n)
+      {
+        const double even = designed[(size_t)(2 * n)];
+        const double odd = designed[(size_t)(2 * n + 1)];
+        delayEven += (1.0 - even) / (1.0 + even);
+        delayOdd += (1.0 - odd) / (1.0 + odd);
+      }
+
+      // H(z) = (A0(z^2) + z^-1 A1(z^2)) / 2, group delay at DC
+      stageDelay = (2.0 * delayEven + 1.0 + 2.0 * delayOdd) * 0.5;
+    }
+    else
+    {
+      const auto taps = designHalfBandFir(attenuation, transition);
+      const int centre = ((int)taps.size() - 1) / 2;
+
+      stage.numFirTaps = centre + 1;
+      stage.firDelay = (centre - 1) / 2;
+
+      // Up and down are centre / 2^s host samples together: pad the input
+      // (2^s samples per host sample) up to the next whole host sample
+      const int inputPerHost = 1 << s;
+      stage.upPad = (inputPerHost - centre % inputPerHost) % inputPerHost;
+      stageDelay = (double)(centre + stage.upPad);
+    }
+
+    // Up and down, converted from the stage's output rate to the host rate
+    latency += (float)(2.0 * stageDelay / (double)(2 << s));
+  }
+}
+
+void HalfBandOversampler::allocate(DspArena& arena)
+{
+  // Coefficients and filter state first, they are touched every sample
+  for (int s = 0; s < numStages; ++s)
+  {
+    auto& stage = stages[(size_t)s];
+
+    if (phase == Phase::minimumPhase)
+    {
+      const auto numSections = (size_t)stage.numSections;
+      stage.coefficients = arena.allocate<SIMD>(numSections, "oversampler coefficients");
+      stage.upState = arena.allocate<SIMD>(numSections, "oversampler up state");
+      stage.downState = arena.allocate<SIMD>(numSections, "oversampler down state");
+      stage.savedState = arena.allocate<SIMD>(numSections, "oversampler saved state");
+    }
+    else
+    {
+      stage.firTaps = arena.allocate<float>((size_t)stage.numFirTaps, "oversampler FIR taps");
+    }
+  }
+
+  // Then the block-sized buffers
+  for (int s = 0; s < numStages; ++s)
+  {
+    auto& stage = stages[(size_t)s];
+    const size_t inputSize = maxBlockSize << s;
+
+    if (phase == Phase::minimumPhase)
+    {
+      // Interleaved lane frames, one per input sample going up / output sample going down
+      stage.lanes = arena.allocate<SIMD>(inputSize, "oversampler lane frames");
+    }
+    else
+    {
+      const size_t centre = (size_t)stage.numFirTaps - 1;
+
+      for (int ch = 0; ch < 2; ++ch)
+      {
+        stage.upHistory[ch] = arena.allocate<float>(centre + (size_t)stage.upPad + inputSize, "oversampler FIR up history");
+        stage.downHistoryEven[ch] = arena.allocate<float>(centre + inputSize, "oversampler FIR down history");
+        stage.downHistoryOdd[ch] = arena.allocate<float>((centre + 1) / 2 + inputSize, "oversampler FIR delay branch");
+      }
+    }
+
+    for (int ch = 0; ch < 2; ++ch)
+      stage.buffer[ch] = arena.allocate<float>(inputSize * 2, "oversampler stage buffer");
+
+    if (!arena.isMeasuring())
+      writeCoefficients(s);
+  }
+}
+
+void HalfBandOversampler::writeCoefficients(int stageIndex)
+{
+  auto& stage = stages[(size_t)stageIndex];
+  const double transition = getStageTransition(stageIndex);
+  const double attenuation = getStageAttenuation(stageIndex);
+
+  if (phase == Phase::minimumPhase)
+  {
+    const auto designed = designAllpassCoefficients(stage.numSections * 2, transition);
+
+    for (int n = 0; n < stage.numSections; ++n)
+    {
+      const float even = (float)designed[(size_t)(2 * n)];
+      const float odd = (float)designed[(size_t)(2 * n + 1)];
+
+      // Unused lanes (wider SIMD) get a harmless copy of the left channel's pair
+      alignas(sizeof(SIMD)) float lanes[numLanes];
+      for (size_t lane = 0; lane < numLanes; ++lane)
+        lanes[lane] = (lane & 1) == 0 ? even : odd;
+
+      stage.coefficients[n] = SIMD::fromRawArray(lanes);
+    }
+  }
+  else
+  {
+    const auto taps = designHalfBandFir(attenuation, transition);
+
+    // Even taps 0, 2, .. 2 * centre; doubled to make up for zero stuffing
+    for (int k = 0; k < stage.numFirTaps; ++k)
+      stage.firTaps[k] = 2.0f * taps[(size_t)(2 * k)];
+  }
+}
+
+void HalfBandOversampler::reset()
+{
+  for (int s = 0; s < numStages; ++s)
+  {
+    auto& stage = stages[(size_t)s];
+
+    if (phase == Phase::minimumPhase)
+    {
+      std::fill(stage.upState, stage.upState + stage.numSections, SIMD::expand(0.0f));
+      std::fill(stage.downState, stage.downState + stage.numSections, SIMD::expand(0.0f));
+      continue;
+    }
+
+    const size_t inputSize = maxBlockSize << s;
+    const size_t centre = (size_t)stage.numFirTaps - 1;
+
+    for (int ch = 0; ch < 2; ++ch)
+    {
+      std::fill(stage.upHistory[ch], stage.upHistory[ch] + centre + (size_t)stage.upPad + inputSize, 0.0f);
+      std::fill(stage.downHistoryEven[ch], stage.downHistoryEven[ch] + centre + inputSize, 0.0f);
+      std::fill(stage.downHistoryOdd[ch], stage.downHistoryOdd[ch] + (centre + 1) / 2 + inputSize, 0.0f);
+    }
+  }
+}
+
+void HalfBandOversampler::copyChannelState(size_t from, size_t to) noexcept
+{
+  if (from == to)
+    return;
+
+  for (int s = 0; s < numStages; ++s)
+  {
+    auto& stage = stages[(size_t)s];
+
+    if (phase == Phase::minimumPhase)
+    {
+      // Lanes { L even, L odd, R even, R odd } of every section
+      for (auto* state : { stage.upState, stage.downState })
+      {
+        for (int n = 0; n < stage.numSections; ++n)
+        {
+          float* lanes = reinterpret_cast<float*>(state + n);
+          lanes[2 * to] = lanes[2 * from];
+          lanes[2 * to + 1] = lanes[2 * from + 1];
+        }
+      }
+
+      continue;
+    }
+
+    // Only the retained history at the front carries over between blocks
+    const size_t centre = (size_t)stage.numFirTaps - 1;
+    std::copy_n(stage.upHistory[from], centre + (size_t)stage.upPad, stage.upHistory[to]);
+    std::copy_n(stage.downHistoryEven[from], centre, stage.downHistoryEven[to]);
+    std::copy_n(stage.downHistoryOdd[from], (centre + 1) / 2, stage.downHistoryOdd[to]);
+  }
+}
+
+std::vector<int> HalfBandOversampler::getStageComplexity() const
+{
+  std::vector<int> complexity;
+  for (int s = 0; s < numStages; ++s)
+    complexity.push_back(phase == Phase::minimumPhase ? stages[(size_t)s].numSections * 2
+      : stages[(size_t)s].numFirTaps);
+  return complexity;
+}
+
+//==============================================================================
+juce::dsp::AudioBlock<float> HalfBandOversampler::processSamplesUp(const juce::dsp::AudioBlock<float>& input)
+{
+  begin(input);
+  return moveToLevel(numStages);
+}
+
+void HalfBandOversampler::processSamplesDown(const juce::dsp::AudioBlock<float>& output)
+{
+  if (numStages == 0)
+    return;
+
+  numChannelsDown = juce::jmin(numChannelsUp, output.getNumChannels());
+  hostBlock[0] = output.getChannelPointer(0);
+  hostBlock[1] = output.getChannelPointer(numChannelsDown - 1);
+  moveToLevel(0);
+}
+
+void HalfBandOversampler::begin(const juce::dsp::AudioBlock<float>& block)
+{
+  numChannelsUp = juce::jmin((size_t)2, block.getNumChannels());
+  numChannelsDown = numChannelsUp;
+  numHostSamples = block.getNumSamples();
+  jassert(numHostSamples <= maxBlockSize);
+
+  hostBlock[0] = block.getChannelPointer(0);
+  hostBlock[1] = block.getChannelPointer(numChannelsUp - 1);
+  currentLevel = 0;
+  goingDown = false;
+}
+
+juce::dsp::AudioBlock<float> HalfBandOversampler::moveToLevel(int level)
+{
+  jassert(level >= 0 && level <= numStages);
+  level = juce::jlimit(0, numStages, level);
+
+  // One pass up and one pass down per block: every filter runs exactly once
+  jassert(!goingDown || level <= currentLevel);
+
+  for (; currentLevel < level; ++currentLevel)
+  {
+    auto& stage = stages[(size_t)currentLevel];
+    const float* in[2] = { getLevelData(currentLevel, 0), getLevelData(currentLevel, 1) };
+    float* out[2] = { stage.buffer[0], stage.buffer[1] };
+    const size_t numSamples = numHostSamples << currentLevel;
+
+    if (phase == Phase::minimumPhase)
+      upStageIIR(stage, in, out, numChannelsUp, numSamples);
+    else
+      upStageFIR(stage, in, out, numChannelsUp, numSamples);
+  }
+
+  for (; currentLevel > level; --currentLevel)
+  {
+    // Stage s goes from level s + 1 to level s. The buffer below holds that
+    // stage's output going up, which is no longer needed.
+    const int s = currentLevel - 1;
+    auto& stage = stages[(size_t)s];
+    const float* in[2] = { stage.buffer[0], stage.buffer[1] };
+    float* out[2] = { getLevelData(s, 0), getLevelData(s, 1) };
+    const size_t numOutputSamples = numHostSamples << s;
+
+    if (phase == Phase::minimumPhase)
+      downStageIIR(stage, in, out, numChannelsDown, numOutputSamples);
+    else
+      downStageFIR(stage, in, out, numChannelsDown, numOutputSamples);
+
+    goingDown = true;
+  }
+
+  levelChannels[0] = getLevelData(currentLevel, 0);
+  levelChannels[1] = getLevelData(currentLevel, 1);
+  return juce::dsp::AudioBlock<float>(levelChannels, currentLevel == 0 ? numChannelsDown : numChannelsUp,
+    numHostSamples << currentLevel);
+}
+
+//==============================================================================
+void HalfBandOversampler::filterLanes(const Stage& stage, SIMD* state, SIMD* data, size_t numSamples) noexcept
+{
+  const size_t numSections = (size_t)stage.numSections;
+  const auto* coefficients = stage.coefficients;
+
+  for (size_t i = 0; i < numSamples; ++i)
+  {
+    auto v = data[i];
+
+    // First-order allpass sections in transposed form, one multiply-add on the
+    // critical path per section: y = s + a * x, s = x - a * y
+    for (size_t n = 0; n < numSections; ++n)
+    {
+      const auto y = SIMD::multiplyAdd(state[n], coefficients[n], v);
+      state[n] = v - coefficients[n] * y;
+      v = y;
+    }
+
+    data[i] = v;
+  }
+}
+
+void HalfBandOversampler::filterLanesKeepingSecond(const Stage& stage, SIMD* state, SIMD* data,
+  size_t numSamples) noexcept
+{
+  const auto numSections = (size_t)stage.numSections;
+  std::copy(state, state + numSections, stage.savedState);
+
+  filterLanes(stage, state, data, numSamples);
+
+  for (size_t n = 0; n < numSections; ++n)
+  {
+    float* lanes = reinterpret_cast<float*>(state + n);
+    const float* saved = reinterpret_cast<const float*>(stage.savedState + n);
+    lanes[2] = saved[2];
+    lanes[3] = saved[3];
+  }
+}
+
+void HalfBandOversampler::upStageIIR(Stage& stage, const float* const* in, float* const* out,
+  size_t numChannels, size_t numSamples)
+{
+  float* lanes = reinterpret_cast<float*>(stage.lanes);
+  const float* inR = in[numChannels > 1 ? 1 : 0];
+
+  // { L, L, R, R }: both branches of both channels see the same input
+  for (size_t i = 0; i < numSamples; ++i)
+  {
+    float* frame = lanes + i * numLanes;
+    frame[0] = frame[1] = in[0][i];
+    frame[2] = frame[3] = inR[i];
+  }
+
+  if (numChannels > 1)
+    filterLanes(stage, stage.upState, stage.lanes, numSamples);
+  else
+    filterLanesKeepingSecond(stage, stage.upState, stage.lanes, numSamples);
+
+  for (size_t i = 0; i < numSamples; ++i)
+  {
+    const float* frame = lanes + i * numLanes;
+    out[0][2 * i] = frame[0];
+    out[0][2 * i + 1] = frame[1];
+  }
+
+  if (numChannels > 1)
+  {
+    for (size_t i = 0; i < numSamples; ++i)
+    {
+      const float* frame = lanes + i * numLanes;
+      out[1][2 * i] = frame[2];
+      out[1][2 * i + 1] = frame[3];
+    }
+  }
+}
+
+void HalfBandOversampler::downStageIIR(Stage& stage, const float* const* in, float* const* out,
+  size_t numChannels, size_t numSamples)
+{
+  float* lanes = reinterpret_cast<float*>(stage.lanes);
+  const float* inR = in[numChannels > 1 ? 1 : 0];
+
+  // The even branch takes the later sample of each pair, the odd branch the earlier one
+  for (size_t i = 0; i < numSamples; ++i)
+  {
+    float* frame = lanes + i * numLanes;
+    frame[0] = in[0][2 * i + 1];
+    frame[1] = in[0][2 * i];
+    frame[2] = inR[2 * i + 1];
+    frame[3] = inR[2 * i];
+  }
+
+  if (numChannels > 1)
+    filterLanes(stage, stage.downState, stage.lanes, numSamples);
+  else
+    filterLanesKeepingSecond(stage, stage.downState, stage.lanes, numSamples);
+
+  for (size_t i = 0; i < numSamples; ++i)
+  {
+    const float* frame = lanes + i * numLanes;
+    out[0][i] = 0.5f * (frame[0] + frame[1]);
+  }
+
+  if (numChannels > 1)
+  {
+    for (size_t i = 0; i < numSamples; ++i)
+    {
+      const float* frame = lanes + i * numLanes;
+      out[1][i] = 0.5f * (frame[2] + frame[3]);
+    }
+  }
+}
+
+//==============================================================================
+void HalfBandOversampler::upStageFIR(Stage& stage, const float* const* in, float* const* out,
+  size_t numChannels, size_t numSamples)
+{
+  const int numTaps = stage.numFirTaps;
+  const int centre = numTaps - 1;
+  const int half = numTaps / 2;
+  const float* taps = stage.firTaps;
+
+  const int retained = centre + stage.upPad;
+
+  for (size_t ch = 0; ch < numChannels; ++ch)
+  {
+    // history = [ centre + pad previous samples | this block ]; the filter
+    // reads it upPad samples behind the newest input
+    float* history = stage.upHistory[ch];
+    std::copy(in[ch], in[ch] + numSamples, history + retained);
+
+    for (size_t m = 0; m < numSamples; ++m)
+    {
+      const float* newest = history + centre + m;
+      const float* oldest = history + m;
+
+      // Symmetric taps: fold the two halves, contiguous so the loop vectorises
+      float sum = 0.0f;
+      for (int k = 0; k < half; ++k)
+        sum += taps[k] * (newest[-k] + oldest[k]);
+
+      out[ch][2 * m] = sum;
+      out[ch][2 * m + 1] = newest[-stage.firDelay];
+    }
+
+    std::copy(history + numSamples, history + numSamples + retained, history);
+  }
+}
+
+void HalfBandOversampler::downStageFIR(Stage& stage, const float* const* in, float* const* out,
+  size_t numChannels, size_t numSamples)
+{
+  const int numTaps = stage.numFirTaps;
+  const int centre = numTaps - 1;
+  const int half = numTaps / 2;
+  const int oddDelay = (centre + 1) / 2;
+  const float* taps = stage.firTaps;
+
+  for (size_t ch = 0; ch < numChannels; ++ch)
+  {
+    float* even = stage.downHistoryEven[ch];
+    float* odd = stage.downHistoryOdd[ch];
+
+    for (size_t m = 0; m < numSamples; ++m)
+    {
+      even[centre + (int)m] = in[ch][2 * m];
+      odd[oddDelay + (int)m] = in[ch][2 * m + 1];
+    }
+
+    for (size_t m = 0; m < numSamples; ++m)
+    {
+      const float* newest = even + centre + m;
+      const float* oldest = even + m;
+
+      // Taps were doubled for interpolation, halve them back here
+      float sum = 0.0f;
+      for (int k = 0; k < half; ++k)
+        sum += taps[k] * (newest[-k] + oldest[k]);
+
+      out[ch][m] = 0.5f * sum + 0.5f * odd[m];
+    }
+
+    std::copy(even + numSamples, even + numSamples + centre, even);
+    std::copy(odd + numSamples, odd + numSamples + oddDelay, odd);
+  }
+}
@@ -0,0 +1,154 @@
+// halfBandOversampler.h
+
+#pragma once
+
+#include <JuceHeader.h>
+#include "DspArena.h"
+
+/**
+    Cascaded 2x half-band oversampler tuned for the triode chain.
+
+    Each 2x stage is a polyphase half-band filter. The first stage (closest to the
+    host rate) carries the full transition-band and rejection spec; later stages
+    only have to keep images/aliases out of the original audio band, so they get
+    much wider transition bands and less rejection, i.e. far fewer coefficients.
+
+    Two variants:
+    - minimumPhase: polyphase IIR (two allpass branches). Both channels and both
+      branches run in one SIMD register: lanes are { L even, L odd, R even, R odd }.
+    - linearPhase: polyphase half-band FIR (every other tap is zero, one branch is
+      a pure delay). Stage s alone would be centre / 2^s host samples round trip,
+      a fraction for s > 0 since the centre is odd, so each stage's input is
+      padded up to a whole host sample and the latency is an integer.
+
+    Handles one or two channels. All coefficients, state and buffers come from a
+    DspArena: its own (prepare) or the owner's (configure + allocate).
+*/
+class HalfBandOversampler
+{
+public:
+  enum class Phase
+  {
+    minimumPhase,
+    linearPhase
+  };
+
+  HalfBandOversampler() = default;
+  ~HalfBandOversampler() = default;
+
+  static constexpr int maxStages = 4;
+
+  // numStages: the factor as a power of two (1 = 2x, 2 = 4x, 3 = 8x)
+  void prepare(int numStages, size_t maximumBlockSize, Phase phase = Phase::minimumPhase);
+  void reset();
+
+  // For owners that keep everything in one arena: configure() first, then
+  // allocate() from the owner's DspArena::build, then reset()
+  void configure(int numStages, size_t maximumBlockSize, Phase phase);
+  void allocate(DspArena& arena);
+
+  size_t getOversamplingFactor() const noexcept { return (size_t)1 << numStages; }
+  int getNumStages() const noexcept { return numStages; }
+  Phase getPhase() const noexcept { return phase; }
+
+  // Round-trip (up + down) latency in host-rate samples, at DC
+  float getLatencyInSamples() const noexcept { return latency; }
+
+  // Upsamples the first one or two channels of input. The returned block points
+  // into internal storage and is valid until the next call.
+  juce::dsp::AudioBlock<float> processSamplesUp(const juce::dsp::AudioBlock<float>& input);
+
+  // Downsamples the block returned by the last processSamplesUp into output
+  void processSamplesDown(const juce::dsp::AudioBlock<float>& output);
+
+  // Multi-rate use, instead of processSamplesUp/Down: begin() with the host-rate
+  // block (level 0), then moveToLevel() to get the signal n 2x steps up. Levels
+  // have to rise and then only fall within a block, so every up and down filter
+  // still runs once and the latency is the same for any path. Moving back to
+  // level 0 writes the result into the block given to begin(). The returned
+  // block is valid until the next call.
+  void begin(const juce::dsp::AudioBlock<float>& block);
+  juce::dsp::AudioBlock<float> moveToLevel(int level);
+  int getCurrentLevel() const noexcept { return currentLevel; }
+
+  // Makes one channel's filters carry on exactly like another's, e.g. after
+  // one-channel blocks (which leave the second channel's state as it was)
+  void copyChannelState(size_t from, size_t to) noexcept;
+
+  // Number of allpass sections (IIR) or non-zero taps (FIR) per stage, for reporting
+  std::vector<int> getStageComplexity() const;
+
+  //==============================================================================
+  // Half-band allpass coefficient design (elliptic, Valenzuela & Constantinides).
+  // transition is relative to the stage's output rate, in ]0, 0.5[.
+  static int computeNumAllpassCoefficients(double attenuationDb, double transition);
+  static std::vector<double> designAllpassCoefficients(int numCoefficients, double transition);
+
+  // Kaiser-windowed half-band FIR of length 4k + 3
+  static std::vector<float> designHalfBandFir(double attenuationDb, double transition);
+
+private:
+  using SIMD = juce::dsp::SIMDRegister<float>;
+  static constexpr size_t numLanes = SIMD::SIMDNumElements;
+  static_assert(numLanes >= 4, "The IIR stages need at least four SIMD lanes");
+
+  struct Stage
+  {
+    // Minimum phase: per section, lanes { a_even, a_odd, a_even, a_odd }
+    int numSections = 0;
+    SIMD* coefficients = nullptr;
+    SIMD* upState = nullptr;
+    SIMD* downState = nullptr;
+    SIMD* lanes = nullptr;
+    SIMD* savedState = nullptr;              // second channel's lanes during one-channel blocks
+
+    // Linear phase: non-zero taps of the filtering branch (already doubled for
+    // interpolation gain) and per-channel histories
+    int numFirTaps = 0;
+    int firDelay = 0;                        // delay of the pure-delay branch, in input samples
+    int upPad = 0;                           // extra input delay going up, in input samples
+    float* firTaps = nullptr;
+    float* upHistory[2] = {};                // taps + block, linear
+    float* downHistoryEven[2] = {};
+    float* downHistoryOdd[2] = {};
+
+    // Output of this stage going up (input of this stage going down)
+    float* buffer[2] = {};
+  };
+
+  // Writes the designed allpass coefficients / FIR taps of a stage into its arena memory
+  void writeCoefficients(int stageIndex);
+
+  // Where the signal at a level lives: the host block at level 0, else the
+  // output buffer of the stage going up to that level
+  float* getLevelData(int level, size_t channel) const noexcept
+  {
+    return level == 0 ? hostBlock[channel] : stages[(size_t)(level - 1)].buffer[channel];
+  }
+
+  static void filterLanes(const Stage& stage, SIMD* state, SIMD* data, size_t numSamples) noexcept;
+
+  // One-channel blocks run all lanes anyway: put the second channel's back after
+  static void filterLanesKeepingSecond(const Stage& stage, SIMD* state, SIMD* data, size_t numSamples) noexcept;
+  void upStageIIR(Stage& stage, const float* const* in, float* const* out, size_t numChannels, size_t numSamples);
+  void downStageIIR(Stage& stage, const float* const* in, float* const* out, size_t numChannels, size_t numSamples);
+  void upStageFIR(Stage& stage, const float* const* in, float* const* out, size_t numChannels, size_t numSamples);
+  void downStageFIR(Stage& stage, const float* const* in, float* const* out, size_t numChannels, size_t numSamples);
+
+  std::array<Stage, maxStages> stages{};
+  int numStages = 0;
+  DspArena ownArena;
+
+  Phase phase = Phase::minimumPhase;
+  size_t maxBlockSize = 0;
+  size_t numChannelsUp = 0;
+  size_t numChannelsDown = 0;
+
+  // The block in flight: host-rate data, its length and the level it is at now
+  float* hostBlock[2] = {};
+  size_t numHostSamples = 0;
+  int currentLevel = 0;
+  bool goingDown = false;
+  float* levelChannels[2] = {};   // what the block returned by moveToLevel points at
+  float latency = 0.0f;
+};
@@ -0,0 +1,201 @@
+// knobSpriteSheet.cpp
+
+#include "KnobSpriteSheet.h"
+
+KnobSpriteSheet::~KnobSpriteSheet()
+{
+  decoder.removeAllJobs(true, -1);
+  cancelPendingUpdate();
+}
+
+void KnobSpriteSheet::setSource(int scale, const void* data, size_t dataSize)
+{
+  jassert(scale >= 1 && scale <= maxScale);
+
+  auto& variant = variants[(size_t)(scale - 1)];
+  variant.data = data;
+  variant.dataSize = dataSize;
+  variant.frames.clear();
+}
+
+KnobSpriteSheet::Variant& KnobSpriteSheet::getVariant(float physicalScale)
+{
+  // The 1x sheet for standard displays, the 2x one for anything denser (a 1.5x
+  // display downsamples the 2x frames rather than upsampling the 1x ones)
+  const int scale = physicalScale > 1.0f ? maxScale : 1;
+  auto& preferred = variants[(size_t)(scale - 1)];
+
+  if (preferred.data != nullptr)
+    return preferred;
+
+  // Fall back to whichever sheet is there
+  for (auto& variant : variants)
+    if (variant.data != nullptr)
+      return variant;
+
+  return preferred;
+}
+
+void KnobSpriteSheet::preload(float physicalScale)
+{
+  // A denser display gets the 1x sheet first: it decodes in a quarter of the
+  // time and stands in until the 2x one is in
+  auto& variant = getVariant(physicalScale);
+
+  if (&variant != &variants[0])
+    startDecoding(variants[0]);
+
+  startDecoding(variant);
+}
+
+void KnobSpriteSheet::startDecoding(Variant& variant)
+{
+  if (variant.data == nullptr || variant.decoding || !variant.frames.empty())
+    return;
+
+  variant.decoding = true;
+
+  const auto index = (size_t)(&variant - variants.data());
+  const void* data = variant.data;
+  const size_t dataSize = variant.dataSize;
+
+  decoder.addJob([this, index, data, dataSize]
+  {
+    auto sheet = juce::ImageFileFormat::loadFrom(data, dataSize);
+
+    {
+      const juce::ScopedLock lock(decodedLock);
+      decodedSheets[index] = std::move(sheet);
+      decodeDone[index] = true;
+    }
+
+    triggerAsyncUpdate();
+  });
+}
+
+const juce::Image& KnobSpriteSheet::getFrame(int index, float physicalScale)
+{
+  auto& variant = getVariant(physicalScale);
+
+  if (!variant.frames.empty())
+    return variant.frames[(size_t)juce::jlimit(0, (int)variant.frames.size() - 1, index)];
+
+  preload(physicalScale);
+
+  for (const auto& decoded : variants)
+    if (!decoded.frames.empty())
+      return decoded.frames[(size_t)juce::jlimit(0, (int)decoded.frames.size() - 1, index)];
+
+  return nullFrame;
+}
+
+void KnobSpriteSheet::handleAsyncUpdate()
+{
+  bool ready = false;
+
+  for (size_t i = 0; i < variants.size(); ++i)
+  {
+    juce::Image sheet;
+
+    {
+      const juce::ScopedLock lock(decodedLock);
+
+      if (!decodeDone[i])
+        continue;
+
+      sheet = std::move(decodedSheets[i]);
+      decodedSheets[i] = {};
+      decodeDone[i] = false;
+    }
+
+    auto& variant = variants[i];
+    variant.decoding = false;
+
+    const int size = sheet.getWidth() / numColumns;
+
+    if (sheet.isValid() && size > 0)
+    {
+      variant.frames.reserve((size_t)numFrames);
+
+      for (int frame = 0; frame < numFrames; ++frame)
+        variant.frames.push_back(sheet.getClippedImage({ (frame % numColumns) * size, (frame / numColumns) * size, size, size }));
+
+      ready = true;
+    }
+    else
+    {
+      DBG("Knob sprite sheet could not be decoded");
+      variant.data = nullptr;
+    }
+  }
+
+  if (ready && onFramesReady != nullptr)
+    onFramesReady();
+}
+
+juce::Image KnobSpriteSheet::pack(const juce::Array<juce::Image>& frames, int scale)
+{
+  const int size = frameSize * scale;
+  const int numRows = (frames.size() + numColumns - 1) / numColumns;
+
+  juce::Image sheet(juce::Image::ARGB, size * numColumns, size * juce::jmax(1, numRows), true);
+  juce::Image::BitmapData destination(sheet, juce::Image::BitmapData::writeOnly);
+
+  for (int i = 0; i < frames.size(); ++i)
+  {
+    const auto frame = frames[i].convertedToFormat(juce::Image::ARGB);
+    const juce::Image::BitmapData source(frame, juce::Image::BitmapData::readOnly);
+
+    resample(source, destination, (i % numColumns) * size, (i / numColumns) * size, size);
+  }
+
+  return sheet;
+}
+
+void KnobSpriteSheet::resample(const juce::Image::BitmapData& source, juce::Image::BitmapData& destination,
+                               int destinationX, int destinationY, int size)
+{
+  // Area average of the premultiplied pixels: every output pixel is the mean of
+  // the source area it covers, so no source pixel is skipped at any ratio. Doing
+  // it here rather than with Image::rescaled() also keeps the sheets independent
+  // of the renderer they are packed with.
+  const double ratioX = (double)source.width / size;
+  const double ratioY = (double)source.height / size;
+  const double area = ratioX * ratioY;
+
+  for (int y = 0; y < size; ++y)
+  {
+    const double top = y * ratioY;
+    const double bottom = top + ratioY;
+    const int lastRow = juce::jmin(source.height, (int)std::ceil(bottom));
+
+    for (int x = 0; x < size; ++x)
+    {
+      const double left = x * ratioX;
+      const double right = left + ratioX;
+      const int lastColumn = juce::jmin(source.width, (int)std::ceil(right));
+
+      double sum[4] = {};
+
+      for (int sy = (int)top; sy < lastRow; ++sy)
+      {
+        const double coverY = juce::jmin(bottom, sy + 1.0) - juce::jmax(top, (double)sy);
+
+        for (int sx = (int)left; sx < lastColumn; ++sx)
+        {
+          const double cover = coverY * (juce::jmin(right, sx + 1.0) - juce::jmax(left, (double)sx));
+          const auto* pixel = reinterpret_cast<const juce::PixelARGB*>(source.getPixelPointer(sx, sy));
+
+          sum[0] += cover * pixel->getAlpha();
+          sum[1] += cover * pixel->getRed();
+          sum[2] += cover * pixel->getGreen();
+          sum[3] += cover * pixel->getBlue();
+        }
+      }
+
+      auto* pixel = reinterpret_cast<juce::PixelARGB*>(destination.getPixelPointer(destinationX + x, destinationY + y));
+      pixel->setARGB((juce::uint8)juce::roundToInt(sum[0] / area), (juce::uint8)juce::roundToInt(sum[1] / area),
+                     (juce::uint8)juce::roundToInt(sum[2] / area), (juce::uint8)juce::roundToInt(sum[3] / area));
+    }
+  }
+}
@@ -0,0 +1,81 @@
+// knobSpriteSheet.h
+
+#pragma once
+
+#include <JuceHeader.h>
+
+/**
+    The knob filmstrip packed into a single sprite sheet: numFrames frames in a
+    grid numColumns wide, each frame at the size the editor draws the knob, plus
+    a 2x copy of the sheet for HiDPI displays. The sheets are made from
+    Resources/Knob_2 by the tools' "pack-knobs" command (see pack()); the frames
+    are translucent throughout (a soft shadow), so they stay RGBA PNGs.
+
+    Decoding costs about 30 ns per pixel (libpng, one core): 70-100 ms for the
+    1x sheet (1800 px square), 360-440 ms for the 2x one (3600 px). It runs on a
+    background thread, so neither opening the editor nor its first paint waits:
+    preload() starts it as the editor opens. A HiDPI display decodes the 1x sheet
+    first and draws it scaled up until the 2x sheet is in. A frame asked for
+    before any sheet is in comes back null (the knob is drawn once onFramesReady
+    says so). Frames share the sheet's pixels, nothing is copied.
+*/
+class KnobSpriteSheet : private juce::AsyncUpdater
+{
+public:
+  static constexpr int numFrames = 100;
+  static constexpr int numColumns = 10;
+  static constexpr int frameSize = 180;   // knob size in the editor, in logical pixels
+  static constexpr int maxScale = 2;
+
+  KnobSpriteSheet() = default;
+  ~KnobSpriteSheet() override;
+
+  // Encoded sheets, frameSize * scale pixels per frame. The data must outlive
+  // this object (BinaryData does).
+  void setSource(int scale, const void* data, size_t dataSize);
+
+  // Starts decoding the sheet for a physical pixel scale, if it isn't yet
+  void preload(float physicalScale);
+
+  // The frame to draw at the given physical pixel scale, or the 1x one while the
+  // 2x sheet is being decoded (which this starts). Null until a sheet is in.
+  const juce::Image& getFrame(int index, float physicalScale);
+
+  // Message thread, when a sheet has been decoded (e.g. to repaint the knobs)
+  std::function<void()> onFramesReady;
+
+  // Lays frames out on a sheet, resampling each one to frameSize * scale pixels
+  static juce::Image pack(const juce::Array<juce::Image>& frames, int scale);
+
+private:
+  // Resamples an ARGB image into a size x size square of destination at (x, y)
+  static void resample(const juce::Image::BitmapData& source, juce::Image::BitmapData& destination,
+                       int destinationX, int destinationY, int size);
+
+  struct Variant
+  {
+    const void* data = nullptr;
+    size_t dataSize = 0;
+    bool decoding = false;
+    std::vector<juce::Image> frames;   // cut from the decoded sheet on the message thread
+  };
+
+  Variant& getVariant(float physicalScale);
+  void startDecoding(Variant& variant);
+
+  // Cuts the frames from the sheets the decoder has finished
+  void handleAsyncUpdate() override;
+
+  std::array<Variant, maxScale> variants;
+  juce::Image nullFrame;
+
+  // Written by the decoder, taken by handleAsyncUpdate
+  juce::CriticalSection decodedLock;
+  std::array<juce::Image, maxScale> decodedSheets;
+  std::array<bool, maxScale> decodeDone{};
+
+  // Declared last: destroyed first, waiting for a decode still running
+  juce::ThreadPool decoder{ 1 };
+
+  JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(KnobSpriteSheet)
+};
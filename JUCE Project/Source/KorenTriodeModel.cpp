@@ -3,7 +3,8 @@
 
 // -----------------------------------------------------------------------------
 // Directly computes ln(1 + e^x) and logistic(e^x / (1 + e^x)) 
-// on each iteration, instead of using a lookup table.
+// on each iteration, instead of using a lookup table. Both from e^-|x|, so a
+// grid driven far positive doesn't overflow (e^x is inf in float from x = 89).
 
 static float newtonSolveVp(float Vgk,
   float B_plus,
@@ -26,9 +27,9 @@ static float newtonSolveVp(float Vgk,
     float x = (Vgk + (Vp * invMu)) * invC;
 
     // Compute ln(1 + e^x) and logistic in real-time:
-    float ex = std::exp(x);
-    float lnpart = std::log1p(ex);           // ln(1 + e^x)
-    float logistic = ex / (1.0f + ex);          // e^x / (1 + e^x)
+    float ex = std::exp(-std::fabs(x));
+    float lnpart = juce::jmax(x, 0.0f) + std::log1p(ex);           // ln(1 + e^x)
+    float logistic = (x >= 0.0f ? 1.0f : ex) / (1.0f + ex);         // e^x / (1 + e^x)
 
     // Plate current: Ip = G * [ ln(1 + e^x) ]^P
     float lnpartP = std::pow(lnpart, P);      // lnpart^P
@@ -60,6 +61,33 @@ static float newtonSolveVp(float Vgk,
   return Vp;
 }
 
+// Same equations in double precision, run to convergence. For fitting the
+// small-signal expansion, where the float solve's rounding would swamp the
+// finite differences.
+static double preciseSolveVp(double Vgk, const KorenTriodeModel::Stage& stage, double Vp_init)
+{
+  const double mu = stage.mu, C = stage.C, P = stage.P, G = stage.G, Rp = stage.Rp;
+  double Vp = Vp_init;
+
+  for (int i = 0; i < 100; ++i)
+  {
+    const double x = (Vgk + Vp / mu) / C;
+    const double lnpart = x > 30.0 ? x : std::log1p(std::exp(x));
+    const double logistic = 1.0 / (1.0 + std::exp(-x));
+    const double Ip = G * std::pow(lnpart, P);
+    const double f = (Vp - stage.B_plus) + Ip * Rp;
+
+    const double dIp_dVp = lnpart > 1e-300 ? G * P * std::pow(lnpart, P - 1.0) * logistic / (C * mu) : 0.0;
+    const double step = f / (1.0 + Rp * dIp_dVp);
+    Vp -= step;
+
+    if (std::abs(step) < 1e-11)
+      break;
+  }
+
+  return Vp;
+}
+
 // -----------------------------------------------------------------------------
 // KorenTriodeModel
 
@@ -111,3 +139,138 @@ void KorenTriodeModel::processAudioBlock(const juce::dsp::AudioBlock<float>& blo
     }
   }
 }
+
+void KorenTriodeModel::processAudioBlock(const juce::dsp::AudioBlock<float>& block, const Stage& stage,
+  int   maxIter,
+  float tol)
+{
+  processAudioBlock(block, stage.gainVal, stage.bias, stage.drive, stage.G, stage.mu, stage.C, stage.P,
+    stage.B_plus, stage.Rp, maxIter, tol);
+}
+
+KorenTriodeModel::SmallSignal KorenTriodeModel::computeSmallSignal(const Stage& stage, float quiescentInput)
+{
+  const double center = (double)quiescentInput * stage.drive + stage.bias;
+
+  // Five-point finite differences around the quiescent point
+  const double h = 0.02;
+  double f[5];
+  for (int k = 0; k < 5; ++k)
+    f[k] = preciseSolveVp(center + (k - 2) * h, stage, stage.B_plus);
+
+  const double c0 = f[2];
+  const double c1 = (f[0] - 8.0 * f[1] + 8.0 * f[3] - f[4]) / (12.0 * h);
+  const double c2 = (-f[0] + 16.0 * f[1] - 30.0 * f[2] + 16.0 * f[3] - f[4]) / (24.0 * h * h);
+  const double c3 = (f[4] - 2.0 * f[3] + 2.0 * f[1] - f[0]) / (12.0 * h * h * h);
+  const double c4 = (f[4] - 4.0 * f[3] + 6.0 * f[2] - 4.0 * f[1] + f[0]) / (24.0 * h * h * h * h);
+
+  SmallSignal result;
+  result.center = (float)center;
+  result.c0 = (float)c0;
+  result.c1 = (float)c1;
+  result.c2 = (float)c2;
+  result.c3 = (float)c3;
+
+  auto polynomial = [&](double d) { return c0 + d * (c1 + d * (c2 + d * c3)); };
+
+  // The remainder is about c4 d^4: start there, then shrink the window until the
+  // expansion holds against the full solve at its edges and half way out
+  double window = std::abs(c4) > 1e-12 ? std::pow((double)smallSignalTolerance / std::abs(c4), 0.25) : 4.0;
+  window = juce::jmin(window, 4.0);
+
+  for (int attempt = 0; attempt < 12; ++attempt, window *= 0.7)
+  {
+    double error = 0.0;
+    for (const double d : { -window, -0.5 * window, 0.5 * window, window })
+      error = juce::jmax(error, std::abs(polynomial(d) - preciseSolveVp(center + d, stage, c0)));
+
+    if (error <= 0.5 * smallSignalTolerance)
+    {
+      result.window = (float)window;
+      break;
+    }
+  }
+
+  return result;
+}
+
+void KorenTriodeModel::processAudioBlock(const juce::dsp::AudioBlock<float>& block, const Stage& stage,
+  const SmallSignal& smallSignal, FastPathStats& stats, int maxIter, float tol)
+{
+  const float scale = (stage.gainVal / 300.0f);
+  float Vp_guess = stage.B_plus;
+
+  const auto numChannels = block.getNumChannels();
+  const auto numSamples = block.getNumSamples();
+
+  int fast = 0;
+
+  for (size_t ch = 0; ch < numChannels; ++ch)
+  {
+    float* chanData = block.getChannelPointer(ch);
+
+    for (size_t i = 0; i < numSamples; ++i)
+    {
+      const float Vgk = (chanData[i] * stage.drive) + stage.bias;
+      const float d = Vgk - smallSignal.center;
+
+      if (std::abs(d) < smallSignal.window)
+      {
+        // Also a good starting point for the next sample that needs the solve
+        Vp_guess = smallSignal.c0 + d * (smallSignal.c1 + d * (smallSignal.c2 + d * smallSignal.c3));
+        ++fast;
+      }
+      else
+      {
+        Vp_guess = solveForVp(Vgk, stage.B_plus, stage.Rp, stage.G, stage.mu, stage.C, stage.P, maxIter, tol, Vp_guess);
+      }
+
+      chanData[i] = Vp_guess * scale;
+    }
+  }
+
+  stats.fastSamples += fast;
+  stats.solvedSamples += (int)(numChannels * numSamples) - fast;
+}
+
+double KorenTriodeModel::processSamplePrecise(double input, const Stage& stage, double& Vp, double& slope)
+{
+  const double Vgk = input * stage.drive + stage.bias;
+  Vp = preciseSolveVp(Vgk, stage, Vp);
+
+  // Implicit derivative: with k = Rp dIp/dVp, dVp/dVgk = -mu k / (1 + k)
+  const double x = (Vgk + Vp / stage.mu) / stage.C;
+  const double lnpart = x > 30.0 ? x : std::log1p(std::exp(x));
+  const double logistic = 1.0 / (1.0 + std::exp(-x));
+  const double k = lnpart > 1e-300
+    ? stage.Rp * stage.G * stage.P * std::pow(lnpart, stage.P - 1.0) * logistic / (stage.C * stage.mu)
+    : 0.0;
+
+  const double scale = stage.gainVal / 300.0;
+  slope = -stage.mu * k / (1.0 + k) * stage.drive * scale;
+  return Vp * scale;
+}
+
+void KorenTriodeModel::processAudioBlockPrecise(const juce::dsp::AudioBlock<float>& block, const Stage& stage)
+{
+  const auto numChannels = block.getNumChannels();
+  const auto numSamples = block.getNumSamples();
+
+  for (size_t ch = 0; ch < numChannels; ++ch)
+  {
+    float* chanData = block.getChannelPointer(ch);
+    double Vp = stage.B_plus;
+    double slope = 0.0;
+
+    for (size_t i = 0; i < numSamples; ++i)
+      chanData[i] = (float)processSamplePrecise(chanData[i], stage, Vp, slope);
+  }
+}
+
+float KorenTriodeModel::processSample(float input, const Stage& stage, int maxIter, float tol)
+{
+  const float Vgk = (input * stage.drive) + stage.bias;
+  const float Vp = solveForVp(Vgk, stage.B_plus, stage.Rp, stage.G, stage.mu, stage.C, stage.P,
+    maxIter, tol, stage.B_plus);
+  return Vp * (stage.gainVal / 300.0f);
+}
@@ -11,6 +11,20 @@ public:
   KorenTriodeModel() = default;
   ~KorenTriodeModel() = default;
 
+  // Operating parameters of one triode stage
+  struct Stage
+  {
+    float gainVal;
+    float bias;
+    float drive;
+    float G;
+    float mu;
+    float C;
+    float P;
+    float B_plus;
+    float Rp;
+  };
+
   // Solve for Vp given an input, using Korens equations
   static float solveForVp(float Vgk, float B_plus, float Rp, float G, float mu, float C, float P,
     int maxIter = 5, float tol = 1e-7, float Vp_init = 200.0f);
@@ -23,6 +37,51 @@ public:
     float B_plus, float Rp,
     int maxIter = 8, float tol = 1e-5);
 
+  static void processAudioBlock(const juce::dsp::AudioBlock<float>& block, const Stage& stage,
+    int maxIter = 8, float tol = 1e-5);
+
+  /** Cubic Taylor expansion of the converged Vp(Vgk) around a stage's quiescent
+      grid voltage. Within window volts of center it stays within
+      smallSignalTolerance volts of the full solve; window 0 means no fast path. */
+  struct SmallSignal
+  {
+    float center = 0.0f;
+    float window = 0.0f;
+    float c0 = 0.0f, c1 = 0.0f, c2 = 0.0f, c3 = 0.0f;
+  };
+
+  // At the plate. End to end the chain is then as far from a fully converged
+  // solve as the 8-iteration float solve already is.
+  static constexpr float smallSignalTolerance = 1.0e-3f;
+
+  // Expansion around the grid voltage of an input of quiescentInput. Solves the
+  // stage a dozen times in double precision, so not for every sample.
+  static SmallSignal computeSmallSignal(const Stage& stage, float quiescentInput);
+
+  // Samples that took the polynomial vs. the Newton solve
+  struct FastPathStats
+  {
+    int fastSamples = 0;
+    int solvedSamples = 0;
+  };
+
+  // As above, but samples within the expansion's window skip the Newton solve
+  static void processAudioBlock(const juce::dsp::AudioBlock<float>& block, const Stage& stage,
+    const SmallSignal& smallSignal, FastPathStats& stats, int maxIter = 8, float tol = 1e-5);
+
+  // Static (converged) transfer of a single input sample through one stage.
+  // Not meant for the audio path, used to find operating points and gains.
+  static float processSample(float input, const Stage& stage, int maxIter = 50, float tol = 1e-6f);
+
+  // The same, solved to convergence in double precision, with the slope of the
+  // output over the input. Vp is where the solve starts and is set to the plate
+  // voltage found, so neighbouring inputs can carry it on.
+  static double processSamplePrecise(double input, const Stage& stage, double& Vp, double& slope);
+
+  // Every sample through processSamplePrecise. Far too slow for the audio path,
+  // it is the reference the float solve is measured against.
+  static void processAudioBlockPrecise(const juce::dsp::AudioBlock<float>& block, const Stage& stage);
+
 private:
 };
 
@@ -0,0 +1,80 @@
+// makeupGain.cpp
+
+#include "MakeupGain.h"
+
+namespace
+{
+  // Makeup gain in dB by drive (rows, minDrive to maxDrive) and bias (columns,
+  // minBias to maxBias). Measured with the tools' makeup-scan command at 44.1 kHz.
+  constexpr float gainTable[MakeupGain::numDrives][MakeupGain::numBiases] =
+  {
+    {  43.25f,  43.09f,  42.97f,  42.89f,  42.86f,  42.87f,  42.93f,  43.06f,  43.32f },   // 0.2500
+    {  31.46f,  31.23f,  31.04f,  30.90f,  30.81f,  30.79f,  30.87f,  31.10f,  31.55f },   // 0.3125
+    {  22.08f,  21.81f,  21.60f,  21.44f,  21.37f,  21.42f,  21.66f,  22.07f,  22.60f },   // 0.3750
+    {  14.28f,  14.03f,  13.85f,  13.80f,  13.91f,  14.17f,  14.52f,  14.93f,  15.40f },   // 0.4375
+    {   7.68f,   7.52f,   7.55f,   7.72f,   7.97f,   8.26f,   8.59f,   8.97f,   9.38f },   // 0.5000
+    {   2.25f,   2.31f,   2.46f,   2.67f,   2.91f,   3.19f,   3.50f,   3.84f,   4.20f },   // 0.5625
+    {  -1.68f,  -1.83f,  -1.83f,  -1.70f,  -1.50f,  -1.26f,  -0.98f,  -0.68f,  -0.35f },   // 0.6250
+    {  -4.71f,  -4.89f,  -5.05f,  -5.18f,  -5.24f,  -5.15f,  -4.95f,  -4.69f,  -4.40f },   // 0.6875
+    {  -7.45f,  -7.60f,  -7.74f,  -7.87f,  -7.99f,  -8.09f,  -8.16f,  -8.13f,  -7.91f },   // 0.7500
+    {  -9.85f,  -9.90f,  -9.88f,  -9.82f,  -9.74f,  -9.64f,  -9.52f,  -9.41f,  -9.28f },   // 0.8125
+    { -10.67f, -10.59f, -10.51f, -10.42f, -10.33f, -10.23f, -10.13f, -10.03f,  -9.92f },   // 0.8750
+    { -11.24f, -11.16f, -11.09f, -11.01f, -10.93f, -10.84f, -10.75f, -10.65f, -10.56f },   // 0.9375
+    { -11.82f, -11.75f, -11.68f, -11.61f, -11.54f, -11.46f, -11.38f, -11.30f, -11.22f }    // 1.0000
+  };
+
+  // Correlation of the full-mix output with the input, on the same grid and
+  // measured in the same run
+  constexpr float correlationTable[MakeupGain::numDrives][MakeupGain::numBiases] =
+  {
+    {  -0.37f,  -0.37f,  -0.37f,  -0.37f,  -0.37f,  -0.37f,  -0.37f,  -0.37f,  -0.37f },   // 0.2500
+    {  -0.37f,  -0.37f,  -0.37f,  -0.37f,  -0.37f,  -0.37f,  -0.37f,  -0.37f,  -0.36f },   // 0.3125
+    {  -0.37f,  -0.37f,  -0.37f,  -0.37f,  -0.37f,  -0.37f,  -0.36f,  -0.36f,  -0.35f },   // 0.3750
+    {  -0.36f,  -0.36f,  -0.36f,  -0.36f,  -0.36f,  -0.36f,  -0.35f,  -0.35f,  -0.34f },   // 0.4375
+    {  -0.35f,  -0.36f,  -0.35f,  -0.35f,  -0.35f,  -0.35f,  -0.34f,  -0.34f,  -0.34f },   // 0.5000
+    {  -0.35f,  -0.35f,  -0.35f,  -0.34f,  -0.34f,  -0.34f,  -0.34f,  -0.34f,  -0.33f },   // 0.5625
+    {  -0.34f,  -0.34f,  -0.34f,  -0.34f,  -0.34f,  -0.34f,  -0.34f,  -0.33f,  -0.33f },   // 0.6250
+    {  -0.33f,  -0.34f,  -0.34f,  -0.34f,  -0.33f,  -0.33f,  -0.33f,  -0.33f,  -0.33f },   // 0.6875
+    {  -0.33f,  -0.33f,  -0.33f,  -0.33f,  -0.33f,  -0.33f,  -0.33f,  -0.33f,  -0.33f },   // 0.7500
+    {  -0.33f,  -0.33f,  -0.33f,  -0.33f,  -0.33f,  -0.33f,  -0.32f,  -0.32f,  -0.32f },   // 0.8125
+    {  -0.32f,  -0.32f,  -0.32f,  -0.32f,  -0.32f,  -0.32f,  -0.32f,  -0.32f,  -0.32f },   // 0.8750
+    {  -0.32f,  -0.32f,  -0.32f,  -0.32f,  -0.32f,  -0.32f,  -0.32f,  -0.32f,  -0.32f },   // 0.9375
+    {  -0.32f,  -0.32f,  -0.32f,  -0.32f,  -0.32f,  -0.32f,  -0.32f,  -0.32f,  -0.32f }    // 1.0000
+  };
+
+  float interpolate(const float (&table)[MakeupGain::numDrives][MakeupGain::numBiases], float drive, float bias) noexcept
+  {
+    using M = MakeupGain;
+    const float x = juce::jlimit(0.0f, (float)(M::numDrives - 1), (drive - M::minDrive) / (M::maxDrive - M::minDrive) * (float)(M::numDrives - 1));
+    const float y = juce::jlimit(0.0f, (float)(M::numBiases - 1), (bias - M::minBias) / (M::maxBias - M::minBias) * (float)(M::numBiases - 1));
+
+    const int row = juce::jmin((int)x, M::numDrives - 2);
+    const int column = juce::jmin((int)y, M::numBiases - 2);
+    const float s = x - (float)row;
+    const float t = y - (float)column;
+
+    const float upper = table[row][column] + t * (table[row][column + 1] - table[row][column]);
+    const float lower = table[row + 1][column] + t * (table[row + 1][column + 1] - table[row + 1][column]);
+    return upper + s * (lower - upper);
+  }
+}
+
+float MakeupGain::getGainDb(float drive, float bias) noexcept
+{
+  return interpolate(gainTable, drive, bias);
+}
+
+float MakeupGain::getCorrelation(float drive, float bias) noexcept
+{
+  return interpolate(correlationTable, drive, bias);
+}
+
+float MakeupGain::getGainDb(float drive, float bias, float mix) noexcept
+{
+  const float dry = 1.0f - juce::jlimit(0.0f, 1.0f, mix);
+  const float wet = juce::jlimit(0.0f, 1.0f, mix) * juce::Decibels::decibelsToGain(-getGainDb(drive, bias));
+
+  // Never negative with a measured correlation; interpolated ones could get close
+  const float power = dry * dry + wet * wet + 2.0f * dry * wet * getCorrelation(drive, bias);
+  return -10.0f * std::log10(juce::jmax(power, 1.0e-6f));
+}
@@ -0,0 +1,54 @@
+// makeupGain.h
+
+#pragma once
+
+#include <JuceHeader.h>
+
+/**
+    Calibrated makeup gain: how much the engine changes the level of a signal, by
+    drive and bias, so the auto-gain can bring the output back to the input's
+    loudness without measuring anything while it plays.
+
+    The table is measured offline with the tools' makeup-scan command: stereo pink
+    noise at referenceLevelDb RMS through the engine as the processor runs it by
+    default (L/R, 2x, full mix), input RMS over output RMS. The gain goes on the
+    engine's output ahead of the brickwall limiter. Between the grid points it is
+    interpolated bilinearly, in dB.
+
+    Below full mix the dry signal adds to the wet one as a signal, not as a level:
+    the wet is far quieter than the dry at low drive, and partly out of phase with
+    it around the middle of the range. So the scan also measures the output's
+    correlation with the input, and the gain at a mix comes from both tables.
+
+    It is a fixed gain per setting, like an amp's master volume: input louder than
+    the reference is compressed harder and comes out quieter than it went in,
+    quieter input the other way round.
+*/
+class MakeupGain
+{
+public:
+  // The grid: the drive parameter's range and the bias parameter's
+  static constexpr float minDrive = 0.25f;
+  static constexpr float maxDrive = 1.0f;
+  static constexpr int numDrives = 13;
+
+  static constexpr float minBias = 0.0f;
+  static constexpr float maxBias = 2.0f;
+  static constexpr int numBiases = 9;
+
+  static constexpr float referenceLevelDb = -18.0f;
+
+  static float getDrive(int index) noexcept { return minDrive + (maxDrive - minDrive) * (float)index / (float)(numDrives - 1); }
+  static float getBias(int index) noexcept { return minBias + (maxBias - minBias) * (float)index / (float)(numBiases - 1); }
+
+  // Gain in dB that brings the engine's output at full mix back to its input level
+  static float getGainDb(float drive, float bias) noexcept;
+
+  // Correlation of the engine's output at full mix with its input
+  static float getCorrelation(float drive, float bias) noexcept;
+
+  // With the dry signal mixed in. Relative to the input, the mix has a power of
+  // (1 - mix)^2 + (mix / g)^2 + 2 mix (1 - mix) c / g, with g the full-mix gain
+  // and c the correlation (none at all dry).
+  static float getGainDb(float drive, float bias, float mix) noexcept;
+};
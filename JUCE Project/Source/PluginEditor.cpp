@@ -3,7 +3,7 @@
 //==============================================================================
 ImperialTriodeOverlordAudioProcessorEditor::ImperialTriodeOverlordAudioProcessorEditor
 (ImperialTriodeOverlordAudioProcessor& p)
-  : AudioProcessorEditor(&p), processor(p)
+  : AudioProcessorEditor(&p), processor(p), analyzer(p.getAnalysisTap())
 {
   // Set the size of the editor
   const float bgrSizeX = 1130.0f;
@@ -11,6 +11,9 @@ ImperialTriodeOverlordAudioProcessorEditor::ImperialTriodeOverlordAudioProcessor
   const float scaleUI = 0.6f;
   setSize((int)(bgrSizeX * scaleUI), (int)(bgrSizeY * scaleUI));
 
+  // The background covers the whole editor, so nothing behind it needs painting
+  setOpaque(true);
+
   // Setup the sliders
   setupSlider(driveSlider, "drive");
   setupSlider(mixSlider, "mix");
@@ -33,6 +36,30 @@ ImperialTriodeOverlordAudioProcessorEditor::ImperialTriodeOverlordAudioProcessor
     processor.setBypass(bypassButton.getToggleState());
   };
 
+  // Analyzer overlay, hidden until the scope button is toggled
+  addChildComponent(analyzerView);
+  scopeButton.setClickingTogglesState(true);
+  addAndMakeVisible(scopeButton);
+
+  scopeButton.onClick = [this]
+  {
+    analyzerView.setVisible(scopeButton.getToggleState());
+    updateTimerState();
+  };
+
+  addAndMakeVisible(cabinetButton);
+  cabinetButton.onClick = [this] { showCabinetMenu(); };
+  updateCabinetButton();
+
+  fixedBlocksButton.setClickingTogglesState(true);
+  fixedBlocksButton.setToggleState(processor.getBlockAccumulation(), juce::dontSendNotification);
+  addAndMakeVisible(fixedBlocksButton);
+
+  fixedBlocksButton.onClick = [this]
+  {
+    processor.setBlockAccumulation(fixedBlocksButton.getToggleState());
+  };
+
 #if DEBUG
   // File playback buttons + labels
   addAndMakeVisible(loadButton);
@@ -54,29 +81,22 @@ ImperialTriodeOverlordAudioProcessorEditor::ImperialTriodeOverlordAudioProcessor
   addAndMakeVisible(stopLabel);
 #endif
 
-  // Start the timer to refresh UI ~30x/sec
-  startTimerHz(30);
+  // The UI timer is started once the editor is actually showing (see updateTimerState)
 
-  // Load your multi-frame knob images from BinaryData
-  // The code below is just an example approach; adjust to your actual resource names.
-
-  for (int i = 1; i <= 100; ++i)
+  // Knob frames come from one packed sprite sheet (1x and 2x). The sheet for the
+  // display's scale is decoded in the background (the 1x one first on HiDPI
+  // displays, standing in meanwhile); the knobs paint once a sheet is in.
+  knobSheet.setSource(1, BinaryData::KnobSheet_png, (size_t)BinaryData::KnobSheet_pngSize);
+  knobSheet.setSource(2, BinaryData::KnobSheet2x_png, (size_t)BinaryData::KnobSheet2x_pngSize);
+  knobSheet.onFramesReady = [this]
   {
-    // Build a resource name. It might be something like "Knob_0001_png" depending on your naming.
-    auto resourceName = "_" + juce::String(i).paddedLeft('0', 4) + "_png";
-    int dataSize = 0;
+    driveSlider.repaint();
+    mixSlider.repaint();
+    biasSlider.repaint();
+  };
 
-    if (auto* dataPtr = BinaryData::getNamedResource(resourceName.toRawUTF8(), dataSize))
-    {
-      auto image = juce::ImageFileFormat::loadFrom(dataPtr, (size_t)dataSize);
-      if (image.isValid())
-        knobFrames.push_back(image);
-    }
-    else
-    {
-      DBG("Resource not found: " << resourceName);
-    }
-  }
+  if (auto* display = juce::Desktop::getInstance().getDisplays().getPrimaryDisplay())
+    knobSheet.preload((float)display->scale);
 
   // Example for "stepped" knobs:
   steppedKnobFrames.push_back(juce::ImageFileFormat::loadFrom(BinaryData::StepKnob1_png, BinaryData::StepKnob1_pngSize));
@@ -84,7 +104,7 @@ ImperialTriodeOverlordAudioProcessorEditor::ImperialTriodeOverlordAudioProcessor
   steppedKnobFrames.push_back(juce::ImageFileFormat::loadFrom(BinaryData::StepKnob2_png, BinaryData::StepKnob2_pngSize));
 
   // Assign these frames to the LookAndFeels
-  knobLookAndFeel.setKnobFrames(knobFrames);
+  knobLookAndFeel.setKnobSheet(&knobSheet);
   steppedKnobLookAndFeel.setKnobFrames(steppedKnobFrames);
 
   // Let our sliders use the custom LNFs
@@ -100,6 +120,8 @@ ImperialTriodeOverlordAudioProcessorEditor::ImperialTriodeOverlordAudioProcessor
 //==============================================================================
 ImperialTriodeOverlordAudioProcessorEditor::~ImperialTriodeOverlordAudioProcessorEditor()
 {
+  analyzer.setActive(false);
+
   // Important: always clear the slider's LNF before the LNF itself is destroyed
   driveSlider.setLookAndFeel(nullptr);
   mixSlider.setLookAndFeel(nullptr);
@@ -139,14 +161,31 @@ void ImperialTriodeOverlordAudioProcessorEditor::setupSlider(juce::Slider& s,
 //==============================================================================
 void ImperialTriodeOverlordAudioProcessorEditor::paint(juce::Graphics& g)
 {
-  g.fillAll(juce::Colours::darkgrey);
-
-  // If the image is valid, draw it
-  if (bgImage.isValid())
+  // Rebuild the pre-scaled background only when the size or display scale changes,
+  // so a normal repaint is a single unscaled blit
+  const float scale = g.getInternalContext().getPhysicalPixelScaleFactor();
+  const int physicalWidth = juce::roundToInt((float)getWidth() * scale);
+  const int physicalHeight = juce::roundToInt((float)getHeight() * scale);
+
+  if (scaledBgImage.isNull() || scale != scaledBgScale
+    || scaledBgImage.getWidth() != physicalWidth || scaledBgImage.getHeight() != physicalHeight)
   {
-    g.drawImage(bgImage, getLocalBounds().toFloat());
+    scaledBgImage = juce::Image(juce::Image::RGB, juce::jmax(1, physicalWidth), juce::jmax(1, physicalHeight), false);
+    scaledBgScale = scale;
+
+    juce::Graphics bg(scaledBgImage);
+    bg.fillAll(juce::Colours::darkgrey);
+
+    // If the image is valid, draw it
+    if (bgImage.isValid())
+    {
+      bg.setImageResamplingQuality(juce::Graphics::highResamplingQuality);
+      bg.drawImage(bgImage, scaledBgImage.getBounds().toFloat());
+    }
   }
 
+  g.drawImage(scaledBgImage, getLocalBounds().toFloat());
+
   // You could also overlay RMS text or other UI elements here
   // For example:
   // g.setColour(juce::Colours::white);
@@ -159,6 +198,11 @@ void ImperialTriodeOverlordAudioProcessorEditor::resized()
 {
   auto area = getLocalBounds().reduced(10);
 
+  scopeButton.setBounds(getWidth() - 80, 4, 76, 20);
+  cabinetButton.setBounds(getWidth() - 240, 4, 156, 20);
+  fixedBlocksButton.setBounds(getWidth() - 350, 4, 106, 20);
+  analyzerView.setBounds(area.withTrimmedTop(20));
+
 #if DEBUG
   // Place debug buttons + labels across the top
   {
@@ -199,6 +243,57 @@ void ImperialTriodeOverlordAudioProcessorEditor::resized()
   }
 }
 
+//==============================================================================
+void ImperialTriodeOverlordAudioProcessorEditor::showCabinetMenu()
+{
+  juce::PopupMenu menu;
+  menu.addItem("Load impulse response...", [this]
+  {
+    auto chooser = std::make_unique<juce::FileChooser>(
+      "Select a cabinet impulse response...",
+      juce::File{},
+      "*.wav;*.aif;*.aiff");
+
+    constexpr int chooserFlags = juce::FileBrowserComponent::openMode
+      | juce::FileBrowserComponent::canSelectFiles;
+
+    chooser->launchAsync(chooserFlags, [this](const juce::FileChooser& fc)
+      {
+        auto file = fc.getResult();
+        juce::String error;
+
+        if (file.existsAsFile() && !processor.loadCabinet(file, error))
+          juce::AlertWindow::showMessageBoxAsync(juce::AlertWindow::WarningIcon, "Cabinet", error);
+
+        updateCabinetButton();
+      });
+
+    cabinetChooser = std::move(chooser);
+  });
+
+  // Why the saved cabinet isn't loaded (the error names the file)
+  if (processor.isCabinetMissing())
+    menu.addItem(processor.getCabinetError(), false, false, nullptr);
+
+  menu.addItem("No cabinet", processor.getCabinetName().isNotEmpty() || processor.isCabinetMissing(), false, [this]
+  {
+    processor.clearCabinet();
+    updateCabinetButton();
+  });
+
+  menu.showMenuAsync(juce::PopupMenu::Options().withTargetComponent(&cabinetButton));
+}
+
+void ImperialTriodeOverlordAudioProcessorEditor::updateCabinetButton()
+{
+  const auto name = processor.getCabinetName();
+
+  if (processor.isCabinetMissing())
+    cabinetButton.setButtonText("Cab missing: " + processor.getCabinetFile().getFileNameWithoutExtension());
+  else
+    cabinetButton.setButtonText(name.isNotEmpty() ? "Cab: " + name : "No cabinet");
+}
+
 //==============================================================================
 void ImperialTriodeOverlordAudioProcessorEditor::buttonClicked(juce::Button* button)
 {
@@ -237,7 +332,59 @@ void ImperialTriodeOverlordAudioProcessorEditor::buttonClicked(juce::Button* but
 //==============================================================================
 void ImperialTriodeOverlordAudioProcessorEditor::timerCallback()
 {
-  // Poll the processor's RMS level to display in the editor
-  currentRms = processor.getRmsLevel();
-  repaint();
+  // Poll the processor's RMS level to display in the editor.
+  // Knobs repaint themselves through their attachments when their value changes,
+  // so there is no blanket repaint() here.
+  const float rms = processor.getRmsLevel();
+  bool changed = std::abs(rms - currentRms) > 1.0e-4f;
+  currentRms = rms;
+
+  // The analyzer overlay animates, so it keeps the timer at the full rate
+  if (analyzerView.isVisible())
+  {
+    analyzerView.refresh(analyzer);
+    changed = true;
+  }
+
+  if (changed)
+  {
+    idleTicks = 0;
+
+    if (getTimerInterval() != 1000 / activeTimerHz)
+      startTimerHz(activeTimerHz);
+  }
+  else if (++idleTicks == activeTimerHz)
+  {
+    // Nothing has moved for a second, poll at the idle rate
+    startTimerHz(idleTimerHz);
+  }
+}
+
+//==============================================================================
+void ImperialTriodeOverlordAudioProcessorEditor::visibilityChanged()
+{
+  updateTimerState();
+}
+
+void ImperialTriodeOverlordAudioProcessorEditor::parentHierarchyChanged()
+{
+  updateTimerState();
+}
+
+void ImperialTriodeOverlordAudioProcessorEditor::updateTimerState()
+{
+  analyzer.setActive(isShowing() && analyzerView.isVisible());
+
+  if (isShowing())
+  {
+    if (!isTimerRunning())
+    {
+      idleTicks = 0;
+      startTimerHz(activeTimerHz);
+    }
+  }
+  else
+  {
+    stopTimer();
+  }
 }
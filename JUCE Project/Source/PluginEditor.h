@@ -3,6 +3,9 @@
 #include <JuceHeader.h>
 #include <BinaryData.h>  // If your resource data is compiled into BinaryData
 #include "PluginProcessor.h"
+#include "TubeAnalyzer.h"
+#include "AnalyzerView.h"
+#include "KnobSpriteSheet.h"
 
 /**
     A custom LookAndFeel to handle multi-frame knobs.
@@ -16,6 +19,14 @@ public:
   void setKnobFrames(const std::vector<juce::Image>& frames)
   {
     knobFrames = frames;
+    scaledFrames.clear();
+  }
+
+  // Draws from a sprite sheet instead of separate frames. The sheet must outlive this.
+  void setKnobSheet(KnobSpriteSheet* sheet)
+  {
+    knobSheet = sheet;
+    scaledFrames.clear();
   }
 
   void drawRotarySlider(juce::Graphics& g,
@@ -24,16 +35,21 @@ public:
     float rotaryStartAngle, float rotaryEndAngle,
     juce::Slider& slider) override
   {
-    if (knobFrames.empty())
+    const int numFrames = knobSheet != nullptr ? KnobSpriteSheet::numFrames : (int)knobFrames.size();
+    if (numFrames == 0)
       return; // Avoid crashing if no images are loaded
 
-    const int numFrames = (int)knobFrames.size();
-
     // Scale sliderPosProportional [0..1] to [0..numFrames-1]
     int frameIndex = (int)std::floor(sliderPosProportional * (float)(numFrames - 1) + 0.5f);
     frameIndex = juce::jlimit(0, numFrames - 1, frameIndex);
 
-    const auto& frame = knobFrames[(size_t)frameIndex];
+    const float scale = g.getInternalContext().getPhysicalPixelScaleFactor();
+    const auto& source = knobSheet != nullptr ? knobSheet->getFrame(frameIndex, scale)
+                                              : knobFrames[(size_t)frameIndex];
+    if (source.isNull())
+      return;
+
+    const auto& frame = getScaledFrame(source, frameIndex, numFrames, width, height, scale);
     g.drawImage(frame,
       (float)x, (float)y,
       (float)width, (float)height,
@@ -41,8 +57,45 @@ public:
       frame.getWidth(), frame.getHeight());
   }
 
+private:
+  // Frames are resampled once to the physical size they are drawn at, so a
+  // knob redraw is a plain blit instead of a rescale of the full-size frame.
+  // Sprite sheet frames already come at the editor's 1x/2x sizes and are used as is.
+  // The cache is per source size: the 1x sheet stands in while the 2x one decodes.
+  const juce::Image& getScaledFrame(const juce::Image& source, int frameIndex, int numFrames,
+    int width, int height, float scale)
+  {
+    const int physicalWidth = juce::roundToInt((float)width * scale);
+    const int physicalHeight = juce::roundToInt((float)height * scale);
+
+    if (source.getWidth() == physicalWidth && source.getHeight() == physicalHeight)
+      return source;
+
+    if (physicalWidth != scaledWidth || physicalHeight != scaledHeight || source.getWidth() != scaledSourceWidth
+        || scaledFrames.size() != (size_t)numFrames)
+    {
+      scaledFrames.clear();
+      scaledFrames.resize((size_t)numFrames);
+      scaledWidth = physicalWidth;
+      scaledHeight = physicalHeight;
+      scaledSourceWidth = source.getWidth();
+    }
+
+    auto& scaled = scaledFrames[(size_t)frameIndex];
+    if (scaled.isNull() && physicalWidth > 0 && physicalHeight > 0)
+      scaled = source.rescaled(physicalWidth, physicalHeight, juce::Graphics::highResamplingQuality);
+
+    return scaled.isNull() ? source : scaled;
+  }
+
+  std::vector<juce::Image> scaledFrames;
+  int scaledWidth = 0;
+  int scaledHeight = 0;
+  int scaledSourceWidth = 0;
+
 private:
   std::vector<juce::Image> knobFrames;
+  KnobSpriteSheet* knobSheet = nullptr;
 };
 
 
@@ -62,11 +115,30 @@ public:
   //==============================================================================
   void paint(juce::Graphics& g) override;
   void resized() override;
+  void visibilityChanged() override;
+  void parentHierarchyChanged() override;
 
 private:
   // Reference to our processor
   ImperialTriodeOverlordAudioProcessor& processor;
 
+  // Tube analyzer overlay, toggled by the scope button. The analyzer thread and the
+  // audio-side capture only run while the overlay is up and the editor is showing.
+  TubeAnalyzer analyzer;
+  AnalyzerView analyzerView;
+  juce::ToggleButton scopeButton{ "Scope" };
+
+  // Cabinet impulse response: shows the loaded one, clicking offers to load or
+  // remove one
+  juce::TextButton cabinetButton;
+  std::unique_ptr<juce::FileChooser> cabinetChooser;
+
+  void showCabinetMenu();
+  void updateCabinetButton();
+
+  // Fixed engine blocks, for a little latency (see the processor's setBlockAccumulation)
+  juce::ToggleButton fixedBlocksButton{ "Fixed blocks" };
+
   // Sliders + attachments
   juce::Slider driveSlider, mixSlider, biasSlider;
   std::unique_ptr<juce::AudioProcessorValueTreeState::SliderAttachment> driveAttachment;
@@ -95,16 +167,27 @@ private:
   void buttonClicked(juce::Button* button) override;
   void timerCallback() override;
 
-  // Knob frames
-  std::vector<juce::Image> knobFrames;
+  // Runs the UI timer (and the analyzer) only while the editor is on screen
+  void updateTimerState();
+
+  // Timer ticks since the polled values last changed (drops to the idle rate)
+  int idleTicks = 0;
+  static constexpr int activeTimerHz = 30;
+  static constexpr int idleTimerHz = 5;
+
+  // Knob frames: the main knobs come from one sprite sheet (declared before the
+  // LookAndFeels that point at it)
+  KnobSpriteSheet knobSheet;
   std::vector<juce::Image> steppedKnobFrames;
 
   // Custom LookAndFeel instances
   KnobLookAndFeel knobLookAndFeel;
   KnobLookAndFeel steppedKnobLookAndFeel;
 
-  // Background image
+  // Background image, plus a copy pre-scaled to the window's physical size
   juce::Image bgImage;
+  juce::Image scaledBgImage;
+  float scaledBgScale = 0.0f;
 
   JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(ImperialTriodeOverlordAudioProcessorEditor)
 };
@@ -1,5 +1,50 @@
 #include "PluginProcessor.h"
+
+#if ! ELDUR_HEADLESS
 #include "PluginEditor.h"
+#endif
+
+namespace
+{
+  struct Preset
+  {
+    const char* name;
+    EngineSwitcher::Config config;
+    float drive, bias, mix;
+    bool midSide, sideEconomy;
+  };
+
+  using Phase = HalfBandOversampler::Phase;
+
+  // Calibrated auto-gain: how long a new gain takes, so drive moves don't click
+  constexpr double makeupRampSeconds = 0.05;
+
+  // The first one matches the parameter defaults
+  const Preset presets[] =
+  {
+    { "Default 2x",          { 1, Phase::minimumPhase, true },  0.6f,  0.0f, 1.0f, false, false },
+    { "Clean Edge 4x",       { 2, Phase::minimumPhase, true },  0.35f, 0.5f, 1.0f, false, false },
+    { "Crushed 8x",          { 3, Phase::minimumPhase, true },  1.0f,  1.0f, 1.0f, false, false },
+    { "Wide Master 4x",      { 2, Phase::linearPhase, true },   0.3f,  0.0f, 0.5f, true,  true  },
+    { "Reference 8x",        { 3, Phase::minimumPhase, false }, 0.6f,  0.0f, 1.0f, false, false },
+    { "Split Bass 4x",       { 2, Phase::minimumPhase, true, nullptr, { 150.0f, 0.3f, 0.5f, 3, 0 } }, 0.8f, 0.5f, 1.0f, false, false }
+  };
+
+  // The most latency any preset with the same filter phase has. Engines are
+  // delayed to it, so switching between minimum-phase presets (5 samples at most)
+  // or between linear-phase ones (57) keeps the latency; only a switch across
+  // the two reports a new one to the host, once the new engine is ready. The
+  // cabinet and the low band add none.
+  int getPresetLatency(const Preset& current, bool blockAccumulation)
+  {
+    int latency = 0;
+    for (const auto& preset : presets)
+      if (preset.config.phase == current.config.phase)
+        latency = juce::jmax(latency, DistortionEngine::computeLatencyInSamples(preset.config.oversamplingFactor,
+                                                                               preset.config.phase, blockAccumulation));
+    return latency;
+  }
+}
 
 ImperialTriodeOverlordAudioProcessor::ImperialTriodeOverlordAudioProcessor()
 #ifndef JucePlugin_PreferredChannelConfigurations
@@ -15,18 +60,37 @@ ImperialTriodeOverlordAudioProcessor::ImperialTriodeOverlordAudioProcessor()
     {
         std::make_unique<juce::AudioParameterFloat>("drive", "Drive",  0.25f, 1.0f, 0.6f),
         std::make_unique<juce::AudioParameterFloat>("mix",   "Mix",    0.0f, 1.0f, 1.0f),
-        std::make_unique<juce::AudioParameterFloat>("bias",  "Bias",   0.0f, 2.0f, 0.0f)
+        std::make_unique<juce::AudioParameterFloat>("bias",  "Bias",   0.0f, 2.0f, 0.0f),
+        std::make_unique<juce::AudioParameterFloat>("drift", "Bias Drift", 0.0f, 1.0f, 0.0f),
+        std::make_unique<juce::AudioParameterBool>("midSide", "Mid/Side", false),
+        std::make_unique<juce::AudioParameterBool>("sideEconomy", "Side Economy", false),
+        std::make_unique<juce::AudioParameterChoice>("autoGain", "Auto Gain", juce::StringArray{ "Calibrated", "Adaptive" }, 0)
     })
 #endif
 {
+  // The audio thread reads the parameters through these, without the string lookup
+  driveParameter = parameters.getRawParameterValue("drive");
+  biasParameter = parameters.getRawParameterValue("bias");
+  driftParameter = parameters.getRawParameterValue("drift");
+  mixParameter = parameters.getRawParameterValue("mix");
+  midSideParameter = parameters.getRawParameterValue("midSide");
+  sideEconomyParameter = parameters.getRawParameterValue("sideEconomy");
+  autoGainParameter = parameters.getRawParameterValue("autoGain");
+
   // Initialize smoothing, oversampling, etc. if needed
   autoGainDb.setCurrentAndTargetValue(-12.0f);
+  engineSwitcher.setAnalysisTap(&analysisTap);
+  engineSwitcher.requestConfig(makeConfig());
+  engineSwitcher.onEngineReady = [this] { triggerAsyncUpdate(); };
 #if DEBUG 
   formatManager.registerBasicFormats();
 #endif
 }
 
-ImperialTriodeOverlordAudioProcessor::~ImperialTriodeOverlordAudioProcessor() {}
+ImperialTriodeOverlordAudioProcessor::~ImperialTriodeOverlordAudioProcessor()
+{
+  cancelPendingUpdate();
+}
 
 void ImperialTriodeOverlordAudioProcessor::prepareToPlay(double sampleRate, int samplesPerBlock)
 {
@@ -43,10 +107,31 @@ void ImperialTriodeOverlordAudioProcessor::prepareToPlay(double sampleRate, int
   spec.numChannels = (juce::uint32)getTotalNumOutputChannels();
 
   // Prepare our engine & tone stack
-  distortionEngine.prepare(spec, 1); // 2x oversampling or whatever
-  distortionEngine.reset();
+  // The configuration (oversampling factor etc.) comes from the current preset
+  // The engine is built on the shared pool; the audio passes through until then.
+  // Offline, it is built right here instead.
+  engineSwitcher.setSynchronousBuilds(isNonRealtime());
+  engineSwitcher.prepare(spec);
+  engineSwitcher.reset();
+
+  // The current preset's aligned latency (see getPresetLatency), passing through included
+  setLatencySamples(engineSwitcher.getLatencyInSamples());
+
+  analysisTapRatio = 1 << engineSwitcher.getActiveConfig().oversamplingFactor;
+  analysisTap.prepare(sampleRate, analysisTapRatio);
 
   autoGainDb.reset(sampleRate, 0.001); // 1ms ramp, adjust as needed
+
+  // Starts at the gain for the current settings
+  makeupGain.reset(sampleRate, makeupRampSeconds);
+  makeupGain.setCurrentAndTargetValue(juce::Decibels::decibelsToGain(
+    MakeupGain::getGainDb(driveParameter->load(), biasParameter->load(), mixParameter->load())));
+}
+
+void ImperialTriodeOverlordAudioProcessor::setNonRealtime(bool isNonRealtime) noexcept
+{
+  juce::AudioProcessor::setNonRealtime(isNonRealtime);
+  engineSwitcher.setSynchronousBuilds(isNonRealtime);
 }
 
 void ImperialTriodeOverlordAudioProcessor::releaseResources()
@@ -70,37 +155,143 @@ void ImperialTriodeOverlordAudioProcessor::processBlock(juce::AudioBuffer<float>
 {
   juce::ScopedNoDenormals noDenormals;
 
-#if DEBUG
-  // Fill the buffer from the transport source
-  transportSource.getNextAudioBlock(juce::AudioSourceChannelInfo(buffer));
+#if DEBUG && ! ELDUR_HEADLESS
+  // Fill the buffer from the transport source. Debug playback only: the transport
+  // locks and reads the file, so it stays out of the real-time checks below.
+  if (transportSource.isPlaying())
+    transportSource.getNextAudioBlock(juce::AudioSourceChannelInfo(buffer));
 #endif
 
+  // From here on nothing may allocate, lock or block (checked in RtSanitizer builds)
+  const RealtimeSanitizer::ScopedRealtime realtime;
+
   // 1) Check bypass
   if (bypass)
     return;
 
-  // 2) Pre RMS
-  PreCalcAutoGainRms(buffer);
+  // 2) Pre RMS (adaptive auto-gain only)
+  const bool adaptive = autoGainParameter->load() > 0.5f;
+
+  if (adaptive != adaptiveAutoGain)
+    switchAutoGainMode(adaptive);
+
+  if (adaptiveAutoGain)
+    PreCalcAutoGainRms(buffer);
 
   // 3) Update DistortionEngine parameters
-  float drive = *parameters.getRawParameterValue("drive");
-  float bias = *parameters.getRawParameterValue("bias");
-  float mix = *parameters.getRawParameterValue("mix");
+  float drive = driveParameter->load();
+  float bias = biasParameter->load();
+  float drift = driftParameter->load();
+  float mix = mixParameter->load();
+  bool midSide = midSideParameter->load() > 0.5f;
+  bool sideEconomy = sideEconomyParameter->load() > 0.5f;
+
+  // The calibrated gain goes on the engine's output only: the dry signal passed
+  // through while the engine is built stays as it is
+  float makeupStart = 1.0f, makeupEnd = 1.0f;
 
-  distortionEngine.setDrive(drive);
-  distortionEngine.setBias(bias);
-  distortionEngine.setMix(mix);
+  if (!adaptiveAutoGain)
+    getMakeupGainRamp(drive, bias, mix, buffer.getNumSamples(), makeupStart, makeupEnd);
 
-  // 4) Distortion
-  distortionEngine.processBlock(getSampleRate(), buffer);
+  engineSwitcher.setParameters({ drive, bias, mix, midSide, sideEconomy, drift, makeupStart, makeupEnd });
+
+  // 4) Distortion (crossfades to a newly built engine when a preset switch is ready)
+  engineSwitcher.processBlock((float)getSampleRate(), buffer);
+
+  // The tap only sets a stride, so it can follow a switch from here
+  const int ratio = 1 << engineSwitcher.getActiveConfig().oversamplingFactor;
+  if (ratio != analysisTapRatio)
+  {
+    analysisTapRatio = ratio;
+    analysisTap.prepare(getSampleRate(), ratio);
+  }
 
   // 5) Brickwall limit
   brickwallLimit(buffer);
 
-  // 6) Post RMS + autogain
-  PostCalcAutoGainRms(buffer);
+  // 6) Post RMS + autogain (the calibrated gain came with the engine)
+  if (adaptiveAutoGain)
+    PostCalcAutoGainRms(buffer);
+}
+
+void ImperialTriodeOverlordAudioProcessor::handleAsyncUpdate()
+{
+  setLatencySamples(engineSwitcher.getLatencyInSamples());
+}
+
+//==============================================================================
+int ImperialTriodeOverlordAudioProcessor::getNumPrograms()
+{
+  return (int)std::size(presets);
+}
+
+const juce::String ImperialTriodeOverlordAudioProcessor::getProgramName(int index)
+{
+  return juce::isPositiveAndBelow(index, getNumPrograms()) ? presets[index].name : "";
+}
+
+void ImperialTriodeOverlordAudioProcessor::setCurrentProgram(int index)
+{
+  if (!juce::isPositiveAndBelow(index, getNumPrograms()))
+    return;
+
+  const auto& preset = presets[index];
+  currentProgram = index;
+
+  auto setValue = [this](const char* id, float value)
+  {
+    if (auto* parameter = parameters.getParameter(id))
+      parameter->setValueNotifyingHost(parameter->convertTo0to1(value));
+  };
+
+  setValue("drive", preset.drive);
+  setValue("bias", preset.bias);
+  setValue("mix", preset.mix);
+  setValue("midSide", preset.midSide ? 1.0f : 0.0f);
+  setValue("sideEconomy", preset.sideEconomy ? 1.0f : 0.0f);
+
+  engineSwitcher.requestConfig(makeConfig());
+}
+
+EngineSwitcher::Config ImperialTriodeOverlordAudioProcessor::makeConfig() const
+{
+  const auto& preset = presets[currentProgram];
+  auto config = preset.config;
+  config.cabinet = cabinet;
+  config.blockAccumulation = blockAccumulation;
+  config.alignedLatency = getPresetLatency(preset, blockAccumulation);
+  return config;
+}
+
+void ImperialTriodeOverlordAudioProcessor::setBlockAccumulation(bool shouldAccumulate)
+{
+  blockAccumulation = shouldAccumulate;
+  engineSwitcher.requestConfig(makeConfig());
+}
+
+bool ImperialTriodeOverlordAudioProcessor::loadCabinet(const juce::File& file, juce::String& error)
+{
+  auto impulse = CabinetImpulse::loadFromFile(file, error);
+
+  if (impulse == nullptr)
+    return false;
+
+  cabinet = std::move(impulse);
+  cabinetFile = file;
+  cabinetError.clear();
+  engineSwitcher.requestConfig(makeConfig());
+  return true;
 }
 
+void ImperialTriodeOverlordAudioProcessor::clearCabinet()
+{
+  cabinet = nullptr;
+  cabinetFile = juce::File();
+  cabinetError.clear();
+  engineSwitcher.requestConfig(makeConfig());
+}
+
+//==============================================================================
 void ImperialTriodeOverlordAudioProcessor::brickwallLimit(juce::AudioBuffer<float>& buffer)
 {
   auto numChannels = buffer.getNumChannels();
@@ -153,6 +344,26 @@ void ImperialTriodeOverlordAudioProcessor::PostCalcAutoGainRms(juce::AudioBuffer
   }
 }
 
+void ImperialTriodeOverlordAudioProcessor::getMakeupGainRamp(float drive, float bias, float mix, int numSamples,
+  float& startGain, float& endGain)
+{
+  makeupGain.setTargetValue(juce::Decibels::decibelsToGain(MakeupGain::getGainDb(drive, bias, mix)));
+
+  // A linear ramp over the block, the same as stepping the smoother per sample
+  startGain = makeupGain.getCurrentValue();
+  endGain = makeupGain.isSmoothing() ? makeupGain.skip(numSamples) : startGain;
+}
+
+void ImperialTriodeOverlordAudioProcessor::switchAutoGainMode(bool adaptive)
+{
+  if (adaptive)
+    autoGainDb.setCurrentAndTargetValue(juce::Decibels::gainToDecibels(makeupGain.getCurrentValue()));
+  else
+    makeupGain.setCurrentAndTargetValue(juce::Decibels::decibelsToGain(autoGainDb.getCurrentValue()));
+
+  adaptiveAutoGain = adaptive;
+}
+
 void ImperialTriodeOverlordAudioProcessor::PreCalcAutoGainRms(juce::AudioBuffer<float>& buffer)
 {
   float sumOfSquaresInput = 0.0f;
@@ -173,13 +384,21 @@ void ImperialTriodeOverlordAudioProcessor::PreCalcAutoGainRms(juce::AudioBuffer<
 //==============================================================================
 juce::AudioProcessorEditor* ImperialTriodeOverlordAudioProcessor::createEditor()
 {
+#if ELDUR_HEADLESS
+  return nullptr;
+#else
   return new ImperialTriodeOverlordAudioProcessorEditor(*this);
+#endif
 }
 
 //==============================================================================
 void ImperialTriodeOverlordAudioProcessor::getStateInformation(juce::MemoryBlock& destData)
 {
   auto state = parameters.copyState();
+  state.setProperty("program", currentProgram, nullptr);
+  state.setProperty("cabinet", cabinetFile.getFullPathName(), nullptr);
+  state.setProperty("blockAccumulation", blockAccumulation, nullptr);
+
   std::unique_ptr<juce::XmlElement> xml(state.createXml());
   copyXmlToBinary(*xml, destData);
 }
@@ -190,7 +409,24 @@ void ImperialTriodeOverlordAudioProcessor::setStateInformation(const void* data,
 
   if (xmlState.get() != nullptr)
     if (xmlState->hasTagName(parameters.state.getType()))
+    {
       parameters.replaceState(juce::ValueTree::fromXml(*xmlState));
+
+      // The saved parameters win over the preset's, only its configuration is used
+      const int program = parameters.state.getProperty("program", 0);
+      currentProgram = juce::isPositiveAndBelow(program, getNumPrograms()) ? program : 0;
+      blockAccumulation = parameters.state.getProperty("blockAccumulation", false);
+
+      // A cabinet file that has gone missing since leaves the cabinet out, but
+      // keeps its path (see isCabinetMissing)
+      const juce::String cabinetPath = parameters.state.getProperty("cabinet", juce::String());
+
+      cabinetError.clear();
+      cabinetFile = cabinetPath.isNotEmpty() ? juce::File(cabinetPath) : juce::File();
+      cabinet = cabinetPath.isNotEmpty() ? CabinetImpulse::loadFromFile(cabinetFile, cabinetError) : nullptr;
+
+      engineSwitcher.requestConfig(makeConfig());
+    }
 }
 
 juce::AudioProcessor* JUCE_CALLTYPE createPluginFilter()
@@ -1,19 +1,30 @@
 #pragma once
 
 #include <JuceHeader.h>
-#include "DistortionEngine.h"
+#include "EngineSwitcher.h"
+#include "MakeupGain.h"
+#include "AnalysisTap.h"
+#include "RealtimeSanitizer.h"
+
+// Set by builds without the editor (the tools), which then don't need BinaryData
+#ifndef ELDUR_HEADLESS
+ #define ELDUR_HEADLESS 0
+#endif
 
 /**
     The main audio processor class for the Eldur plugin.
 
     Responsibilities:
     - Manages parameters (drive, bias, mix, bypass, etc.)
-    - Coordinates the DistortionEngine (which handles oversampling and triode distortion).
+    - Coordinates the DistortionEngine (which handles oversampling and triode distortion),
+      through an EngineSwitcher so presets can change its configuration while playing.
     - Coordinates the ToneStack (which handles EQ/filtering).
-    - Performs auto-gain calculations and brickwall limiting.
+    - Performs brickwall limiting and auto-gain: a calibrated makeup gain for the
+      settings (see MakeupGain), or the adaptive one that matches RMS per block.
     - Handles state serialization/deserialization.
 */
-class ImperialTriodeOverlordAudioProcessor : public juce::AudioProcessor
+class ImperialTriodeOverlordAudioProcessor : public juce::AudioProcessor,
+  private juce::AsyncUpdater
 {
 public:
   //==============================================================================
@@ -30,9 +41,13 @@ public:
 
   void processBlock(juce::AudioBuffer<float>& buffer, juce::MidiBuffer& midiMessages) override;
 
+  /** Offline renders build engines (prepareToPlay, preset switches) on the calling
+      thread, so the render never depends on when a background build finishes. */
+  void setNonRealtime(bool isNonRealtime) noexcept override;
+
   //==============================================================================
   juce::AudioProcessorEditor* createEditor() override;
-  bool hasEditor() const override { return true; }
+  bool hasEditor() const override { return ! ELDUR_HEADLESS; }
 
   //==============================================================================
   const juce::String getName() const override { return JucePlugin_Name; }
@@ -42,10 +57,13 @@ public:
   double getTailLengthSeconds() const override { return 0.0; }
 
   //==============================================================================
-  int getNumPrograms() override { return 1; }
-  int getCurrentProgram() override { return 0; }
-  void setCurrentProgram(int) override {}
-  const juce::String getProgramName(int) override { return {}; }
+  // Programs are the built-in presets. Switching sets the parameters and builds
+  // an engine for the preset's configuration in the background (right away when
+  // rendering offline).
+  int getNumPrograms() override;
+  int getCurrentProgram() override { return currentProgram; }
+  void setCurrentProgram(int index) override;
+  const juce::String getProgramName(int index) override;
   void changeProgramName(int, const juce::String&) override {}
 
   //==============================================================================
@@ -60,9 +78,39 @@ public:
   void setBypass(bool shouldBypass) { bypass = shouldBypass; }
   bool getBypass() const { return bypass; }
 
-  /** For debug or meter usage. */
+  /** For debug or meter usage (measured by the adaptive auto-gain only). */
   float getRmsLevel() const noexcept { return lastOutputRms; }
 
+  /** Capture tap read by the editor's analyzer. */
+  AnalysisTap& getAnalysisTap() noexcept { return analysisTap; }
+
+  /** Seconds from the last prepareToPlay to the first block through the engine,
+      or -1 while the audio still passes through. */
+  double getTimeToFirstAudio() const noexcept { return engineSwitcher.getTimeToFirstAudio(); }
+
+  /** Cabinet impulse response, convolved after the tubes. Read and checked here,
+      on the calling thread; the engine is rebuilt with it in the background.
+      Returns false (and keeps the current one) if the file can't be used. */
+  bool loadCabinet(const juce::File& file, juce::String& error);
+  void clearCabinet();
+
+  /** The loaded impulse's name, empty without one. */
+  juce::String getCabinetName() const { return cabinet != nullptr ? cabinet->name : juce::String(); }
+
+  /** A restored state named a cabinet file that can't be loaded (moved, deleted,
+      or on a drive that isn't there). Its path is kept and saved again, so the
+      cabinet comes back once the file does; the engine runs without one meanwhile. */
+  bool isCabinetMissing() const { return cabinet == nullptr && cabinetFile != juce::File(); }
+  const juce::File& getCabinetFile() const noexcept { return cabinetFile; }
+  const juce::String& getCabinetError() const noexcept { return cabinetError; }
+
+  /** Fixed blocks: small host blocks are gathered into whole engine sub-blocks, so
+      every sub-block costs the same, for DistortionEngine::subBlockSize samples of
+      latency. A setting of its own (saved with the state), the same for live
+      playback and offline renders. The engine is rebuilt in the background. */
+  void setBlockAccumulation(bool shouldAccumulate);
+  bool getBlockAccumulation() const noexcept { return blockAccumulation; }
+
 #if DEBUG
   // Debug methods for file playback
   void loadFile(const juce::File& audioFile);
@@ -72,6 +120,12 @@ public:
 
 private:
   //==============================================================================
+  /** Reports the latency of a newly built engine to the host. */
+  void handleAsyncUpdate() override;
+
+  /** The current preset's configuration, with the cabinet. */
+  EngineSwitcher::Config makeConfig() const;
+
   /** Helper to apply a hard limiter at 1.0f. */
   void brickwallLimit(juce::AudioBuffer<float>& buffer);
 
@@ -81,18 +135,54 @@ private:
   /** Measure RMS post-distortion, apply auto-gain correction. */
   void PostCalcAutoGainRms(juce::AudioBuffer<float>& buffer);
 
+  /** Calibrated auto-gain: the makeup gain for the settings (see MakeupGain), no
+      measuring. Ramps to a new gain over makeupRampSeconds; gives the ramp over
+      the next numSamples, for the engine's output only. */
+  void getMakeupGainRamp(float drive, float bias, float mix, int numSamples, float& startGain, float& endGain);
+
+  /** Moves the gain over from the other auto-gain mode, so switching doesn't jump. */
+  void switchAutoGainMode(bool adaptive);
+
   //==============================================================================
   bool bypass = false;
 
   /** Holds drive, bias, mix parameters, etc. */
   juce::AudioProcessorValueTreeState parameters;
 
-  /** Our higher-level distortion engine (oversampling, triode distortion, M/S, etc.). */
-  DistortionEngine distortionEngine;
+  /** The parameters' values, looked up once for the audio thread. */
+  std::atomic<float>* driveParameter = nullptr;
+  std::atomic<float>* biasParameter = nullptr;
+  std::atomic<float>* driftParameter = nullptr;
+  std::atomic<float>* mixParameter = nullptr;
+  std::atomic<float>* midSideParameter = nullptr;
+  std::atomic<float>* sideEconomyParameter = nullptr;
+  std::atomic<float>* autoGainParameter = nullptr;
+
+  /** Our higher-level distortion engine (oversampling, triode distortion, M/S, etc.),
+      built in the background on prepareToPlay and when a preset needs a different
+      configuration. */
+  EngineSwitcher engineSwitcher;
+  int currentProgram = 0;
+
+  /** The cabinet and where it came from (saved with the state). */
+  std::shared_ptr<const CabinetImpulse> cabinet;
+  juce::File cabinetFile;
+  juce::String cabinetError;   // why cabinetFile couldn't be loaded, if it's missing
+
+  /** See setBlockAccumulation. */
+  bool blockAccumulation = false;
+
+  /** Feeds the analyzer; idle unless the editor enables it. */
+  AnalysisTap analysisTap;
+  int analysisTapRatio = 0;
 
   /** Auto-gain smoothing in decibels. */
   juce::SmoothedValue<float, juce::ValueSmoothingTypes::Linear> autoGainDb;
 
+  /** Calibrated auto-gain, linear. */
+  juce::SmoothedValue<float, juce::ValueSmoothingTypes::Linear> makeupGain;
+  bool adaptiveAutoGain = false;
+
   /** Keep track of input + output RMS for auto-gain calculations. */
   float lastInputRms = 0.0f;
   float lastOutputRms = 0.0f;
@@ -0,0 +1,244 @@
+// realtimeSanitizer.cpp
+
+#include "RealtimeSanitizer.h"
+
+#if ELDUR_RT_SANITIZER
+ #if ! JUCE_LINUX
+  #error "ELDUR_RT_SANITIZER replaces glibc's allocator, it only works on Linux"
+ #endif
+
+ #include <cerrno>
+ #include <cstdarg>
+ #include <dlfcn.h>
+ #include <fcntl.h>
+ #include <pthread.h>
+ #include <time.h>
+ #include <unistd.h>
+#endif
+
+namespace
+{
+  // Per thread: how many ScopedRealtime are open, and whether a violation is
+  // being recorded (which allocates and locks itself)
+  thread_local int realtimeDepth = 0;
+  thread_local bool recording = false;
+
+  std::atomic<juce::int64> numViolations{ 0 };
+
+  // The hooks can't take a mutex
+  juce::SpinLock reportLock;
+  std::vector<RealtimeSanitizer::Report> reports;
+}
+
+//==============================================================================
+#if ELDUR_RT_SANITIZER
+RealtimeSanitizer::ScopedRealtime::ScopedRealtime() noexcept
+{
+  ++realtimeDepth;
+}
+
+RealtimeSanitizer::ScopedRealtime::~ScopedRealtime() noexcept
+{
+  --realtimeDepth;
+}
+#endif
+
+void RealtimeSanitizer::check(const char* function) noexcept
+{
+  if (realtimeDepth == 0 || recording)
+    return;
+
+  recording = true;
+  ++numViolations;
+
+  {
+    // Scoped so the trace is freed before recording ends
+    const auto stackTrace = juce::SystemStats::getStackBacktrace();
+    const juce::SpinLock::ScopedLockType lock(reportLock);
+
+    auto found = std::find_if(reports.begin(), reports.end(), [&](const Report& report)
+    {
+      return report.function == function && report.stackTrace == stackTrace;
+    });
+
+    if (found != reports.end())
+      ++found->count;
+    else if ((int)reports.size() < maxReports)
+      reports.push_back({ function, stackTrace, 1 });
+  }
+
+  recording = false;
+}
+
+juce::int64 RealtimeSanitizer::getNumViolations() noexcept
+{
+  return numViolations.load();
+}
+
+std::vector<RealtimeSanitizer::Report> RealtimeSanitizer::getReports()
+{
+  const juce::SpinLock::ScopedLockType lock(reportLock);
+  return reports;
+}
+
+void RealtimeSanitizer::clear()
+{
+  const juce::SpinLock::ScopedLockType lock(reportLock);
+  reports.clear();
+  numViolations = 0;
+}
+
+juce::String RealtimeSanitizer::toText(const std::vector<Report>& reportList)
+{
+  juce::String text;
+
+  for (const auto& report : reportList)
+    text << report.function << " on the audio thread (" << report.count << "x)\n" << report.stackTrace << "\n";
+
+  return text;
+}
+
+//==============================================================================
+#if ELDUR_RT_SANITIZER
+namespace
+{
+  // The next definition of an interposed function, i.e. libc's
+  template <typename Function>
+  Function* getNext(const char* name) noexcept
+  {
+    return reinterpret_cast<Function*>(dlsym(RTLD_NEXT, name));
+  }
+}
+
+extern "C"
+{
+  // glibc's allocator under its internal names. Defining malloc and friends here
+  // replaces them for the whole process, operator new included.
+  void* __libc_malloc(size_t);
+  void* __libc_calloc(size_t, size_t);
+  void* __libc_realloc(void*, size_t);
+  void* __libc_memalign(size_t, size_t);
+  void __libc_free(void*);
+
+  void* malloc(size_t size) noexcept
+  {
+    RealtimeSanitizer::check("malloc");
+    return __libc_malloc(size);
+  }
+
+  void* calloc(size_t numElements, size_t size) noexcept
+  {
+    RealtimeSanitizer::check("calloc");
+    return __libc_calloc(numElements, size);
+  }
+
+  void* realloc(void* pointer, size_t size) noexcept
+  {
+    RealtimeSanitizer::check("realloc");
+    return __libc_realloc(pointer, size);
+  }
+
+  void* aligned_alloc(size_t alignment, size_t size) noexcept
+  {
+    RealtimeSanitizer::check("aligned_alloc");
+    return __libc_memalign(alignment, size);
+  }
+
+  int posix_memalign(void** result, size_t alignment, size_t size) noexcept
+  {
+    RealtimeSanitizer::check("posix_memalign");
+
+    if (alignment % sizeof(void*) != 0 || !juce::isPowerOfTwo(alignment))
+      return EINVAL;
+
+    *result = __libc_memalign(alignment, size);
+    return *result != nullptr ? 0 : ENOMEM;
+  }
+
+  void free(void* pointer) noexcept
+  {
+    if (pointer != nullptr)
+      RealtimeSanitizer::check("free");
+
+    __libc_free(pointer);
+  }
+
+  //==============================================================================
+  // Locks and waits. trylock never blocks, so it is allowed.
+  int pthread_mutex_lock(pthread_mutex_t* mutex) noexcept
+  {
+    RealtimeSanitizer::check("pthread_mutex_lock");
+    static auto* next = getNext<int(pthread_mutex_t*)>("pthread_mutex_lock");
+    return next(mutex);
+  }
+
+  int pthread_cond_wait(pthread_cond_t* condition, pthread_mutex_t* mutex)
+  {
+    RealtimeSanitizer::check("pthread_cond_wait");
+    static auto* next = getNext<int(pthread_cond_t*, pthread_mutex_t*)>("pthread_cond_wait");
+    return next(condition, mutex);
+  }
+
+  int pthread_cond_timedwait(pthread_cond_t* condition, pthread_mutex_t* mutex, const struct timespec* time)
+  {
+    RealtimeSanitizer::check("pthread_cond_timedwait");
+    static auto* next = getNext<int(pthread_cond_t*, pthread_mutex_t*, const struct timespec*)>("pthread_cond_timedwait");
+    return next(condition, mutex, time);
+  }
+
+  int pthread_join(pthread_t thread, void** result)
+  {
+    RealtimeSanitizer::check("pthread_join");
+    static auto* next = getNext<int(pthread_t, void**)>("pthread_join");
+    return next(thread, result);
+  }
+
+  //==============================================================================
+  // Sleeping and file I/O
+  int nanosleep(const struct timespec* duration, struct timespec* remaining)
+  {
+    RealtimeSanitizer::check("nanosleep");
+    static auto* next = getNext<int(const struct timespec*, struct timespec*)>("nanosleep");
+    return next(duration, remaining);
+  }
+
+  int usleep(useconds_t microseconds)
+  {
+    RealtimeSanitizer::check("usleep");
+    static auto* next = getNext<int(useconds_t)>("usleep");
+    return next(microseconds);
+  }
+
+  int open(const char* path, int flags, ...)
+  {
+    RealtimeSanitizer::check("open");
+
+    mode_t mode = 0;
+
+    if ((flags & O_CREAT) != 0 || (flags & O_TMPFILE) == O_TMPFILE)
+    {
+      va_list args;
+      va_start(args, flags);
+      mode = (mode_t)va_arg(args, int);
+      va_end(args);
+    }
+
+    static auto* next = getNext<int(const char*, int, ...)>("open");
+    return next(path, flags, mode);
+  }
+
+  ssize_t read(int file, void* data, size_t size)
+  {
+    RealtimeSanitizer::check("read");
+    static auto* next = getNext<ssize_t(int, void*, size_t)>("read");
+    return next(file, data, size);
+  }
+
+  ssize_t write(int file, const void* data, size_t size)
+  {
+    RealtimeSanitizer::check("write");
+    static auto* next = getNext<ssize_t(int, const void*, size_t)>("write");
+    return next(file, data, size);
+  }
+}
+#endif
@@ -0,0 +1,64 @@
+// realtimeSanitizer.h
+
+#pragma once
+
+#include <JuceHeader.h>
+
+// Set by the tools' RtSanitizer configuration (Linux), off everywhere else
+#ifndef ELDUR_RT_SANITIZER
+ #define ELDUR_RT_SANITIZER 0
+#endif
+
+/**
+    Catches real-time-safety violations on the audio thread.
+
+    In ELDUR_RT_SANITIZER builds, code between the construction and destruction of
+    a ScopedRealtime (processBlock) must not allocate or free heap memory, lock a
+    mutex, wait on a condition, sleep or make blocking file calls. The hooks in
+    RealtimeSanitizer.cpp replace malloc/calloc/realloc/free and interpose the
+    pthread and libc calls; each one that happens on a thread inside a scope is
+    counted and recorded with its stack trace. Other threads are not affected.
+
+    The hooks replace process-wide symbols, so this mode is for executables (the
+    tools), never for a plugin binary. In other builds ScopedRealtime is empty and
+    nothing is hooked.
+*/
+class RealtimeSanitizer
+{
+public:
+  static constexpr bool isEnabled() noexcept { return ELDUR_RT_SANITIZER != 0; }
+
+  /** Marks the current thread as real-time while it exists (nests). */
+  class ScopedRealtime
+  {
+  public:
+#if ELDUR_RT_SANITIZER
+    ScopedRealtime() noexcept;
+    ~ScopedRealtime() noexcept;
+#else
+    ScopedRealtime() noexcept {}
+#endif
+
+    JUCE_DECLARE_NON_COPYABLE(ScopedRealtime)
+  };
+
+  /** One distinct violation: what was called, from where, and how often. */
+  struct Report
+  {
+    juce::String function;
+    juce::String stackTrace;
+    juce::int64 count = 0;
+  };
+
+  // Distinct call stacks kept; later ones are only counted
+  static constexpr int maxReports = 64;
+
+  static juce::int64 getNumViolations() noexcept;
+  static std::vector<Report> getReports();
+  static void clear();
+
+  static juce::String toText(const std::vector<Report>& reports);
+
+  // Called by the hooks: records a violation if the calling thread is real-time
+  static void check(const char* function) noexcept;
+};
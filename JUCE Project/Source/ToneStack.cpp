@@ -4,9 +4,25 @@
 
 void ToneStack::prepare(const juce::dsp::ProcessSpec& spec)
 {
-  midPeakFilter.reset();
-  lowShelfFilter.reset();
-  highShelfFilter.reset();
+  numChannels = juce::jmax(1, (int)spec.numChannels);
+}
+
+void ToneStack::allocate(DspArena& arena)
+{
+  lowShelfFilter.allocate(arena, numChannels, "tone stack low shelf");
+  highShelfFilter.allocate(arena, numChannels, "tone stack high shelf");
+  midPeakFilter.allocate(arena, numChannels, "tone stack mid peak");
+
+  if (arena.isMeasuring())
+    return;
+
+  // Fresh filters pass through until the drive moves off zero
+  const std::array<float, 6> passThrough{ 1.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f };
+  lowShelfFilter.setCoefficients(passThrough);
+  highShelfFilter.setCoefficients(passThrough);
+  midPeakFilter.setCoefficients(passThrough);
+  lastSmoothedDrive = 0;
+  lastSampleRate = 0;
 }
 
 void ToneStack::reset()
@@ -16,21 +32,35 @@ void ToneStack::reset()
   highShelfFilter.reset();
 }
 
+void ToneStack::copyChannelState(int from, int to) noexcept
+{
+  midPeakFilter.copyChannelState(from, to);
+  lowShelfFilter.copyChannelState(from, to);
+  highShelfFilter.copyChannelState(from, to);
+}
+
 void ToneStack::updateCoefficients(float sampleRate)
 {
-  if (std::abs(driveParam - lastSmoothedDrive) > 0.0001f) {
-    float shelfGainDb = 1.0f * driveParam;
-    float shelfGainLin = juce::Decibels::decibelsToGain(shelfGainDb);
+  // The tone stack can move between rates (see DistortionEngine::RatePlan), so
+  // the coefficients follow the rate as well as the drive (pass-through filters
+  // at drive 0 are right at any rate)
+  const bool rateChanged = sampleRate != lastSampleRate && lastSmoothedDrive != 0.0f;
 
-    auto lowCoeffs = juce::dsp::IIR::Coefficients<float>::makeLowShelf(sampleRate, 90.0, 0.707f, shelfGainLin);
-    auto highCoeffs = juce::dsp::IIR::Coefficients<float>::makeHighShelf(sampleRate, 14000.0, 0.707f, shelfGainLin);
-    auto midPeakCoeffs = juce::dsp::IIR::Coefficients<float>::makePeakFilter(sampleRate, 600.0f, 0.7f, 1.412f * driveParam);
+  if (std::abs(driveParam - lastSmoothedDrive) > 0.0001f || rateChanged) {
+    float shelfGainLin = getShelfGain(driveParam);
 
-    midPeakFilter.coefficients = midPeakCoeffs;
-    lowShelfFilter.coefficients = lowCoeffs;
-    highShelfFilter.coefficients = highCoeffs;
+    using Coefficients = juce::dsp::IIR::ArrayCoefficients<float>;
+
+    // Corners above the rate's Nyquist (the high shelf at the host rate) are
+    // pulled down to where the filter is still valid
+    const float maxFrequency = 0.45f * sampleRate;
+
+    lowShelfFilter.setCoefficients(Coefficients::makeLowShelf(sampleRate, lowShelfFrequency, 0.707f, shelfGainLin));
+    highShelfFilter.setCoefficients(Coefficients::makeHighShelf(sampleRate, juce::jmin(highShelfFrequency, maxFrequency), 0.707f, shelfGainLin));
+    midPeakFilter.setCoefficients(Coefficients::makePeakFilter(sampleRate, midPeakFrequency, 0.7f, 1.412f * driveParam));
 
     lastSmoothedDrive = driveParam;
+    lastSampleRate = sampleRate;
   }
 }
 
@@ -39,22 +69,19 @@ void ToneStack::processAudioBlock(float sampleRate, juce::dsp::AudioBlock<float>
   // Update coefficients if drive has changed
   updateCoefficients(sampleRate);
 
-  // Create a DSP context that wraps our incoming block
-  juce::dsp::ProcessContextReplacing<float> context(oversampledBlock);
-
-  // Then apply the shelf and peak filters sample by sample
-  const auto numChannels = oversampledBlock.getNumChannels();
+  // Then apply the shelf and peak filters sample by sample, each channel with its own state
+  const auto numBlockChannels = juce::jmin(oversampledBlock.getNumChannels(), (size_t)numChannels);
   const auto numSamples = oversampledBlock.getNumSamples();
 
-  for (size_t ch = 0; ch < numChannels; ++ch)
+  for (size_t ch = 0; ch < numBlockChannels; ++ch)
   {
     float* channelData = oversampledBlock.getChannelPointer(ch);
     for (size_t i = 0; i < numSamples; ++i)
     {
       float x = channelData[i];
-      x = lowShelfFilter.processSample(x);
-      x = highShelfFilter.processSample(x);
-      x = midPeakFilter.processSample(x);
+      x = lowShelfFilter.processSample(x, (int)ch);
+      x = highShelfFilter.processSample(x, (int)ch);
+      x = midPeakFilter.processSample(x, (int)ch);
       channelData[i] = x;
     }
   }
@@ -2,6 +2,7 @@
 
 #pragma once
 #include <JuceHeader.h>
+#include "ArenaBiquad.h"
 
 class ToneStack
 {
@@ -9,23 +10,51 @@ public:
   ToneStack() = default;
   ~ToneStack() = default;
 
+  // Corner frequencies. These are the frequencies the stack has always been heard
+  // at: it used to be designed at the host rate but run at the 2x oversampled one.
+  static constexpr float lowShelfFrequency = 180.0f;
+  static constexpr float midPeakFrequency = 1200.0f;
+  static constexpr float highShelfFrequency = 28000.0f;
+
+  // Lowest rate the stack is exact at (the high shelf has to fit below Nyquist)
+  static constexpr float minimumSampleRate = highShelfFrequency / 0.45f;
+
   void prepare(const juce::dsp::ProcessSpec& spec);
   void reset();
 
+  // Takes the filter coefficients and per-channel state from the owner's arena
+  void allocate(DspArena& arena);
+
   void setDrive(float drive) { driveParam = drive; };
 
+  // Gain of both shelves for a drive setting; the low shelf's is also the stack's
+  // gain at DC
+  static float getShelfGain(float drive) { return juce::Decibels::decibelsToGain(1.0f * drive); }
+
   // Adjust gains/coefficients dynamically (e.g. driven by a drive or EQ parameter)
   void updateCoefficients(float sampleRate);
 
+  // Drive and rate the current coefficients were computed for (the coefficients
+  // themselves live in the arena), for state snapshots
+  float getCoefficientsDrive() const noexcept { return lastSmoothedDrive; }
+  void setCoefficientsDrive(float drive) noexcept { lastSmoothedDrive = drive; }
+  float getCoefficientsRate() const noexcept { return lastSampleRate; }
+  void setCoefficientsRate(float sampleRate) noexcept { lastSampleRate = sampleRate; }
+
+  // Makes one channel's filters carry on exactly like another's
+  void copyChannelState(int from, int to) noexcept;
+
   // Process an entire buffer (in-place)
   void processAudioBlock(float sampleRate, juce::dsp::AudioBlock<float>& oversampledBlock);
 
 private:
   float lastSmoothedDrive = 0;
+  float lastSampleRate = 0;
   float driveParam = 0;
+  int numChannels = 1;
 
-  juce::dsp::IIR::Filter<float> midPeakFilter;
-  juce::dsp::IIR::Filter<float> lowShelfFilter;
-  juce::dsp::IIR::Filter<float> highShelfFilter;
+  ArenaBiquad midPeakFilter;
+  ArenaBiquad lowShelfFilter;
+  ArenaBiquad highShelfFilter;
 };
 
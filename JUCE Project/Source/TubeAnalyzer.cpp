@@ -0,0 +1,203 @@
+// tubeAnalyzer.cpp
+
+#include "TubeAnalyzer.h"
+
+TubeAnalyzer::TubeAnalyzer(AnalysisTap& tapToRead)
+  : juce::Thread("Eldur Analyzer"),
+  tap(tapToRead),
+  stageBuffer(1024),
+  signalBuffer(4096),
+  history((size_t)fftSize, 0.0f),
+  scatterHistory((size_t)numScatterPoints),
+  window((size_t)fftSize),
+  fftData((size_t)(2 * fftSize), 0.0f),
+  published(std::make_unique<Snapshot>())
+{
+  juce::dsp::WindowingFunction<float>::fillWindowingTables(window.data(), (size_t)fftSize,
+    juce::dsp::WindowingFunction<float>::blackmanHarris, false);
+}
+
+TubeAnalyzer::~TubeAnalyzer()
+{
+  setActive(false);
+}
+
+void TubeAnalyzer::setActive(bool shouldBeActive)
+{
+  if (shouldBeActive == isThreadRunning())
+    return;
+
+  if (shouldBeActive)
+  {
+    std::fill(history.begin(), history.end(), 0.0f);
+    historyPosition = 0;
+    samplesSinceFft = 0;
+    scatterPosition = 0;
+    scatterCount = 0;
+
+    tap.setEnabled(true);
+    startThread();
+  }
+  else
+  {
+    tap.setEnabled(false);
+    stopThread(500);
+  }
+}
+
+bool TubeAnalyzer::getLatestSnapshot(Snapshot& dest)
+{
+  const juce::SpinLock::ScopedLockType lock(snapshotLock);
+
+  if (published->serial == dest.serial)
+    return false;
+
+  dest = *published;
+  return true;
+}
+
+//==============================================================================
+void TubeAnalyzer::run()
+{
+  while (!threadShouldExit())
+  {
+    const int scatterBefore = scatterCount;
+    const int scatterPositionBefore = scatterPosition;
+
+    drainTap();
+
+    bool changed = false;
+
+    // New spectrum every quarter FFT of new audio
+    if (samplesSinceFft >= fftSize / 4)
+    {
+      updateSpectrum();
+      samplesSinceFft = 0;
+      changed = true;
+    }
+
+    if (scatterCount != scatterBefore || scatterPosition != scatterPositionBefore)
+    {
+      updateScatter();
+      changed = true;
+    }
+
+    if (changed)
+    {
+      working.sampleRate = tap.getSampleRate();
+      ++working.serial;
+
+      const juce::SpinLock::ScopedLockType lock(snapshotLock);
+      *published = working;
+    }
+
+    wait(20);
+  }
+}
+
+void TubeAnalyzer::drainTap()
+{
+  for (;;)
+  {
+    const int numFrames = tap.popStageFrames(stageBuffer.data(), (int)stageBuffer.size());
+    if (numFrames == 0)
+      break;
+
+    for (int i = 0; i < numFrames; ++i)
+    {
+      scatterHistory[(size_t)scatterPosition] = stageBuffer[(size_t)i];
+      scatterPosition = (scatterPosition + 1) % numScatterPoints;
+    }
+
+    scatterCount = juce::jmin(numScatterPoints, scatterCount + numFrames);
+  }
+
+  for (;;)
+  {
+    const int numFrames = tap.popSignalFrames(signalBuffer.data(), (int)signalBuffer.size());
+    if (numFrames == 0)
+      break;
+
+    for (int i = 0; i < numFrames; ++i)
+    {
+      history[(size_t)historyPosition] = signalBuffer[(size_t)i].wet;
+      historyPosition = (historyPosition + 1) % fftSize;
+    }
+
+    samplesSinceFft += numFrames;
+  }
+}
+
+void TubeAnalyzer::updateSpectrum()
+{
+  float windowSum = 0.0f;
+  for (int i = 0; i < fftSize; ++i)
+  {
+    fftData[(size_t)i] = history[(size_t)((historyPosition + i) % fftSize)] * window[(size_t)i];
+    windowSum += window[(size_t)i];
+  }
+  std::fill(fftData.begin() + fftSize, fftData.end(), 0.0f);
+
+  fft.performFrequencyOnlyForwardTransform(fftData.data());
+
+  // A full-scale sine reads 0 dB
+  const float norm = windowSum > 0.0f ? (2.0f / windowSum) : 0.0f;
+  for (int k = 0; k < numBins; ++k)
+    working.spectrumDb[(size_t)k] = juce::Decibels::gainToDecibels(fftData[(size_t)k] * norm, -140.0f);
+
+  // Fundamental: loudest bin between 20 Hz and 5 kHz
+  const double binHz = tap.getSampleRate() / (double)fftSize;
+  const int firstBin = juce::jmax(2, (int)std::ceil(20.0 / binHz));
+  const int lastBin = juce::jmin(numBins / numHarmonics, (int)(5000.0 / binHz));
+
+  int fundamentalBin = firstBin;
+  for (int k = firstBin + 1; k <= lastBin; ++k)
+    if (working.spectrumDb[(size_t)k] > working.spectrumDb[(size_t)fundamentalBin])
+      fundamentalBin = k;
+
+  working.fundamentalHz = (float)(fundamentalBin * binHz);
+
+  // Peak around each harmonic, a couple of bins either side for window spread
+  auto peakAround = [this](int bin)
+  {
+    float peak = -140.0f;
+    for (int k = juce::jmax(0, bin - 2); k <= juce::jmin(numBins - 1, bin + 2); ++k)
+      peak = juce::jmax(peak, working.spectrumDb[(size_t)k]);
+    return peak;
+  };
+
+  const float fundamentalDb = peakAround(fundamentalBin);
+  for (int n = 0; n < numHarmonics; ++n)
+    working.harmonicsDb[(size_t)n] = peakAround(fundamentalBin * (n + 1)) - fundamentalDb;
+}
+
+void TubeAnalyzer::updateScatter()
+{
+  const int numPoints = scatterCount;
+  const int first = (scatterPosition - numPoints + numScatterPoints) % numScatterPoints;
+
+  double plateSum[numStages] = {};
+  double plateSumSquares[numStages] = {};
+
+  for (int i = 0; i < numPoints; ++i)
+  {
+    const auto& frame = scatterHistory[(size_t)((first + i) % numScatterPoints)];
+    working.transferCurve[(size_t)i] = { frame.chainIn, frame.chainOut };
+
+    for (int s = 0; s < numStages; ++s)
+    {
+      working.stageScatter[(size_t)s][(size_t)i] = { frame.vgk[s], frame.vp[s] };
+      plateSum[s] += frame.vp[s];
+      plateSumSquares[s] += (double)frame.vp[s] * (double)frame.vp[s];
+    }
+  }
+
+  for (int s = 0; s < numStages; ++s)
+  {
+    const double mean = numPoints > 0 ? plateSum[s] / numPoints : 0.0;
+    const double variance = numPoints > 0 ? juce::jmax(0.0, plateSumSquares[s] / numPoints - mean * mean) : 0.0;
+    working.stageLevelDb[(size_t)s] = juce::Decibels::gainToDecibels((float)std::sqrt(variance), -140.0f);
+  }
+
+  working.numPoints = numPoints;
+}
@@ -0,0 +1,91 @@
+// tubeAnalyzer.h
+
+#pragma once
+
+#include <JuceHeader.h>
+#include "AnalysisTap.h"
+
+/**
+    Background thread that drains an AnalysisTap and turns it into something to draw:
+    the output spectrum with its harmonic levels, the chain transfer curve, the
+    Vgk -> Vp scatter of every Koren stage and the per-stage plate levels.
+
+    All heavy work (FFT, peak search) happens here; the GUI only copies the latest
+    Snapshot under a short lock.
+*/
+class TubeAnalyzer : private juce::Thread
+{
+public:
+  static constexpr int fftOrder = 12;
+  static constexpr int fftSize = 1 << fftOrder;
+  static constexpr int numBins = fftSize / 2;
+  static constexpr int numHarmonics = 8;
+  static constexpr int numScatterPoints = 1024;
+  static constexpr int numStages = AnalysisTap::numStages;
+
+  struct Snapshot
+  {
+    // Output magnitude spectrum in dBFS, bin k is at k * sampleRate / fftSize
+    std::array<float, numBins> spectrumDb{};
+
+    // Level of harmonic n + 1 relative to the fundamental, in dB ([0] is always 0)
+    std::array<float, numHarmonics> harmonicsDb{};
+    float fundamentalHz = 0.0f;
+
+    // Chain input vs. output at the oversampled rate
+    std::array<juce::Point<float>, numScatterPoints> transferCurve{};
+
+    // Vgk (x) against Vp (y) for each stage
+    std::array<std::array<juce::Point<float>, numScatterPoints>, numStages> stageScatter{};
+
+    // AC level at each plate, in dBV
+    std::array<float, numStages> stageLevelDb{};
+
+    int numPoints = 0;
+    double sampleRate = 44100.0;
+    juce::uint32 serial = 0;
+  };
+
+  explicit TubeAnalyzer(AnalysisTap& tapToRead);
+  ~TubeAnalyzer() override;
+
+  // Starts or stops both the thread and the audio-side capture
+  void setActive(bool shouldBeActive);
+  bool isActive() const { return isThreadRunning(); }
+
+  // Copies the latest snapshot if it is newer than dest. Returns true if it was.
+  bool getLatestSnapshot(Snapshot& dest);
+
+private:
+  void run() override;
+
+  void drainTap();
+  void updateSpectrum();
+  void updateScatter();
+
+  AnalysisTap& tap;
+
+  // Analyzer thread state
+  std::vector<AnalysisTap::StageFrame> stageBuffer;
+  std::vector<AnalysisTap::SignalFrame> signalBuffer;
+
+  std::vector<float> history;        // last fftSize wet samples (circular)
+  int historyPosition = 0;
+  int samplesSinceFft = 0;
+
+  std::vector<AnalysisTap::StageFrame> scatterHistory;   // circular
+  int scatterPosition = 0;
+  int scatterCount = 0;
+
+  juce::dsp::FFT fft{ fftOrder };
+  std::vector<float> window;
+  std::vector<float> fftData;
+
+  Snapshot working;
+
+  // Published to the GUI
+  juce::SpinLock snapshotLock;
+  std::unique_ptr<Snapshot> published;
+
+  JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(TubeAnalyzer)
+};
@@ -0,0 +1,203 @@
+// aliasScan.cpp
+
+#include "AliasScan.h"
+
+namespace
+{
+  int getToneStackLevel(double sampleRate, int cap)
+  {
+    int level = 0;
+    while (level < cap && sampleRate * (double)(1 << level) < (double)ToneStack::minimumSampleRate)
+      ++level;
+
+    return level;
+  }
+
+  DistortionEngine::RatePlan makePlan(const std::array<int, DistortionEngine::numTriodeStages>& levels,
+                                      double sampleRate, int cap)
+  {
+    DistortionEngine::RatePlan plan;
+    plan.stageLevels = levels;
+    plan.toneStackLevel = getToneStackLevel(sampleRate, cap);
+    return plan;
+  }
+
+  int getWork(const std::array<int, DistortionEngine::numTriodeStages>& levels)
+  {
+    int work = 0;
+    for (const auto level : levels)
+      work += 1 << level;
+
+    return work;
+  }
+}
+
+double AliasScan::measure(const Settings& settings, int cap, float drive, float bias,
+                          const DistortionEngine::RatePlan& plan, DistortionEngine::RatePlan* planUsed)
+{
+  const int fftSize = 1 << settings.fftOrder;
+  const int blockSize = 512;
+
+  DistortionEngine engine;
+  engine.setFixedRatePlan(plan);
+  engine.prepare({ settings.sampleRate, (juce::uint32)blockSize, 1 }, cap);
+  engine.reset();
+  engine.setDrive(drive);
+  engine.setBias(bias);
+  engine.setMix(1.0f);
+
+  // The sine repeats every fftSize samples: once to settle, once to measure
+  juce::AudioBuffer<float> buffer(1, fftSize * 2);
+  const double phaseStep = juce::MathConstants<double>::twoPi * (double)settings.sineBin / (double)fftSize;
+  for (int i = 0; i < buffer.getNumSamples(); ++i)
+    buffer.setSample(0, i, settings.sineLevel * (float)std::sin(phaseStep * (double)i));
+
+  for (int start = 0; start < buffer.getNumSamples(); start += blockSize)
+  {
+    float* channel = buffer.getWritePointer(0, start);
+    juce::AudioBuffer<float> block(&channel, 1, juce::jmin(blockSize, buffer.getNumSamples() - start));
+    engine.processBlock((float)settings.sampleRate, block);
+  }
+
+  if (planUsed != nullptr)
+    *planUsed = engine.getRatePlan();
+
+  juce::dsp::FFT fft(settings.fftOrder);
+  std::vector<float> data((size_t)fftSize * 2, 0.0f);
+  std::copy(buffer.getReadPointer(0, fftSize), buffer.getReadPointer(0, fftSize) + fftSize, data.begin());
+  fft.performRealOnlyForwardTransform(data.data(), true);
+
+  const auto power = [&data](int bin) { return (double)data[(size_t)(2 * bin)] * data[(size_t)(2 * bin)]
+                                             + (double)data[(size_t)(2 * bin + 1)] * data[(size_t)(2 * bin + 1)]; };
+
+  const int lastBin = juce::jmin(fftSize / 2, (int)(settings.bandLimitHz * fftSize / settings.sampleRate));
+  double aliasPower = 0.0;
+
+  for (int bin = 1; bin <= lastBin; ++bin)
+    if (bin % settings.sineBin != 0)
+      aliasPower += power(bin);
+
+  const double fundamental = juce::jmax(1.0e-30, power(settings.sineBin));
+  return 10.0 * std::log10(juce::jmax(1.0e-30, aliasPower) / fundamental);
+}
+
+std::vector<AliasScan::Row> AliasScan::scan(const Settings& settings, int maxCap,
+                                            std::function<void(const Row&)> onRow)
+{
+  std::vector<Row> rows;
+  constexpr int numStages = DistortionEngine::numTriodeStages;
+
+  // The previous cap's levels per drive: raising the cap never lowers a stage
+  std::vector<std::array<int, numStages>> lowerCapLevels(settings.drives.size());
+
+  for (int cap = 1; cap <= maxCap; ++cap)
+  {
+    for (size_t d = 0; d < settings.drives.size(); ++d)
+    {
+      const float drive = settings.drives[d];
+
+      Row row;
+      row.cap = cap;
+      row.drive = drive;
+      row.referenceDb = row.planDb = -1000.0;
+
+      for (const float bias : settings.biases)
+      {
+        std::array<int, numStages> levels;
+        levels.fill(cap);
+
+        const double reference = measure(settings, cap, drive, bias, makePlan(levels, settings.sampleRate, cap));
+        const double threshold = juce::jmax(reference + settings.toleranceDb, settings.floorDb);
+        double planDb = reference;
+
+        // Last stage first, so the levels only ever fall along the chain
+        for (int n = numStages - 1; n >= 0; --n)
+        {
+          const int lowest = juce::jmax(n == numStages - 1 ? 0 : levels[(size_t)n + 1],
+                                        lowerCapLevels[d][(size_t)n]);
+
+          while (levels[(size_t)n] > lowest)
+          {
+            auto lowered = levels;
+            --lowered[(size_t)n];
+
+            // The engine keeps stages 1-4 up where the tone stack needs to be
+            DistortionEngine::RatePlan used;
+            const double db = measure(settings, cap, drive, bias, makePlan(lowered, settings.sampleRate, cap), &used);
+            if (db > threshold || used.stageLevels == levels)
+              break;
+
+            levels = used.stageLevels;
+            planDb = db;
+          }
+        }
+
+        for (int n = 0; n < numStages; ++n)
+          row.levels[(size_t)n] = juce::jmax(row.levels[(size_t)n], levels[(size_t)n]);
+
+        row.referenceDb = juce::jmax(row.referenceDb, reference);
+        row.planDb = juce::jmax(row.planDb, planDb);
+      }
+
+      std::array<int, numStages> reference;
+      reference.fill(cap);
+      row.referenceWork = getWork(reference);
+      row.planWork = getWork(row.levels);
+      lowerCapLevels[d] = row.levels;
+
+      if (onRow != nullptr)
+        onRow(row);
+
+      rows.push_back(row);
+    }
+  }
+
+  return rows;
+}
+
+juce::String AliasScan::getTableHeader()
+{
+  return "cap  drive   levels      refDb   planDb   work";
+}
+
+juce::String AliasScan::toTableRow(const Row& row)
+{
+  juce::String levels;
+  for (const auto level : row.levels)
+    levels << level << " ";
+
+  return juce::String(1 << row.cap).paddedLeft(' ', 2) + "x"
+    + juce::String(row.drive, 3).paddedLeft(' ', 7) + "   "
+    + levels.paddedRight(' ', 10)
+    + juce::String(row.referenceDb, 1).paddedLeft(' ', 8)
+    + juce::String(row.planDb, 1).paddedLeft(' ', 9)
+    + (juce::String(row.planWork) + "/" + juce::String(row.referenceWork)).paddedLeft(' ', 7);
+}
+
+juce::String AliasScan::toSource(const std::vector<Row>& rows)
+{
+  juce::String source;
+  int cap = -1;
+
+  for (const auto& row : rows)
+  {
+    if (row.cap != cap)
+    {
+      if (cap >= 0)
+        source << "  },\n";
+
+      source << "  {   // " << (1 << row.cap) << "x\n";
+      cap = row.cap;
+    }
+
+    source << "    {";
+    for (size_t n = 0; n < row.levels.size(); ++n)
+      source << (n == 0 ? " " : ", ") << row.levels[n];
+    source << " },\n";
+  }
+
+  if (cap >= 0)
+    source << "  }\n";
+
+  return source;
+}
@@ -0,0 +1,67 @@
+// aliasScan.h
+
+#pragma once
+
+#include <JuceHeader.h>
+#include "../../Source/DistortionEngine.h"
+
+/**
+    Measures the engine's aliasing and derives the multi-rate plan table
+    (planLevels in DistortionEngine.cpp).
+
+    Aliasing is measured with a coherent sine (an exact FFT bin) through the
+    engine, mono, at full mix: everything in the audio band that is neither DC
+    nor a harmonic of the sine is an aliased product. It is reported relative to
+    the fundamental.
+
+    For every oversampling cap, drive and bias, the reference is the plan with
+    every stage at the cap. Starting from the last stage, each stage is then
+    lowered as far as it goes while the aliasing stays within toleranceDb of the
+    reference, and no lower than it is at the cap below (the measurement near
+    the floor is noisy enough that a higher cap could otherwise come out with
+    fewer levels than a lower one). The table keeps the worst case over the
+    bias range.
+*/
+class AliasScan
+{
+public:
+  struct Settings
+  {
+    double sampleRate = 44100.0;     // the table's reference rate
+    int fftOrder = 13;
+    int sineBin = 929;               // odd, so no aliased product lands on a harmonic (~5 kHz at 44.1 kHz)
+    float sineLevel = 0.5f;
+    double bandLimitHz = 20000.0;    // aliasing above this doesn't count
+    double toleranceDb = 0.5;        // allowed rise over the reference plan
+    double floorDb = -110.0;         // anything below this is fine whatever the reference
+
+    std::vector<float> drives{ 0.25f, 0.375f, 0.5f, 0.625f, 0.75f, 0.875f, 1.0f };
+    std::vector<float> biases{ 0.0f, 0.5f, 1.0f, 1.5f, 2.0f };
+  };
+
+  struct Row
+  {
+    int cap = 0;
+    float drive = 0.0f;
+    std::array<int, DistortionEngine::numTriodeStages> levels{};
+    double referenceDb = 0.0;        // worst bias, every stage at the cap
+    double planDb = 0.0;             // worst bias, with the chosen levels
+    int referenceWork = 0;           // triode stage evaluations per host sample
+    int planWork = 0;
+  };
+
+  // Aliasing of one plan, in dB relative to the fundamental. planUsed gets the
+  // plan the engine actually ran (levels clamped and made to fall along the chain).
+  static double measure(const Settings& settings, int cap, float drive, float bias,
+                        const DistortionEngine::RatePlan& plan, DistortionEngine::RatePlan* planUsed = nullptr);
+
+  // One row per cap (1..maxCap) and drive
+  static std::vector<Row> scan(const Settings& settings, int maxCap,
+                               std::function<void(const Row&)> onRow = nullptr);
+
+  static juce::String getTableHeader();
+  static juce::String toTableRow(const Row& row);
+
+  // The rows as the planLevels initialiser in DistortionEngine.cpp
+  static juce::String toSource(const std::vector<Row>& rows);
+};
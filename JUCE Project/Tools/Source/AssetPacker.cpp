@@ -0,0 +1,140 @@
+// assetPacker.cpp
+
+#include "AssetPacker.h"
+#include "../../Source/KnobSpriteSheet.h"
+
+namespace
+{
+  const char* const sheetNames[] = { "KnobSheet.png", "KnobSheet2x.png" };
+
+  // Best of a few runs, so a cold cache doesn't decide the number
+  template <typename Function>
+  double timeMs(Function&& function, int numRuns = 3)
+  {
+    double best = std::numeric_limits<double>::max();
+
+    for (int run = 0; run < numRuns; ++run)
+    {
+      const auto start = juce::Time::getMillisecondCounterHiRes();
+      function();
+      best = juce::jmin(best, juce::Time::getMillisecondCounterHiRes() - start);
+    }
+
+    return best;
+  }
+
+  juce::String toMegabytes(juce::int64 bytes)
+  {
+    return juce::String((double)bytes / (1024.0 * 1024.0), 2) + " MB";
+  }
+}
+
+bool AssetPacker::packKnobs(const juce::File& framesFolder, const juce::File& outputFolder,
+                            Report& report, juce::String& error)
+{
+  auto files = framesFolder.findChildFiles(juce::File::findFiles, false, "*.png");
+  files.sort();
+
+  if (files.isEmpty())
+  {
+    error = "No PNG frames in " + framesFolder.getFullPathName();
+    return false;
+  }
+
+  if (files.size() != KnobSpriteSheet::numFrames)
+  {
+    error = "Expected " + juce::String(KnobSpriteSheet::numFrames) + " frames, found " + juce::String(files.size());
+    return false;
+  }
+
+  report = {};
+  report.numFrames = files.size();
+
+  juce::Array<juce::MemoryBlock> encodedFrames;
+  for (const auto& file : files)
+  {
+    juce::MemoryBlock data;
+    if (!file.loadFileAsData(data))
+    {
+      error = "Can't read " + file.getFullPathName();
+      return false;
+    }
+
+    report.framesBytes += (juce::int64)data.getSize();
+    encodedFrames.add(std::move(data));
+  }
+
+  juce::Array<juce::Image> frames;
+  report.framesDecodeMs = timeMs([&]
+  {
+    frames.clearQuick();
+    for (const auto& data : encodedFrames)
+      frames.add(juce::ImageFileFormat::loadFrom(data.getData(), data.getSize()));
+  });
+
+  for (int i = 0; i < frames.size(); ++i)
+  {
+    if (!frames[i].isValid())
+    {
+      error = "Can't decode " + files[i].getFullPathName();
+      return false;
+    }
+  }
+
+  if (!outputFolder.createDirectory())
+  {
+    error = "Can't create " + outputFolder.getFullPathName();
+    return false;
+  }
+
+  for (int scale = 1; scale <= KnobSpriteSheet::maxScale; ++scale)
+  {
+    const auto sheet = KnobSpriteSheet::pack(frames, scale);
+
+    juce::MemoryOutputStream encoded;
+    juce::PNGImageFormat png;
+    if (!png.writeImageToStream(sheet, encoded))
+    {
+      error = "Can't encode the " + juce::String(scale) + "x sheet";
+      return false;
+    }
+
+    const auto file = outputFolder.getChildFile(sheetNames[scale - 1]);
+    if (!file.replaceWithData(encoded.getData(), encoded.getDataSize()))
+    {
+      error = "Can't write " + file.getFullPathName();
+      return false;
+    }
+
+    const auto index = (size_t)(scale - 1);
+    report.sheetBytes[index] = (juce::int64)encoded.getDataSize();
+    report.sheetSize[index] = sheet.getWidth();
+    report.sheetDecodeMs[index] = timeMs([&]
+    {
+      juce::ImageFileFormat::loadFrom(encoded.getData(), encoded.getDataSize());
+    });
+  }
+
+  return true;
+}
+
+juce::String AssetPacker::toText(const Report& report)
+{
+  juce::String text;
+  text << "Frames: " << report.numFrames << " PNGs, " << toMegabytes(report.framesBytes)
+       << " embedded, " << juce::String(report.framesDecodeMs, 1) << " ms to decode all\n";
+
+  for (int i = 0; i < 2; ++i)
+  {
+    text << sheetNames[i] << ": " << report.sheetSize[i] << " px, " << toMegabytes(report.sheetBytes[i])
+         << ", " << juce::String(report.sheetDecodeMs[i], 1) << " ms to decode\n";
+  }
+
+  text << "Embedded knob data: " << toMegabytes(report.framesBytes) << " -> "
+       << toMegabytes(report.sheetBytes[0] + report.sheetBytes[1])
+       << ", editor decode: " << juce::String(report.framesDecodeMs, 1) << " ms -> "
+       << juce::String(report.sheetDecodeMs[0], 1) << " ms (1x) / "
+       << juce::String(report.sheetDecodeMs[1], 1) << " ms (2x)";
+
+  return text;
+}
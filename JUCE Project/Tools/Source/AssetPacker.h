@@ -0,0 +1,35 @@
+// assetPacker.h
+
+#pragma once
+
+#include <JuceHeader.h>
+
+/**
+    Build-time asset step for the editor: packs the knob filmstrip (one PNG per
+    frame) into the 1x and 2x sprite sheets that KnobSpriteSheet loads.
+
+    Run it whenever Resources/Knob_2 changes and commit the sheets it writes;
+    the plugin project only embeds the sheets. The report compares what the
+    editor used to embed and decode (every frame) with the sheets.
+*/
+class AssetPacker
+{
+public:
+  struct Report
+  {
+    int numFrames = 0;
+    juce::int64 framesBytes = 0;        // all source frames, as embedded before
+    double framesDecodeMs = 0.0;        // decoding every frame, as the old editor constructor did
+
+    juce::int64 sheetBytes[2] = {};     // 1x and 2x sheets
+    double sheetDecodeMs[2] = {};
+    int sheetSize[2] = {};              // sheet width in pixels
+  };
+
+  // Packs the PNG frames in framesFolder (sorted by name) into KnobSheet.png and
+  // KnobSheet2x.png in outputFolder. Returns false with an error message on failure.
+  static bool packKnobs(const juce::File& framesFolder, const juce::File& outputFolder,
+                        Report& report, juce::String& error);
+
+  static juce::String toText(const Report& report);
+};
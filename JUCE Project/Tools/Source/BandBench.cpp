@@ -0,0 +1,148 @@
+// bandBench.cpp
+
+#include "BandBench.h"
+
+namespace
+{
+  constexpr int numChannels = 2;
+
+  void makeSignal(juce::AudioBuffer<float>& buffer, double sampleRate)
+  {
+    const double twoPi = juce::MathConstants<double>::twoPi;
+
+    for (int i = 0; i < buffer.getNumSamples(); ++i)
+    {
+      const double t = i / sampleRate;
+      double low = 0.0;
+
+      for (int harmonic = 1; harmonic <= 4; ++harmonic)
+        low += std::sin(twoPi * 82.4 * harmonic * t) / harmonic;
+
+      const float x = (float)(0.2 * low + 0.1 * std::sin(twoPi * 1250.0 * t));
+      buffer.setSample(0, i, x);
+      buffer.setSample(1, i, x);
+    }
+  }
+
+  void prepareEngine(DistortionEngine& engine, const BandBench::Settings& settings, int factor,
+    const DistortionEngine::LowBand& lowBand)
+  {
+    engine.setMonoDetection(false);
+    engine.setLowBand(lowBand);
+    engine.prepare({ settings.sampleRate, (juce::uint32)settings.blockSize, (juce::uint32)numChannels }, factor);
+    engine.reset();
+    engine.setDrive(settings.drive);
+    engine.setBias(settings.bias);
+  }
+
+  // Output RMS of a sine, over its second half (the DC high-pass settles in the first)
+  double measureLevel(const BandBench::Settings& settings, int factor, const DistortionEngine::LowBand& lowBand,
+    double frequency)
+  {
+    DistortionEngine engine;
+    prepareEngine(engine, settings, factor, lowBand);
+
+    const int numSamples = juce::roundToInt(settings.sampleRate);
+    juce::AudioBuffer<float> buffer(numChannels, numSamples);
+
+    for (int i = 0; i < numSamples; ++i)
+    {
+      const float x = settings.toneLevel * (float)std::sin(juce::MathConstants<double>::twoPi * frequency * i / settings.sampleRate);
+      buffer.setSample(0, i, x);
+      buffer.setSample(1, i, x);
+    }
+
+    for (int start = 0; start < numSamples; start += settings.blockSize)
+    {
+      const int count = juce::jmin(settings.blockSize, numSamples - start);
+      float* channels[numChannels] = { buffer.getWritePointer(0, start), buffer.getWritePointer(1, start) };
+      juce::AudioBuffer<float> block(channels, numChannels, count);
+      engine.processBlock((float)settings.sampleRate, block);
+    }
+
+    return (double)buffer.getRMSLevel(0, numSamples / 2, numSamples - numSamples / 2);
+  }
+
+  BandBench::Result measure(const BandBench::Settings& settings, const juce::AudioBuffer<float>& input,
+    int factor, const DistortionEngine::LowBand& lowBand)
+  {
+    DistortionEngine engine;
+    prepareEngine(engine, settings, factor, lowBand);
+
+    juce::AudioBuffer<float> buffer(input);
+    const int numSamples = buffer.getNumSamples();
+    juce::int64 ticks = 0;
+
+    for (int start = 0; start < numSamples; start += settings.blockSize)
+    {
+      const int count = juce::jmin(settings.blockSize, numSamples - start);
+      float* channels[numChannels] = { buffer.getWritePointer(0, start), buffer.getWritePointer(1, start) };
+      juce::AudioBuffer<float> block(channels, numChannels, count);
+
+      const auto blockStart = juce::Time::getHighResolutionTicks();
+      engine.processBlock((float)settings.sampleRate, block);
+      ticks += juce::Time::getHighResolutionTicks() - blockStart;
+    }
+
+    BandBench::Result result;
+    result.factor = factor;
+    result.lowFactor = engine.isMultiband() ? lowBand.oversamplingFactor : -1;
+    result.highWork = engine.getTriodeWorkPerSample();
+    result.lowWork = engine.getLowBandWorkPerSample();
+    result.nanosecondsPerSample = juce::Time::highResolutionTicksToSeconds(ticks) * 1.0e9
+      / ((double)numSamples * numChannels);
+    result.lowLevelDb = juce::Decibels::gainToDecibels(measureLevel(settings, factor, lowBand, settings.lowToneHz), -200.0);
+    result.highLevelDb = juce::Decibels::gainToDecibels(measureLevel(settings, factor, lowBand, settings.highToneHz), -200.0);
+    return result;
+  }
+}
+
+std::vector<BandBench::Result> BandBench::run(const Settings& settings)
+{
+  juce::AudioBuffer<float> input(numChannels, juce::jmax(1, juce::roundToInt(settings.seconds * settings.sampleRate)));
+  makeSignal(input, settings.sampleRate);
+
+  std::vector<Result> results;
+
+  auto reference = measure(settings, input, settings.fullFactor, {});
+  reference.name = "full range";
+  results.push_back(reference);
+
+  for (int lowFactor = 0; lowFactor <= juce::jmin(settings.lowFactor, settings.bandFactor); ++lowFactor)
+  {
+    auto lowBand = settings.lowBand;
+    lowBand.oversamplingFactor = lowFactor;
+
+    auto result = measure(settings, input, settings.bandFactor, lowBand);
+    result.name = "split " + juce::String(lowBand.crossoverHz, 0) + " Hz";
+    results.push_back(result);
+  }
+
+  for (auto& result : results)
+  {
+    result.relative = result.nanosecondsPerSample / juce::jmax(1.0e-9, reference.nanosecondsPerSample);
+    result.lowLevelDb -= reference.lowLevelDb;
+    result.highLevelDb -= reference.highLevelDb;
+  }
+
+  return results;
+}
+
+juce::String BandBench::getTableHeader()
+{
+  return "mode            factor  low   work high/low   ns/smp  relative   low dB  high dB";
+}
+
+juce::String BandBench::toTableRow(const Result& r)
+{
+  const auto column = [](const juce::String& text, int width) { return text.paddedLeft(' ', width); };
+
+  return r.name.paddedRight(' ', 14)
+    + column(juce::String(1 << r.factor) + "x", 8)
+    + column(r.lowFactor < 0 ? juce::String("-") : juce::String(1 << r.lowFactor) + "x", 5)
+    + column(juce::String(r.highWork) + "/" + juce::String(r.lowWork), 16)
+    + column(juce::String(r.nanosecondsPerSample, 1), 9)
+    + column(juce::String(r.relative, 2), 10)
+    + column(juce::String(r.lowLevelDb, 1), 9)
+    + column(juce::String(r.highLevelDb, 1), 9);
+}
@@ -0,0 +1,71 @@
+// bandBench.h
+
+#pragma once
+
+#include <JuceHeader.h>
+#include "../../Source/DistortionEngine.h"
+
+/**
+    Measures the cost of multiband processing (DistortionEngine::LowBand) against
+    the full-range chain.
+
+    The same stereo signal (a low E with its overtones under a quieter 1.25 kHz
+    tone) goes through an engine per configuration, in fixed host blocks:
+
+    - full range at fullFactor, the reference;
+    - split at the crossover, the upper band at bandFactor and the low band at
+      each factor from 0 up to lowFactor.
+
+    Each row has the time per sample and channel, the triode stage evaluations
+    per sample in each band (the engine's own counts) and the time relative to the
+    reference.
+
+    It also has the level of each band against the reference: a sine at
+    lowToneHz (below the crossover) and one at highToneHz, each on its own, output
+    RMS over the reference's in dB. Both near 0 dB means the bands are matched
+    before they are summed, whatever the low band's drive (at the calibration
+    level: the two drives compress differently, so further off it they part).
+*/
+class BandBench
+{
+public:
+  struct Settings
+  {
+    double sampleRate = 44100.0;
+    double seconds = 5.0;
+    int blockSize = 256;
+
+    int fullFactor = 3;              // powers of two, as DistortionEngine::prepare
+    int bandFactor = 2;
+    int lowFactor = 1;               // the highest low band factor to run
+
+    // The Split Bass preset's
+    float drive = 0.8f;
+    float bias = 0.5f;
+    DistortionEngine::LowBand lowBand{ 150.0f, 0.3f, 0.5f, 3, 0 };
+
+    // At MakeupGain::referenceLevelDb RMS, the level the band gain is calibrated at
+    double lowToneHz = 60.0;
+    double highToneHz = 1250.0;
+    float toneLevel = 0.178f;
+  };
+
+  struct Result
+  {
+    juce::String name;
+    int factor = 0;
+    int lowFactor = -1;              // -1: no split
+    int highWork = 0;                // triode stage evaluations per host sample and channel
+    int lowWork = 0;
+    double nanosecondsPerSample = 0.0;
+    double relative = 1.0;           // time over the full-range reference
+    double lowLevelDb = 0.0;         // band levels over the reference's
+    double highLevelDb = 0.0;
+  };
+
+  static std::vector<Result> run(const Settings& settings);
+
+  // Text table: one header line, one line per result
+  static juce::String getTableHeader();
+  static juce::String toTableRow(const Result& result);
+};
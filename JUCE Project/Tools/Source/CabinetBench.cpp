@@ -0,0 +1,172 @@
+// cabinetBench.cpp
+
+#include "CabinetBench.h"
+
+namespace
+{
+  constexpr int numChannels = 2;
+
+  // The taps the convolver ends up with at the impulse's own rate: scaled to unit
+  // energy, averaged over the channels
+  juce::AudioBuffer<float> getNormalisedTaps(const CabinetImpulse& impulse)
+  {
+    juce::AudioBuffer<float> taps(impulse.samples);
+    double energy = 0.0;
+
+    for (int ch = 0; ch < taps.getNumChannels(); ++ch)
+      for (int i = 0; i < taps.getNumSamples(); ++i)
+        energy += (double)taps.getSample(ch, i) * taps.getSample(ch, i);
+
+    taps.applyGain((float)(1.0 / std::sqrt(energy / taps.getNumChannels())));
+    return taps;
+  }
+
+  // y[n] = sum of h[k] x[n - k], one dot product per sample over a zero-padded copy
+  // of the input and the reversed taps
+  void convolveNaive(const float* input, float* output, int numSamples, const float* taps, int numTaps)
+  {
+    std::vector<float> padded((size_t)(numTaps - 1 + numSamples), 0.0f);
+    std::copy(input, input + numSamples, padded.begin() + numTaps - 1);
+
+    std::vector<float> reversed(taps, taps + numTaps);
+    std::reverse(reversed.begin(), reversed.end());
+
+    for (int n = 0; n < numSamples; ++n)
+    {
+      const float* x = padded.data() + n;
+      float sum = 0.0f;
+
+      for (int k = 0; k < numTaps; ++k)
+        sum += reversed[(size_t)k] * x[k];
+
+      output[n] = sum;
+    }
+  }
+}
+
+std::shared_ptr<const CabinetImpulse> CabinetBench::makeSyntheticImpulse(const Settings& settings)
+{
+  auto impulse = std::make_shared<CabinetImpulse>();
+  const int length = juce::jmax(1, juce::roundToInt(settings.impulseSeconds * settings.sampleRate));
+
+  impulse->samples.setSize(1, length);
+  impulse->sampleRate = settings.sampleRate;
+  impulse->name = "synthetic";
+
+  juce::Random random(settings.seed);
+  const double decay = std::log(1000.0) / length;
+
+  for (int i = 0; i < length; ++i)
+    impulse->samples.setSample(0, i, (random.nextFloat() * 2.0f - 1.0f) * (float)std::exp(-decay * i));
+
+  return impulse;
+}
+
+CabinetBench::Result CabinetBench::run(const Settings& settings, const CabinetImpulse& impulse)
+{
+  Result result;
+  result.impulseName = impulse.name;
+  result.impulseLength = impulse.samples.getNumSamples();
+  result.sampleRate = impulse.sampleRate;
+  result.blockSize = juce::jmax(1, settings.blockSize);
+
+  const int numSamples = juce::jmax(1, juce::roundToInt(settings.seconds * impulse.sampleRate));
+  const int numNaiveSamples = juce::jlimit(1, numSamples, juce::roundToInt(settings.naiveSeconds * impulse.sampleRate));
+
+  juce::AudioBuffer<float> input(numChannels, numSamples);
+  juce::Random random(settings.seed + 1);
+
+  for (int ch = 0; ch < numChannels; ++ch)
+    for (int i = 0; i < numSamples; ++i)
+      input.setSample(ch, i, 0.5f * (random.nextFloat() * 2.0f - 1.0f));
+
+  // Partitioned, in host blocks
+  DspArena arena;
+  CabinetConvolver convolver;
+  convolver.prepare(&impulse, impulse.sampleRate, numChannels);
+  arena.build([&convolver](DspArena& memory) { convolver.allocate(memory); });
+  convolver.loadImpulse();
+  convolver.reset();
+
+  juce::AudioBuffer<float> output(input);
+  juce::int64 totalTicks = 0, maxTicks = 0;
+  const double startMs = juce::Time::getMillisecondCounterHiRes();
+
+  for (int start = 0; start < numSamples; start += result.blockSize)
+  {
+    const int count = juce::jmin(result.blockSize, numSamples - start);
+    float* channels[numChannels] = { output.getWritePointer(0, start), output.getWritePointer(1, start) };
+
+    const auto blockStart = juce::Time::getHighResolutionTicks();
+    convolver.process(juce::dsp::AudioBlock<float>(channels, numChannels, (size_t)count));
+    const auto ticks = juce::Time::getHighResolutionTicks() - blockStart;
+
+    totalTicks += ticks;
+    maxTicks = juce::jmax(maxTicks, ticks);
+
+    // The next block arrives when this one would have finished playing
+    if (settings.paced)
+    {
+      const double dueMs = startMs + 1000.0 * (start + count) / impulse.sampleRate;
+      const double waitMs = dueMs - juce::Time::getMillisecondCounterHiRes();
+
+      if (waitMs >= 1.0)
+        juce::Thread::sleep((int)waitMs);
+    }
+  }
+
+  result.nanosecondsPerSample = juce::Time::highResolutionTicksToSeconds(totalTicks) * 1.0e9
+    / ((double)numSamples * numChannels);
+  result.maxBlockMicroseconds = juce::Time::highResolutionTicksToSeconds(maxTicks) * 1.0e6;
+  result.lateOnWorker = convolver.getLateBlockStats().onWorker;
+  result.lateOnAudioThread = convolver.getLateBlockStats().onAudioThread;
+
+  // Naive, over the start of the same input
+  const auto taps = getNormalisedTaps(impulse);
+  std::vector<float> reference((size_t)numNaiveSamples);
+  juce::int64 naiveTicks = 0;
+  double peak = 0.0, maxError = 0.0;
+
+  for (int ch = 0; ch < numChannels; ++ch)
+  {
+    const int tapChannel = juce::jmin(ch, taps.getNumChannels() - 1);
+
+    const auto naiveStart = juce::Time::getHighResolutionTicks();
+    convolveNaive(input.getReadPointer(ch), reference.data(), numNaiveSamples,
+      taps.getReadPointer(tapChannel), taps.getNumSamples());
+    naiveTicks += juce::Time::getHighResolutionTicks() - naiveStart;
+
+    for (int i = 0; i < numNaiveSamples; ++i)
+    {
+      peak = juce::jmax(peak, (double)std::abs(reference[(size_t)i]));
+      maxError = juce::jmax(maxError, (double)std::abs(reference[(size_t)i] - output.getSample(ch, i)));
+    }
+  }
+
+  result.naiveNanosecondsPerSample = juce::Time::highResolutionTicksToSeconds(naiveTicks) * 1.0e9
+    / ((double)numNaiveSamples * numChannels);
+  result.speedup = result.naiveNanosecondsPerSample / juce::jmax(1.0e-9, result.nanosecondsPerSample);
+  result.errorDb = juce::Decibels::gainToDecibels(maxError / juce::jmax(1.0e-30, peak), -200.0);
+  return result;
+}
+
+juce::String CabinetBench::getTableHeader()
+{
+  return "impulse          taps    rate  block   ns/smp  max us   naive ns  speedup  errorDb  late worker/audio";
+}
+
+juce::String CabinetBench::toTableRow(const Result& r)
+{
+  const auto column = [](const juce::String& text, int width) { return text.paddedLeft(' ', width); };
+
+  return r.impulseName.substring(0, 12).paddedRight(' ', 12)
+    + column(juce::String(r.impulseLength), 9)
+    + column(juce::String(r.sampleRate, 0), 8)
+    + column(juce::String(r.blockSize), 7)
+    + column(juce::String(r.nanosecondsPerSample, 1), 9)
+    + column(juce::String(r.maxBlockMicroseconds, 1), 8)
+    + column(juce::String(r.naiveNanosecondsPerSample, 1), 11)
+    + column(juce::String(r.speedup, 1), 9)
+    + column(juce::String(r.errorDb, 1), 9)
+    + column(juce::String(r.lateOnWorker) + "/" + juce::String(r.lateOnAudioThread), 19);
+}
@@ -0,0 +1,66 @@
+// cabinetBench.h
+
+#pragma once
+
+#include <JuceHeader.h>
+#include "../../Source/CabinetConvolver.h"
+
+/**
+    Benchmarks the cabinet convolver against a naive time-domain FIR with the same
+    taps.
+
+    Stereo white noise goes through a CabinetConvolver in fixed host blocks, timed
+    per block, and through a direct-form FIR (one dot product per output sample)
+    for the first naiveSeconds. Both run at the impulse's own rate, so the taps are
+    the same and the naive output is the reference for the convolver's error.
+
+    Late blocks are counted by where they were computed: on the worker, or on the
+    audio thread because the worker wasn't done in time. Unpaced, blocks come as
+    fast as the convolver takes them and the worker has little time; paced, they
+    come at real-time speed the way a host sends them.
+*/
+class CabinetBench
+{
+public:
+  struct Settings
+  {
+    double seconds = 10.0;           // audio through the convolver
+    double naiveSeconds = 1.0;       // through the naive FIR (it is slow)
+    int blockSize = 256;
+    bool paced = false;              // blocks at real-time speed
+
+    // The synthetic impulse, for runs without a file
+    double sampleRate = 48000.0;
+    double impulseSeconds = 0.5;
+    juce::int64 seed = 1;
+  };
+
+  struct Result
+  {
+    juce::String impulseName;
+    int impulseLength = 0;            // taps
+    double sampleRate = 0.0;
+    int blockSize = 0;
+
+    // Per sample and channel
+    double nanosecondsPerSample = 0.0;
+    double naiveNanosecondsPerSample = 0.0;
+    double speedup = 0.0;
+
+    double maxBlockMicroseconds = 0.0;
+    double errorDb = 0.0;             // worst difference to the naive FIR, relative to its peak
+
+    int lateOnWorker = 0;
+    int lateOnAudioThread = 0;
+  };
+
+  // Exponentially decaying noise (a stand-in for a cabinet's response), 60 dB down
+  // at its end
+  static std::shared_ptr<const CabinetImpulse> makeSyntheticImpulse(const Settings& settings);
+
+  static Result run(const Settings& settings, const CabinetImpulse& impulse);
+
+  // Text table: one header line, one line per result
+  static juce::String getTableHeader();
+  static juce::String toTableRow(const Result& result);
+};
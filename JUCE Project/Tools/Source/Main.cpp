@@ -0,0 +1,391 @@
+// main.cpp
+
+#include <JuceHeader.h>
+#include <iostream>
+#include "StressHarness.h"
+#include "AssetPacker.h"
+#include "AliasScan.h"
+#include "CabinetBench.h"
+#include "BandBench.h"
+#include "OversamplingBench.h"
+#include "MakeupScan.h"
+#include "QualityScan.h"
+#include "SegmentedRenderer.h"
+#include "../../Source/RealtimeSanitizer.h"
+
+namespace
+{
+  int getIntOption(const juce::ArgumentList& args, const juce::String& option, int defaultValue)
+  {
+    return args.containsOption(option) ? args.getValueForOption(option).getIntValue() : defaultValue;
+  }
+
+  double getDoubleOption(const juce::ArgumentList& args, const juce::String& option, double defaultValue)
+  {
+    return args.containsOption(option) ? args.getValueForOption(option).getDoubleValue() : defaultValue;
+  }
+
+  // Prints where the audio thread allocated, locked or blocked, and fails the run
+  void failOnViolations()
+  {
+    if (RealtimeSanitizer::getNumViolations() == 0)
+      return;
+
+    std::cout << std::endl << RealtimeSanitizer::toText(RealtimeSanitizer::getReports()) << std::flush;
+    juce::ConsoleApplication::fail(juce::String(RealtimeSanitizer::getNumViolations())
+      + " real-time-safety violations in processBlock");
+  }
+
+  void runStress(const juce::ArgumentList& args)
+  {
+    StressHarness::Settings settings;
+    settings.numInstances = getIntOption(args, "--instances", settings.numInstances);
+    settings.numThreads = getIntOption(args, "--threads", settings.numThreads);
+    settings.seconds = getDoubleOption(args, "--seconds", settings.seconds);
+    settings.maxPeriod = getIntOption(args, "--max-period", settings.maxPeriod);
+    settings.seed = getIntOption(args, "--seed", (int)settings.seed);
+    settings.randomBlocks = !args.containsOption("--fixed-blocks");
+    settings.automate = !args.containsOption("--no-automation");
+    settings.toggleBypass = !args.containsOption("--no-bypass");
+    settings.reprepare = !args.containsOption("--no-prepare");
+
+    std::cout << StressHarness::getTableHeader() << std::endl;
+
+    if (!args.containsOption("--sweep"))
+    {
+      std::cout << StressHarness::toTableRow(StressHarness::run(settings)) << std::endl;
+      failOnViolations();
+      return;
+    }
+
+    // Scaling: instance and thread counts in powers of two up to the given ones
+    const int maxInstances = settings.numInstances;
+    const int maxThreads = settings.numThreads;
+
+    for (int threads = 1; threads <= maxThreads; threads *= 2)
+    {
+      for (int instances = threads; instances <= maxInstances; instances *= 2)
+      {
+        settings.numThreads = threads;
+        settings.numInstances = instances;
+        std::cout << StressHarness::toTableRow(StressHarness::run(settings)) << std::endl;
+        failOnViolations();
+      }
+    }
+  }
+
+  void runPackKnobs(const juce::ArgumentList& args)
+  {
+    args.checkMinNumArguments(3);
+
+    const auto framesFolder = args[1].resolveAsExistingFolder();
+    const auto outputFolder = args[2].resolveAsFile();
+
+    AssetPacker::Report report;
+    juce::String error;
+
+    if (!AssetPacker::packKnobs(framesFolder, outputFolder, report, error))
+      juce::ConsoleApplication::fail(error);
+
+    std::cout << AssetPacker::toText(report) << std::endl;
+  }
+
+  void runAliasScan(const juce::ArgumentList& args)
+  {
+    AliasScan::Settings settings;
+    settings.sampleRate = getDoubleOption(args, "--rate", settings.sampleRate);
+    settings.toleranceDb = getDoubleOption(args, "--tolerance", settings.toleranceDb);
+    const int maxCap = juce::jlimit(1, HalfBandOversampler::maxStages, getIntOption(args, "--max-cap", 4));
+
+    std::cout << AliasScan::getTableHeader() << std::endl;
+
+    const auto rows = AliasScan::scan(settings, maxCap, [](const AliasScan::Row& row)
+    {
+      std::cout << AliasScan::toTableRow(row) << std::endl;
+    });
+
+    std::cout << std::endl << AliasScan::toSource(rows) << std::endl;
+  }
+
+  void runCabinetBench(const juce::ArgumentList& args)
+  {
+    CabinetBench::Settings settings;
+    settings.seconds = getDoubleOption(args, "--seconds", settings.seconds);
+    settings.naiveSeconds = getDoubleOption(args, "--naive-seconds", settings.naiveSeconds);
+    settings.blockSize = getIntOption(args, "--block", settings.blockSize);
+    settings.paced = args.containsOption("--paced");
+    settings.sampleRate = getDoubleOption(args, "--rate", settings.sampleRate);
+    settings.impulseSeconds = getDoubleOption(args, "--length", settings.impulseSeconds);
+
+    std::shared_ptr<const CabinetImpulse> impulse;
+
+    if (args.containsOption("--impulse"))
+    {
+      juce::String error;
+      impulse = CabinetImpulse::loadFromFile(args.getExistingFileForOption("--impulse"), error);
+
+      if (impulse == nullptr)
+        juce::ConsoleApplication::fail(error);
+    }
+    else
+    {
+      impulse = CabinetBench::makeSyntheticImpulse(settings);
+    }
+
+    std::cout << CabinetBench::getTableHeader() << std::endl;
+    std::cout << CabinetBench::toTableRow(CabinetBench::run(settings, *impulse)) << std::endl;
+  }
+
+  void runBandBench(const juce::ArgumentList& args)
+  {
+    BandBench::Settings settings;
+    settings.sampleRate = getDoubleOption(args, "--rate", settings.sampleRate);
+    settings.seconds = getDoubleOption(args, "--seconds", settings.seconds);
+    settings.blockSize = getIntOption(args, "--block", settings.blockSize);
+    settings.fullFactor = juce::jlimit(0, HalfBandOversampler::maxStages, getIntOption(args, "--full-factor", settings.fullFactor));
+    settings.bandFactor = juce::jlimit(0, HalfBandOversampler::maxStages, getIntOption(args, "--band-factor", settings.bandFactor));
+    settings.lowFactor = getIntOption(args, "--low-factor", settings.lowFactor);
+    settings.drive = (float)getDoubleOption(args, "--drive", settings.drive);
+    settings.lowBand.crossoverHz = (float)getDoubleOption(args, "--crossover", settings.lowBand.crossoverHz);
+    settings.lowBand.drive = (float)getDoubleOption(args, "--low-drive", settings.lowBand.drive);
+    settings.lowBand.numStages = getIntOption(args, "--low-stages", settings.lowBand.numStages);
+
+    std::cout << BandBench::getTableHeader() << std::endl;
+
+    for (const auto& result : BandBench::run(settings))
+      std::cout << BandBench::toTableRow(result) << std::endl;
+  }
+
+  void runOversamplingBench(const juce::ArgumentList& args)
+  {
+    OversamplingBench::Settings settings;
+    settings.sampleRate = getDoubleOption(args, "--rate", settings.sampleRate);
+    settings.seconds = getDoubleOption(args, "--seconds", settings.seconds);
+    settings.blockSize = juce::jmax(1, getIntOption(args, "--block", settings.blockSize));
+    settings.maxFactor = juce::jlimit(1, HalfBandOversampler::maxStages, getIntOption(args, "--max-factor", settings.maxFactor));
+
+    std::cout << OversamplingBench::getTableHeader() << std::endl;
+
+    for (const auto& result : OversamplingBench::run(settings))
+      std::cout << OversamplingBench::toTableRow(result) << std::endl;
+  }
+
+  void runMakeupScan(const juce::ArgumentList& args)
+  {
+    MakeupScan::Settings settings;
+    settings.sampleRate = getDoubleOption(args, "--rate", settings.sampleRate);
+    settings.seconds = getDoubleOption(args, "--seconds", settings.seconds);
+    settings.levelDb = (float)getDoubleOption(args, "--level", settings.levelDb);
+    settings.oversamplingFactor = juce::jlimit(0, HalfBandOversampler::maxStages,
+      getIntOption(args, "--factor", settings.oversamplingFactor));
+
+    std::cout << MakeupScan::getTableHeader() << std::endl;
+
+    const auto rows = MakeupScan::scan(settings, [](const MakeupScan::Row& row)
+    {
+      std::cout << MakeupScan::toTableRow(row) << std::endl;
+    });
+
+    std::cout << std::endl << MakeupScan::toSource(rows) << std::endl;
+    std::cout << MakeupScan::toCorrelationSource(rows) << std::endl;
+  }
+
+  void runQualityScan(const juce::ArgumentList& args)
+  {
+    QualityScan::Settings settings;
+    settings.sampleRate = getDoubleOption(args, "--rate", settings.sampleRate);
+    settings.fftOrder = juce::jlimit(10, 16, getIntOption(args, "--fft-order", settings.fftOrder));
+    settings.maxFactor = juce::jlimit(0, HalfBandOversampler::maxStages, getIntOption(args, "--max-factor", settings.maxFactor));
+
+    std::cout << QualityScan::getTableHeader() << std::endl;
+
+    auto results = QualityScan::scan(settings, [](const QualityScan::Result& result)
+    {
+      std::cout << QualityScan::toTableRow(result) << std::endl;
+    });
+
+    // The front again, cheapest first
+    std::sort(results.begin(), results.end(), [](const QualityScan::Result& a, const QualityScan::Result& b)
+    {
+      return a.nanosecondsPerSample < b.nanosecondsPerSample;
+    });
+
+    std::cout << std::endl << QualityScan::getTableHeader() << std::endl;
+
+    for (const auto& result : results)
+      if (result.pareto)
+        std::cout << QualityScan::toTableRow(result) << std::endl;
+  }
+
+  void runRender(const juce::ArgumentList& args)
+  {
+    SegmentedRenderer::Settings settings;
+    settings.sampleRate = getDoubleOption(args, "--rate", settings.sampleRate);
+    settings.oversamplingFactor = juce::jlimit(0, HalfBandOversampler::maxStages,
+      getIntOption(args, "--factor", settings.oversamplingFactor));
+    settings.phase = args.containsOption("--linear") ? HalfBandOversampler::Phase::linearPhase
+                                                     : HalfBandOversampler::Phase::minimumPhase;
+    settings.multiRate = !args.containsOption("--no-multi-rate");
+    settings.smallSignalFastPath = !args.containsOption("--no-fast-path");
+    settings.compositeStages = !args.containsOption("--no-composite");
+    settings.drive = (float)getDoubleOption(args, "--drive", settings.drive);
+    settings.bias = (float)getDoubleOption(args, "--bias", settings.bias);
+    settings.mix = (float)getDoubleOption(args, "--mix", settings.mix);
+    settings.midSide = args.containsOption("--mid-side");
+    settings.sideEconomy = args.containsOption("--side-economy");
+    settings.drift = (float)getDoubleOption(args, "--drift", settings.drift);
+    settings.driftSeed = (juce::uint32)getIntOption(args, "--drift-seed", (int)settings.driftSeed);
+    settings.makeupGain = args.containsOption("--makeup");
+    settings.lowBand.crossoverHz = (float)getDoubleOption(args, "--crossover", settings.lowBand.crossoverHz);
+    settings.lowBand.drive = (float)getDoubleOption(args, "--low-drive", settings.lowBand.drive);
+    settings.lowBand.bias = (float)getDoubleOption(args, "--low-bias", settings.lowBand.bias);
+    settings.lowBand.numStages = getIntOption(args, "--low-stages", settings.lowBand.numStages);
+    settings.lowBand.oversamplingFactor = getIntOption(args, "--low-factor", settings.lowBand.oversamplingFactor);
+    settings.blockSize = getIntOption(args, "--block", settings.blockSize);
+    settings.segmentSeconds = getDoubleOption(args, "--segment", settings.segmentSeconds);
+    settings.preRollSeconds = getDoubleOption(args, "--pre-roll", settings.preRollSeconds);
+    settings.numThreads = getIntOption(args, "--threads", settings.numThreads);
+
+    if (args.containsOption("--cabinet"))
+    {
+      juce::String error;
+      settings.cabinet = CabinetImpulse::loadFromFile(args.getExistingFileForOption("--cabinet"), error);
+
+      if (settings.cabinet == nullptr)
+        juce::ConsoleApplication::fail(error);
+    }
+
+    SegmentedRenderer::Result result;
+
+    if (args.size() >= 3)
+    {
+      result = SegmentedRenderer::renderFile(args[1].resolveAsExistingFile(), args[2].resolveAsFile(), settings,
+        !args.containsOption("--no-verify"));
+
+      if (result.numSegments == 0)
+        juce::ConsoleApplication::fail("Couldn't read " + args[1].text + " or write " + args[2].text);
+    }
+    else
+    {
+      // No file: stereo pink noise at the makeup gain's reference level
+      MakeupScan::Settings noiseSettings;
+      noiseSettings.sampleRate = settings.sampleRate;
+      noiseSettings.seconds = getDoubleOption(args, "--seconds", 60.0);
+
+      juce::AudioBuffer<float> output;
+      result = SegmentedRenderer::renderAndVerify(MakeupScan::makeNoise(noiseSettings), output, settings);
+    }
+
+    std::cout << SegmentedRenderer::getTableHeader() << std::endl;
+    std::cout << SegmentedRenderer::toTableRow(result) << std::endl;
+
+    if (result.verified && !result.matchesSerial)
+      juce::ConsoleApplication::fail("The segmented render is further from the serial one than rounding");
+  }
+
+}
+
+int main(int argc, char* argv[])
+{
+  // The processor's parameter tree wants a message manager
+  juce::ScopedJuceInitialiser_GUI juceInitialiser;
+
+  juce::ConsoleApplication app;
+  app.addHelpCommand("--help|-h", "Usage:", true);
+
+  app.addCommand({ "stress",
+    "stress [--instances=N] [--threads=T] [--seconds=S] [--max-period=P] [--seed=X] [--sweep]\n"
+    "       [--fixed-blocks] [--no-automation] [--no-bypass] [--no-prepare]",
+    "Runs N headless Eldur instances on T simulated host threads",
+    "Reports the deadline-miss rate, p50/p99/p999 processBlock time, load per thread\n"
+    "and the time from prepareToPlay to the first block through the built engine.\n"
+    "--sweep repeats the run for power-of-two instance and thread counts up to N and T.\n"
+    "Built with the RtSanitizer configuration, it also fails with a stack trace per\n"
+    "call site if processBlock allocates, locks or blocks.",
+    [](const juce::ArgumentList& args) { runStress(args); } });
+
+  app.addCommand({ "pack-knobs",
+    "pack-knobs <frames folder> <output folder>",
+    "Packs the knob filmstrip into the editor's 1x and 2x sprite sheets",
+    "Reads every PNG frame in the frames folder (e.g. Resources/Knob_2), writes\n"
+    "KnobSheet.png and KnobSheet2x.png to the output folder (e.g. Resources) and reports\n"
+    "the embedded size and decode time before and after.",
+    [](const juce::ArgumentList& args) { runPackKnobs(args); } });
+
+  app.addCommand({ "alias-scan",
+    "alias-scan [--rate=HZ] [--tolerance=DB] [--max-cap=N]",
+    "Measures aliasing per rate plan and prints the engine's multi-rate table",
+    "For every oversampling cap up to 2^N, drive and bias, lowers each triode stage's\n"
+    "oversampling as far as the aliasing stays within the tolerance of the all-at-cap\n"
+    "plan, then prints the table (paste it into planLevels in DistortionEngine.cpp).",
+    [](const juce::ArgumentList& args) { runAliasScan(args); } });
+
+  app.addCommand({ "cab-bench",
+    "cab-bench [--impulse=FILE] [--seconds=S] [--naive-seconds=S] [--block=N] [--paced]\n"
+    "          [--rate=HZ] [--length=S]",
+    "Benchmarks the cabinet convolver against a naive FIR",
+    "Runs stereo noise through the partitioned convolver in N-sample blocks and through\n"
+    "a direct-form FIR with the same taps, and reports the time per sample of both, the\n"
+    "longest block, the convolver's error and where its late blocks were computed.\n"
+    "Without --impulse it uses decaying noise of --length seconds at --rate.\n"
+    "--paced sends the blocks at real-time speed, as a host would.",
+    [](const juce::ArgumentList& args) { runCabinetBench(args); } });
+
+  app.addCommand({ "band-bench",
+    "band-bench [--rate=HZ] [--seconds=S] [--block=N] [--full-factor=F] [--band-factor=F]\n"
+    "           [--low-factor=F] [--drive=D] [--crossover=HZ] [--low-drive=D] [--low-stages=N]",
+    "Compares the cost of multiband processing with the full-range chain",
+    "Runs a bass-heavy stereo signal through the full-range chain at 2^full-factor and\n"
+    "through the band split, the upper band at 2^band-factor and the low band at each\n"
+    "factor up to 2^low-factor, and reports the triode stage evaluations per sample in\n"
+    "each band and the time per sample against the full-range chain. For each split it\n"
+    "also reports the level of a sine below the crossover and one above it against the\n"
+    "full-range chain: both near 0 dB means the bands are level-matched.",
+    [](const juce::ArgumentList& args) { runBandBench(args); } });
+
+  app.addCommand({ "os-bench",
+    "os-bench [--rate=HZ] [--seconds=S] [--block=N] [--max-factor=F]",
+    "Compares the half-band oversampler with juce::dsp::Oversampling",
+    "Runs stereo noise up and down through HalfBandOversampler and through\n"
+    "juce::dsp::Oversampling (polyphase IIR for minimum phase, equiripple FIR for\n"
+    "linear phase, maximum quality) in N-sample blocks, for every factor up to\n"
+    "2^max-factor, and reports the time per sample of both and their latencies.",
+    [](const juce::ArgumentList& args) { runOversamplingBench(args); } });
+
+  app.addCommand({ "makeup-scan",
+    "makeup-scan [--rate=HZ] [--seconds=S] [--level=DB] [--factor=F]",
+    "Measures the calibrated auto-gain's makeup-gain table",
+    "Runs stereo pink noise at --level dB RMS through the engine for every drive and\n"
+    "bias of the table's grid, prints the makeup gain (input over output RMS) with the\n"
+    "shipped table's error per row and the error of the gain predicted at lower mixes,\n"
+    "then the gains and the output's correlation with the input (paste them into\n"
+    "gainTable and correlationTable in MakeupGain.cpp).",
+    [](const juce::ArgumentList& args) { runMakeupScan(args); } });
+
+  app.addCommand({ "quality-scan",
+    "quality-scan [--rate=HZ] [--max-factor=F] [--fft-order=N]",
+    "Measures aliasing, THD+N, solver error and CPU per quality setting",
+    "For every oversampling factor up to 2^max-factor, rate plan, stage path (Newton,\n"
+    "small-signal fast path, composite) and Newton iteration limit and tolerance, runs\n"
+    "sines and a multitone through the engine and reports the time per sample, the\n"
+    "worst aliasing and THD+N and the difference to a reference with every stage at\n"
+    "the full rate and every sample solved to convergence in double precision.\n"
+    "Rows on the Pareto front (time, aliasing, error) are marked, then listed again.",
+    [](const juce::ArgumentList& args) { runQualityScan(args); } });
+
+  app.addCommand({ "render",
+    "render [<input file> <output file>] [--seconds=S] [--rate=HZ] [--factor=F] [--linear]\n"
+    "       [--no-multi-rate] [--no-fast-path] [--no-composite] [--drive=D] [--bias=B] [--mix=M]\n"
+    "       [--mid-side] [--side-economy] [--drift=D] [--drift-seed=X] [--makeup] [--cabinet=FILE]\n"
+    "       [--crossover=HZ] [--low-drive=D] [--low-bias=B] [--low-stages=N] [--low-factor=F]\n"
+    "       [--block=N] [--segment=S] [--pre-roll=S] [--threads=T] [--no-verify]",
+    "Renders offline in parallel segments and checks the result against a serial render",
+    "Cuts the input into segments rendered on T threads (see SegmentedRenderer), then\n"
+    "renders it serially and once more with every input sample nudged by one ulp, and\n"
+    "fails if the segmented output is further from the serial one than that rounding\n"
+    "floor (plus 6 dB). With files it writes a 32-bit float WAV at the input's rate;\n"
+    "without, it renders S seconds of stereo pink noise at --rate and keeps nothing.",
+    [](const juce::ArgumentList& args) { runRender(args); } });
+
+  return app.findAndRunCommand(argc, argv);
+}
@@ -0,0 +1,174 @@
+// makeupScan.cpp
+
+#include "MakeupScan.h"
+
+namespace
+{
+  constexpr int numChannels = 2;
+
+  double getRms(const juce::AudioBuffer<float>& buffer, int start)
+  {
+    double sum = 0.0;
+
+    for (int ch = 0; ch < buffer.getNumChannels(); ++ch)
+      for (int i = start; i < buffer.getNumSamples(); ++i)
+        sum += (double)buffer.getSample(ch, i) * buffer.getSample(ch, i);
+
+    return std::sqrt(sum / juce::jmax(1.0, (double)buffer.getNumChannels() * (buffer.getNumSamples() - start)));
+  }
+
+  double getCorrelation(const juce::AudioBuffer<float>& a, const juce::AudioBuffer<float>& b, int start)
+  {
+    double ab = 0.0, aa = 0.0, bb = 0.0;
+
+    for (int ch = 0; ch < a.getNumChannels(); ++ch)
+    {
+      for (int i = start; i < a.getNumSamples(); ++i)
+      {
+        const double x = a.getSample(ch, i), y = b.getSample(ch, i);
+        ab += x * y;
+        aa += x * x;
+        bb += y * y;
+      }
+    }
+
+    return ab / juce::jmax(1.0e-30, std::sqrt(aa * bb));
+  }
+
+  juce::String toInitialiser(const std::vector<MakeupScan::Row>& rows,
+                             std::function<float(const MakeupScan::Row&, size_t)> getValue)
+  {
+    juce::String source;
+
+    for (size_t r = 0; r < rows.size(); ++r)
+    {
+      source << "    {";
+
+      for (size_t b = 0; b < (size_t)MakeupGain::numBiases; ++b)
+        source << (b == 0 ? "" : ",") << (juce::String(getValue(rows[r], b), 2) + "f").paddedLeft(' ', 8);
+
+      source << (r + 1 < rows.size() ? " },   // " : " }    // ") << juce::String(rows[r].drive, 4) << "\n";
+    }
+
+    return source;
+  }
+}
+
+juce::AudioBuffer<float> MakeupScan::makeNoise(const Settings& settings)
+{
+  juce::AudioBuffer<float> noise(numChannels, juce::jmax(1, juce::roundToInt(settings.seconds * settings.sampleRate)));
+  juce::Random random(settings.seed);
+
+  for (int ch = 0; ch < numChannels; ++ch)
+  {
+    double b[7] = {};
+
+    for (int i = 0; i < noise.getNumSamples(); ++i)
+    {
+      const double white = random.nextDouble() * 2.0 - 1.0;
+      b[0] = 0.99886 * b[0] + white * 0.0555179;
+      b[1] = 0.99332 * b[1] + white * 0.0750759;
+      b[2] = 0.96900 * b[2] + white * 0.1538520;
+      b[3] = 0.86650 * b[3] + white * 0.3104856;
+      b[4] = 0.55000 * b[4] + white * 0.5329522;
+      b[5] = -0.7616 * b[5] - white * 0.0168980;
+      noise.setSample(ch, i, (float)(b[0] + b[1] + b[2] + b[3] + b[4] + b[5] + b[6] + white * 0.5362));
+      b[6] = white * 0.115926;
+    }
+  }
+
+  noise.applyGain(juce::Decibels::decibelsToGain(settings.levelDb) / (float)getRms(noise, 0));
+  return noise;
+}
+
+MakeupScan::Measurement MakeupScan::measure(const Settings& settings, const juce::AudioBuffer<float>& noise,
+                                            float drive, float bias, float mix)
+{
+  DistortionEngine engine;
+  engine.prepare({ settings.sampleRate, (juce::uint32)settings.blockSize, (juce::uint32)numChannels }, settings.oversamplingFactor);
+  engine.reset();
+  engine.setDrive(drive);
+  engine.setBias(bias);
+  engine.setMix(mix);
+
+  juce::AudioBuffer<float> buffer(noise);
+
+  for (int start = 0; start < buffer.getNumSamples(); start += settings.blockSize)
+  {
+    float* channels[numChannels] = { buffer.getWritePointer(0, start), buffer.getWritePointer(1, start) };
+    juce::AudioBuffer<float> block(channels, numChannels, juce::jmin(settings.blockSize, buffer.getNumSamples() - start));
+    engine.processBlock((float)settings.sampleRate, block);
+  }
+
+  // The gain goes on the engine's output as it comes, ahead of the brickwall limiter
+  const int start = juce::jlimit(0, buffer.getNumSamples() - 1, juce::roundToInt(settings.settleSeconds * settings.sampleRate));
+
+  Measurement measurement;
+  measurement.gainDb = (float)juce::Decibels::gainToDecibels(getRms(noise, start) / juce::jmax(1.0e-12, getRms(buffer, start)), -200.0);
+  measurement.correlation = (float)getCorrelation(noise, buffer, start);
+  return measurement;
+}
+
+std::vector<MakeupScan::Row> MakeupScan::scan(const Settings& settings, std::function<void(const Row&)> onRow)
+{
+  const auto noise = makeNoise(settings);
+  std::vector<Row> rows;
+
+  for (int d = 0; d < MakeupGain::numDrives; ++d)
+  {
+    Row row;
+    row.drive = MakeupGain::getDrive(d);
+
+    for (int b = 0; b < MakeupGain::numBiases; ++b)
+    {
+      const float bias = MakeupGain::getBias(b);
+      const auto full = measure(settings, noise, row.drive, bias);
+      row.gainDb[(size_t)b] = full.gainDb;
+      row.correlation[(size_t)b] = full.correlation;
+      row.tableErrorDb = juce::jmax(row.tableErrorDb, std::abs(MakeupGain::getGainDb(row.drive, bias) - full.gainDb));
+
+      for (const float mix : settings.mixes)
+      {
+        const float measured = measure(settings, noise, row.drive, bias, mix).gainDb;
+        row.mixErrorDb = juce::jmax(row.mixErrorDb, std::abs(MakeupGain::getGainDb(row.drive, bias, mix) - measured));
+      }
+    }
+
+    rows.push_back(row);
+
+    if (onRow != nullptr)
+      onRow(row);
+  }
+
+  return rows;
+}
+
+juce::String MakeupScan::getTableHeader()
+{
+  juce::String header("drive ");
+
+  for (int b = 0; b < MakeupGain::numBiases; ++b)
+    header << ("b=" + juce::String(MakeupGain::getBias(b), 2)).paddedLeft(' ', 8);
+
+  return header + "  table err  mix err";
+}
+
+juce::String MakeupScan::toTableRow(const Row& row)
+{
+  juce::String text = juce::String(row.drive, 3).paddedRight(' ', 6);
+
+  for (const auto gain : row.gainDb)
+    text << juce::String(gain, 2).paddedLeft(' ', 8);
+
+  return text + juce::String(row.tableErrorDb, 2).paddedLeft(' ', 11) + juce::String(row.mixErrorDb, 2).paddedLeft(' ', 9);
+}
+
+juce::String MakeupScan::toSource(const std::vector<Row>& rows)
+{
+  return toInitialiser(rows, [](const Row& row, size_t b) { return row.gainDb[b]; });
+}
+
+juce::String MakeupScan::toCorrelationSource(const std::vector<Row>& rows)
+{
+  return toInitialiser(rows, [](const Row& row, size_t b) { return row.correlation[b]; });
+}
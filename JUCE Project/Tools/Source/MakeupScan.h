@@ -0,0 +1,77 @@
+// makeupScan.h
+
+#pragma once
+
+#include <JuceHeader.h>
+#include "../../Source/DistortionEngine.h"
+#include "../../Source/MakeupGain.h"
+
+/**
+    Measures the calibrated makeup-gain tables (gainTable and correlationTable in
+    MakeupGain.cpp).
+
+    Stereo pink noise (independent per channel, Paul Kellet's filter on white
+    noise) is scaled to levelDb RMS and run through the engine as the processor
+    runs it by default: L/R, the default oversampling, full mix (the gain goes
+    on the engine's output, before the brickwall limiter). After settleSeconds the input and output RMS are compared;
+    the makeup gain is their ratio in dB, the same correction the adaptive
+    auto-gain converges to on that signal. The output's correlation with the input
+    is what the dry signal adds up with at a lower mix.
+
+    Each setting is then run again at every one of mixes, and the gain measured
+    there is compared to the one MakeupGain predicts from the shipped tables.
+
+    One row per drive of MakeupGain's grid, one column per bias.
+*/
+class MakeupScan
+{
+public:
+  struct Settings
+  {
+    double sampleRate = 44100.0;
+    double seconds = 4.0;
+    double settleSeconds = 0.5;      // not measured
+    float levelDb = MakeupGain::referenceLevelDb;
+    int oversamplingFactor = 1;      // power of two, as DistortionEngine::prepare
+    int blockSize = 512;
+    juce::int64 seed = 1;
+
+    // Checked against the gain predicted for them (full mix is the table itself)
+    std::vector<float> mixes{ 0.75f, 0.5f, 0.25f };
+  };
+
+  struct Measurement
+  {
+    float gainDb = 0.0f;        // input RMS over output RMS
+    float correlation = 0.0f;   // of the output with the input
+  };
+
+  struct Row
+  {
+    float drive = 0.0f;
+    std::array<float, MakeupGain::numBiases> gainDb{};
+    std::array<float, MakeupGain::numBiases> correlation{};
+
+    // Worst difference of the shipped table to this row
+    float tableErrorDb = 0.0f;
+
+    // Worst difference of the gain predicted at settings.mixes to the measured one
+    float mixErrorDb = 0.0f;
+  };
+
+  // Makeup gain and correlation for one setting
+  static Measurement measure(const Settings& settings, const juce::AudioBuffer<float>& noise,
+                             float drive, float bias, float mix = 1.0f);
+
+  // Calibrated pink noise for measure()
+  static juce::AudioBuffer<float> makeNoise(const Settings& settings);
+
+  static std::vector<Row> scan(const Settings& settings, std::function<void(const Row&)> onRow = nullptr);
+
+  static juce::String getTableHeader();
+  static juce::String toTableRow(const Row& row);
+
+  // The rows as the gainTable and correlationTable initialisers in MakeupGain.cpp
+  static juce::String toSource(const std::vector<Row>& rows);
+  static juce::String toCorrelationSource(const std::vector<Row>& rows);
+};
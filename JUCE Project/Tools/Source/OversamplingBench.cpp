@@ -0,0 +1,113 @@
+// oversamplingBench.cpp
+
+#include "OversamplingBench.h"
+
+namespace
+{
+  constexpr int numChannels = 2;
+
+  using JuceOversampling = juce::dsp::Oversampling<float>;
+
+  // Runs the input through process(block) in host blocks; returns the ticks spent
+  template <typename Process>
+  juce::int64 runBlocks(const OversamplingBench::Settings& settings, const juce::AudioBuffer<float>& input, Process&& process)
+  {
+    juce::AudioBuffer<float> buffer(input);
+    const int numSamples = buffer.getNumSamples();
+    juce::int64 ticks = 0;
+
+    for (int start = 0; start < numSamples; start += settings.blockSize)
+    {
+      const int count = juce::jmin(settings.blockSize, numSamples - start);
+      float* channels[numChannels] = { buffer.getWritePointer(0, start), buffer.getWritePointer(1, start) };
+      juce::dsp::AudioBlock<float> block(channels, numChannels, (size_t)count);
+
+      const auto blockStart = juce::Time::getHighResolutionTicks();
+      process(block);
+      ticks += juce::Time::getHighResolutionTicks() - blockStart;
+    }
+
+    return ticks;
+  }
+
+  double toNanosecondsPerSample(juce::int64 ticks, int numSamples)
+  {
+    return juce::Time::highResolutionTicksToSeconds(ticks) * 1.0e9 / ((double)numSamples * numChannels);
+  }
+
+  OversamplingBench::Result measure(const OversamplingBench::Settings& settings, const juce::AudioBuffer<float>& input,
+    int factor, HalfBandOversampler::Phase phase)
+  {
+    OversamplingBench::Result result;
+    result.factor = factor;
+    result.phase = phase;
+
+    HalfBandOversampler oversampler;
+    oversampler.prepare(factor, (size_t)settings.blockSize, phase);
+    oversampler.reset();
+
+    const auto ticks = runBlocks(settings, input, [&oversampler](juce::dsp::AudioBlock<float>& block)
+    {
+      oversampler.processSamplesUp(block);
+      oversampler.processSamplesDown(block);
+    });
+
+    const auto filterType = phase == HalfBandOversampler::Phase::minimumPhase
+      ? JuceOversampling::filterHalfBandPolyphaseIIR
+      : JuceOversampling::filterHalfBandFIREquiripple;
+
+    JuceOversampling juceOversampler((size_t)numChannels, (size_t)factor, filterType, true);
+    juceOversampler.initProcessing((size_t)settings.blockSize);
+    juceOversampler.reset();
+
+    const auto juceTicks = runBlocks(settings, input, [&juceOversampler](juce::dsp::AudioBlock<float>& block)
+    {
+      juceOversampler.processSamplesUp(block);
+      juceOversampler.processSamplesDown(block);
+    });
+
+    result.nanosecondsPerSample = toNanosecondsPerSample(ticks, input.getNumSamples());
+    result.juceNanosecondsPerSample = toNanosecondsPerSample(juceTicks, input.getNumSamples());
+    result.speedup = result.juceNanosecondsPerSample / juce::jmax(1.0e-9, result.nanosecondsPerSample);
+    result.latency = oversampler.getLatencyInSamples();
+    result.juceLatency = juceOversampler.getLatencyInSamples();
+    return result;
+  }
+}
+
+std::vector<OversamplingBench::Result> OversamplingBench::run(const Settings& settings)
+{
+  juce::AudioBuffer<float> input(numChannels, juce::jmax(1, juce::roundToInt(settings.seconds * settings.sampleRate)));
+  juce::Random random(settings.seed);
+
+  for (int ch = 0; ch < numChannels; ++ch)
+    for (int i = 0; i < input.getNumSamples(); ++i)
+      input.setSample(ch, i, 0.5f * (random.nextFloat() * 2.0f - 1.0f));
+
+  std::vector<Result> results;
+
+  for (const auto phase : { HalfBandOversampler::Phase::minimumPhase, HalfBandOversampler::Phase::linearPhase })
+    for (int factor = 1; factor <= juce::jmin(settings.maxFactor, HalfBandOversampler::maxStages); ++factor)
+      results.push_back(measure(settings, input, factor, phase));
+
+  return results;
+}
+
+juce::String OversamplingBench::getTableHeader()
+{
+  return "phase    factor   ns/smp  juce ns/smp  speedup  latency  juce latency";
+}
+
+juce::String OversamplingBench::toTableRow(const Result& r)
+{
+  const auto column = [](const juce::String& text, int width) { return text.paddedLeft(' ', width); };
+  const bool minimumPhase = r.phase == HalfBandOversampler::Phase::minimumPhase;
+
+  return juce::String(minimumPhase ? "minimum" : "linear").paddedRight(' ', 7)
+    + column(juce::String(1 << r.factor) + "x", 8)
+    + column(juce::String(r.nanosecondsPerSample, 1), 9)
+    + column(juce::String(r.juceNanosecondsPerSample, 1), 13)
+    + column(juce::String(r.speedup, 2), 9)
+    + column(juce::String(r.latency, 1), 9)
+    + column(juce::String(r.juceLatency, 1), 14);
+}
@@ -0,0 +1,282 @@
+// qualityScan.cpp
+
+#include "QualityScan.h"
+
+namespace
+{
+  constexpr int blockSize = 512;
+
+  // Enough for the composite build many times over
+  constexpr int maxWarmUpBlocks = 1000;
+
+  // One test signal: settles for fftSize samples, measured over the next fftSize
+  struct Signal
+  {
+    juce::AudioBuffer<float> samples;
+    int sineBin = 0;                   // 0 for the multitone
+  };
+
+  int getOddBin(const QualityScan::Settings& settings, double frequency)
+  {
+    const int fftSize = 1 << settings.fftOrder;
+    return juce::jlimit(1, fftSize / 2 - 1, 2 * juce::roundToInt((frequency * fftSize / settings.sampleRate - 1.0) / 2.0) + 1);
+  }
+
+  std::vector<Signal> makeSignals(const QualityScan::Settings& settings)
+  {
+    const int fftSize = 1 << settings.fftOrder;
+    const double step = juce::MathConstants<double>::twoPi / (double)fftSize;
+    std::vector<Signal> signals;
+
+    for (const double frequency : settings.sineFrequencies)
+    {
+      const int bin = getOddBin(settings, frequency);
+      Signal signal{ juce::AudioBuffer<float>(1, 2 * fftSize), bin };
+
+      for (int i = 0; i < 2 * fftSize; ++i)
+        signal.samples.setSample(0, i, settings.sineLevel * (float)std::sin(step * bin * i));
+
+      signals.push_back(std::move(signal));
+    }
+
+    Signal multitone{ juce::AudioBuffer<float>(1, 2 * fftSize), 0 };
+
+    for (int i = 0; i < 2 * fftSize; ++i)
+    {
+      double sum = 0.0;
+
+      // Phases spread out, so the tones don't all peak together
+      for (size_t n = 0; n < settings.multitoneFrequencies.size(); ++n)
+        sum += std::sin(step * getOddBin(settings, settings.multitoneFrequencies[n]) * i + 2.0 * (double)n);
+
+      multitone.samples.setSample(0, i, settings.multitoneLevel * (float)sum);
+    }
+
+    signals.push_back(std::move(multitone));
+    return signals;
+  }
+
+  // Runs a signal through an engine set up for the configuration; returns the
+  // ticks spent on the measured half (from fftSize on)
+  juce::int64 process(const QualityScan::Settings& settings, const QualityScan::Config& config,
+    bool reference, float drive, juce::AudioBuffer<float>& buffer)
+  {
+    const int fftSize = 1 << settings.fftOrder;
+
+    DistortionEngine engine;
+    engine.setMultiRate(config.multiRate && !reference);
+    engine.setSmallSignalFastPath(config.path != QualityScan::Path::newton && !reference);
+    engine.setCompositeStages(config.path == QualityScan::Path::composite && !reference);
+    engine.setSolverLimits(config.solver.maxIterations, config.solver.tolerance);
+    engine.setPreciseSolve(reference);
+
+    engine.prepare({ settings.sampleRate, (juce::uint32)blockSize, 1 }, config.factor);
+    engine.reset();
+    engine.setDrive(drive);
+    engine.setBias(settings.bias);
+    engine.setMix(1.0f);
+
+    // The composite curve is built a slice per sub-block, with the separate
+    // stages running meanwhile: warm up until it is in use, then start over
+    if (!reference)
+    {
+      const bool composite = config.path == QualityScan::Path::composite;
+      juce::AudioBuffer<float> warmUp(1, blockSize);
+
+      for (int n = 0; n < maxWarmUpBlocks; ++n)
+      {
+        warmUp.copyFrom(0, 0, buffer, 0, 0, blockSize);
+        engine.processBlock((float)settings.sampleRate, warmUp);
+
+        if (!composite || engine.isUsingComposite())
+          break;
+      }
+
+      jassert(!composite || engine.isUsingComposite());
+      engine.reset();
+    }
+
+    juce::int64 ticks = 0;
+
+    for (int start = 0; start < buffer.getNumSamples(); start += blockSize)
+    {
+      float* channel = buffer.getWritePointer(0, start);
+      juce::AudioBuffer<float> block(&channel, 1, juce::jmin(blockSize, buffer.getNumSamples() - start));
+
+      const auto blockStart = juce::Time::getHighResolutionTicks();
+      engine.processBlock((float)settings.sampleRate, block);
+
+      if (start >= fftSize)
+        ticks += juce::Time::getHighResolutionTicks() - blockStart;
+    }
+
+    return ticks;
+  }
+
+  double toDb(double powerRatio)
+  {
+    return 10.0 * std::log10(juce::jmax(1.0e-20, powerRatio));
+  }
+
+  // Aliasing and THD+N of a sine's output, as power ratios to the fundamental
+  void measureSpectrum(const QualityScan::Settings& settings, const float* output, int sineBin,
+    double& aliasRatio, double& thdnRatio)
+  {
+    const int fftSize = 1 << settings.fftOrder;
+    juce::dsp::FFT fft(settings.fftOrder);
+    std::vector<float> data((size_t)fftSize * 2, 0.0f);
+    std::copy(output, output + fftSize, data.begin());
+    fft.performRealOnlyForwardTransform(data.data(), true);
+
+    const auto power = [&data](int bin) { return (double)data[(size_t)(2 * bin)] * data[(size_t)(2 * bin)]
+                                               + (double)data[(size_t)(2 * bin + 1)] * data[(size_t)(2 * bin + 1)]; };
+
+    const int lastBin = juce::jmin(fftSize / 2, (int)(settings.bandLimitHz * fftSize / settings.sampleRate));
+    double aliasPower = 0.0, otherPower = 0.0;
+
+    for (int bin = 1; bin <= lastBin; ++bin)
+    {
+      if (bin == sineBin)
+        continue;
+
+      otherPower += power(bin);
+
+      if (bin % sineBin != 0)
+        aliasPower += power(bin);
+    }
+
+    const double fundamental = juce::jmax(1.0e-30, power(sineBin));
+    aliasRatio = aliasPower / fundamental;
+    thdnRatio = otherPower / fundamental;
+  }
+
+  double getErrorRatio(const float* output, const float* reference, int numSamples)
+  {
+    double error = 0.0, signal = 0.0;
+
+    for (int i = 0; i < numSamples; ++i)
+    {
+      error += ((double)output[i] - reference[i]) * ((double)output[i] - reference[i]);
+      signal += (double)reference[i] * reference[i];
+    }
+
+    return error / juce::jmax(1.0e-30, signal);
+  }
+
+  const char* getPathName(QualityScan::Path path)
+  {
+    switch (path)
+    {
+      case QualityScan::Path::newton:    return "newton";
+      case QualityScan::Path::fastPath:  return "fast path";
+      case QualityScan::Path::composite: return "composite";
+    }
+
+    return "";
+  }
+
+  // Each one at least as good, one better
+  bool dominates(const QualityScan::Result& a, const QualityScan::Result& b)
+  {
+    const bool noWorse = a.nanosecondsPerSample <= b.nanosecondsPerSample && a.aliasDb <= b.aliasDb && a.errorDb <= b.errorDb;
+    const bool better = a.nanosecondsPerSample < b.nanosecondsPerSample || a.aliasDb < b.aliasDb || a.errorDb < b.errorDb;
+    return noWorse && better;
+  }
+}
+
+std::vector<QualityScan::Result> QualityScan::scan(const Settings& settings, std::function<void(const Result&)> onResult)
+{
+  const int fftSize = 1 << settings.fftOrder;
+  const auto signals = makeSignals(settings);
+  std::vector<Result> results;
+
+  for (int factor = 0; factor <= settings.maxFactor; ++factor)
+  {
+    // The reference outputs at this factor, per drive and signal
+    std::vector<juce::AudioBuffer<float>> references;
+
+    for (const float drive : settings.drives)
+    {
+      for (const auto& signal : signals)
+      {
+        references.push_back(signal.samples);
+        process(settings, { factor }, true, drive, references.back());
+      }
+    }
+
+    for (const bool multiRate : { true, false })
+    {
+      // Without oversampling there is only one rate
+      if (factor == 0 && multiRate)
+        continue;
+
+      for (const auto path : { Path::composite, Path::fastPath, Path::newton })
+      {
+        for (const auto& solver : settings.solvers)
+        {
+          Result result;
+          result.config = { factor, multiRate, path, solver };
+
+          juce::int64 ticks = 0;
+          size_t numSamples = 0;
+          size_t index = 0;
+
+          for (const float drive : settings.drives)
+          {
+            for (const auto& signal : signals)
+            {
+              juce::AudioBuffer<float> buffer(signal.samples);
+              ticks += process(settings, result.config, false, drive, buffer);
+              numSamples += (size_t)fftSize;
+
+              const float* output = buffer.getReadPointer(0, fftSize);
+              const float* reference = references[index++].getReadPointer(0, fftSize);
+              result.errorDb = juce::jmax(result.errorDb, toDb(getErrorRatio(output, reference, fftSize)));
+
+              if (signal.sineBin > 0)
+              {
+                double aliasRatio = 0.0, thdnRatio = 0.0;
+                measureSpectrum(settings, output, signal.sineBin, aliasRatio, thdnRatio);
+                result.aliasDb = juce::jmax(result.aliasDb, toDb(aliasRatio));
+                result.thdnDb = juce::jmax(result.thdnDb, toDb(thdnRatio));
+              }
+            }
+          }
+
+          result.nanosecondsPerSample = juce::Time::highResolutionTicksToSeconds(ticks) * 1.0e9 / (double)numSamples;
+          results.push_back(result);
+
+          if (onResult != nullptr)
+            onResult(result);
+        }
+      }
+    }
+  }
+
+  for (auto& result : results)
+    result.pareto = std::none_of(results.begin(), results.end(),
+      [&result](const Result& other) { return dominates(other, result); });
+
+  return results;
+}
+
+juce::String QualityScan::getTableHeader()
+{
+  return "factor  plan   path        iter      tol   ns/smp  aliasDb   thdnDb  errorDb  pareto";
+}
+
+juce::String QualityScan::toTableRow(const Result& r)
+{
+  const auto column = [](const juce::String& text, int width) { return text.paddedLeft(' ', width); };
+
+  return column(juce::String(1 << r.config.factor) + "x", 6)
+    + "  " + juce::String(r.config.multiRate ? "multi" : "full").paddedRight(' ', 6)
+    + " " + juce::String(getPathName(r.config.path)).paddedRight(' ', 10)
+    + column(juce::String(r.config.solver.maxIterations), 5)
+    + column("1e" + juce::String(juce::roundToInt(std::log10(r.config.solver.tolerance))), 9)
+    + column(juce::String(r.nanosecondsPerSample, 1), 9)
+    + column(juce::String(r.aliasDb, 1), 9)
+    + column(juce::String(r.thdnDb, 1), 9)
+    + column(juce::String(r.errorDb, 1), 9)
+    + (r.pareto ? "       *" : "");
+}
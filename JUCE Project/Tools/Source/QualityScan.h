@@ -0,0 +1,90 @@
+// qualityScan.h
+
+#pragma once
+
+#include <JuceHeader.h>
+#include "../../Source/DistortionEngine.h"
+
+/**
+    Measures what the engine's quality settings cost and what they buy, to pick
+    production defaults from.
+
+    Every configuration (oversampling factor, rate plan, stage path and Newton
+    limits) runs coherent sines and a multitone (exact FFT bins, mono, full mix)
+    at each drive. Per configuration, the worst case over drives and signals:
+
+    - aliasDb: everything in the audio band of a sine's output that is neither DC
+      nor a harmonic, relative to the fundamental (as in AliasScan);
+    - thdnDb: everything in the audio band but DC and the fundamental, relative
+      to the fundamental;
+    - errorDb: RMS difference to the reference at the same factor, relative to the
+      reference's RMS, over sines and the multitone. The reference runs every
+      stage at the full rate, no fast paths, every sample solved to convergence
+      in double precision (DistortionEngine::setPreciseSolve);
+    - time per sample, over the measured half of all of its runs. Each run
+      warms the engine up first, until the composite curve is in use where the
+      configuration has one, so the time is the steady state's.
+
+    A configuration is on the Pareto front if no other one is at least as good in
+    time, aliasing and error and better in one of them.
+*/
+class QualityScan
+{
+public:
+  // Which stages skip the Newton solve
+  enum class Path
+  {
+    newton,       // every sample solved
+    fastPath,     // small-signal expansions near the operating point
+    composite     // stages 1-4 as the composite curve, plus the fast path
+  };
+
+  struct Solver
+  {
+    int maxIterations;
+    float tolerance;
+  };
+
+  struct Settings
+  {
+    double sampleRate = 44100.0;
+    int fftOrder = 13;
+    int maxFactor = 3;                 // factors 2^0..2^maxFactor
+    double bandLimitHz = 20000.0;
+
+    // Moved to the nearest odd bin, so no harmonic lands on another's alias
+    std::vector<double> sineFrequencies{ 1000.0, 5000.0, 9000.0 };
+    float sineLevel = 0.5f;
+    std::vector<double> multitoneFrequencies{ 520.0, 1350.0, 3030.0, 6470.0 };
+    float multitoneLevel = 0.2f;       // per tone
+
+    std::vector<float> drives{ 0.5f, 1.0f };
+    float bias = 0.5f;
+
+    std::vector<Solver> solvers{ { 8, 1.0e-5f }, { 5, 1.0e-5f }, { 3, 1.0e-4f }, { 2, 1.0e-3f } };
+  };
+
+  struct Config
+  {
+    int factor = 0;                    // as for DistortionEngine::prepare
+    bool multiRate = true;
+    Path path = Path::composite;
+    Solver solver{ DistortionEngine::defaultSolverMaxIterations, DistortionEngine::defaultSolverTolerance };
+  };
+
+  struct Result
+  {
+    Config config;
+    double nanosecondsPerSample = 0.0;
+    double aliasDb = -200.0;
+    double thdnDb = -200.0;
+    double errorDb = -200.0;
+    bool pareto = false;
+  };
+
+  // Every configuration up to the settings' maxFactor, measured, Pareto front marked
+  static std::vector<Result> scan(const Settings& settings, std::function<void(const Result&)> onResult = nullptr);
+
+  static juce::String getTableHeader();
+  static juce::String toTableRow(const Result& result);
+};
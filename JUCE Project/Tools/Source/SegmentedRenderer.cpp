@@ -0,0 +1,421 @@
+// segmentedRenderer.cpp
+
+#include "SegmentedRenderer.h"
+#include "../../Source/MakeupGain.h"
+#include <deque>
+
+//==============================================================================
+class SegmentedRenderer::SegmentJob : public juce::ThreadPoolJob
+{
+public:
+  SegmentJob(const juce::AudioBuffer<float>& in, float* const* out, const Settings& s,
+    DistortionEngine::State initial, int preRoll, int segmentStart, int segmentEnd)
+    : juce::ThreadPoolJob("Eldur segment"), input(in), output(out), settings(s), initialState(std::move(initial)),
+      start(segmentStart - preRoll), outputStart(segmentStart), end(segmentEnd)
+  {
+  }
+
+  JobStatus runJob() override
+  {
+    auto engine = createEngine(settings, input.getNumChannels());
+    engine->restoreState(initialState);
+
+    process(*engine, input, output, start, outputStart, end, settings);
+    return jobHasFinished;
+  }
+
+private:
+  const juce::AudioBuffer<float>& input;
+  float* const* output;
+  const Settings& settings;
+  const DistortionEngine::State initialState;
+  const int start, outputStart, end;
+};
+
+//==============================================================================
+// A segment of a stream: reads its stretch (pre-roll and segment) and renders it
+// into buffers of its own
+class SegmentedRenderer::StreamSegmentJob : public juce::ThreadPoolJob
+{
+public:
+  StreamSegmentJob(juce::AudioFormatReader& r, juce::CriticalSection& lock, const Settings& s,
+    DistortionEngine::State initial, int preRollLength, juce::int64 segmentStart, int segmentLength)
+    : juce::ThreadPoolJob("Eldur stream segment"), preRoll(preRollLength), length(segmentLength),
+      input((int)r.numChannels, preRollLength + segmentLength), output((int)r.numChannels, preRollLength + segmentLength),
+      reader(r), readLock(lock), settings(s), initialState(std::move(initial)), readStart(segmentStart - preRollLength)
+  {
+  }
+
+  JobStatus runJob() override
+  {
+    // One reader for all the segments
+    {
+      const juce::ScopedLock lock(readLock);
+      reader.read(&input, 0, input.getNumSamples(), readStart, true, true);
+    }
+
+    auto engine = createEngine(settings, input.getNumChannels());
+    engine->restoreState(initialState);
+
+    process(*engine, input, output.getArrayOfWritePointers(), 0, preRoll, input.getNumSamples(), settings);
+    return jobHasFinished;
+  }
+
+  // The segment starts at preRoll in both
+  const int preRoll, length;
+  juce::AudioBuffer<float> input, output;
+
+private:
+  juce::AudioFormatReader& reader;
+  juce::CriticalSection& readLock;
+  const Settings& settings;
+  const DistortionEngine::State initialState;
+  const juce::int64 readStart;
+};
+
+//==============================================================================
+int SegmentedRenderer::getBlockSize(const Settings& settings)
+{
+  const int subBlock = DistortionEngine::subBlockSize;
+  return juce::jmax(1, (settings.blockSize + subBlock - 1) / subBlock) * subBlock;
+}
+
+int SegmentedRenderer::getSegmentLength(const Settings& settings)
+{
+  const int blockSize = getBlockSize(settings);
+  return juce::jmax(1, (int)std::ceil(settings.segmentSeconds * settings.sampleRate / blockSize)) * blockSize;
+}
+
+int SegmentedRenderer::getPreRollLength(const Settings& settings)
+{
+  // The cabinet's tail has to have gone through before the segment starts
+  double seconds = settings.preRollSeconds;
+  if (settings.cabinet != nullptr)
+    seconds += settings.cabinet->samples.getNumSamples() / settings.cabinet->sampleRate;
+
+  const int blockSize = getBlockSize(settings);
+  return (int)std::ceil(seconds * settings.sampleRate / blockSize) * blockSize;
+}
+
+std::unique_ptr<DistortionEngine> SegmentedRenderer::createEngine(const Settings& settings, int numChannels)
+{
+  auto engine = std::make_unique<DistortionEngine>();
+
+  juce::dsp::ProcessSpec spec;
+  spec.sampleRate = settings.sampleRate;
+  spec.maximumBlockSize = (juce::uint32)getBlockSize(settings);
+  spec.numChannels = (juce::uint32)juce::jmax(1, numChannels);
+
+  engine->setMultiRate(settings.multiRate);
+  engine->setSmallSignalFastPath(settings.smallSignalFastPath);
+  engine->setCompositeStages(settings.compositeStages);
+  engine->setDriftSeed(settings.driftSeed);
+  engine->setCabinet(settings.cabinet);
+  engine->setLowBand(settings.lowBand);
+  engine->prepare(spec, settings.oversamplingFactor, settings.phase);
+  engine->reset();
+
+  engine->setDrive(settings.drive);
+  engine->setBias(settings.bias);
+  engine->setMix(settings.mix);
+  engine->setMidSide(settings.midSide);
+  engine->setSideEconomy(settings.sideEconomy);
+  engine->setDrift(settings.drift);
+  return engine;
+}
+
+void SegmentedRenderer::process(DistortionEngine& engine, const juce::AudioBuffer<float>& input,
+  float* const* output, int start, int outputStart, int end, const Settings& settings)
+{
+  const int numChannels = input.getNumChannels();
+  const int blockSize = getBlockSize(settings);
+  juce::AudioBuffer<float> scratch(numChannels, blockSize);
+
+  const float gain = settings.makeupGain
+    ? juce::Decibels::decibelsToGain(MakeupGain::getGainDb(settings.drive, settings.bias, settings.mix))
+    : 1.0f;
+
+  for (int pos = start; pos < end; pos += blockSize)
+  {
+    const int numSamples = juce::jmin(blockSize, end - pos);
+    juce::AudioBuffer<float> block(scratch.getArrayOfWritePointers(), numChannels, numSamples);
+
+    for (int ch = 0; ch < numChannels; ++ch)
+      block.copyFrom(ch, 0, input, ch, pos, numSamples);
+
+    engine.processBlock((float)settings.sampleRate, block);
+    block.applyGain(gain);
+
+    // Pre-roll output is discarded
+    if (pos >= outputStart)
+      for (int ch = 0; ch < numChannels; ++ch)
+        juce::FloatVectorOperations::copy(output[ch] + pos, block.getReadPointer(ch), numSamples);
+  }
+}
+
+//==============================================================================
+void SegmentedRenderer::renderSerial(const juce::AudioBuffer<float>& input, juce::AudioBuffer<float>& output,
+  const Settings& settings)
+{
+  output.setSize(input.getNumChannels(), input.getNumSamples(), false, false, true);
+
+  auto engine = createEngine(settings, input.getNumChannels());
+  process(*engine, input, output.getArrayOfWritePointers(), 0, 0, input.getNumSamples(), settings);
+}
+
+SegmentedRenderer::Result SegmentedRenderer::render(const juce::AudioBuffer<float>& input,
+  juce::AudioBuffer<float>& output, const Settings& settings)
+{
+  Result result;
+  const auto startTime = juce::Time::getMillisecondCounterHiRes();
+
+  const int numSamples = input.getNumSamples();
+  output.setSize(input.getNumChannels(), numSamples, false, false, true);
+
+  const int segmentLength = getSegmentLength(settings);
+  const int preRollLength = getPreRollLength(settings);
+
+  const int numSegments = (numSamples + segmentLength - 1) / segmentLength;
+  const int numThreads = settings.numThreads > 0 ? settings.numThreads : juce::SystemStats::getNumCpus();
+  juce::ThreadPool pool(juce::jmax(1, juce::jmin(numThreads, numSegments)));
+
+  // Every segment engine starts from the serial engine's controls at its
+  // pre-roll, walked along by one engine that processes no audio
+  auto timeline = createEngine(settings, input.getNumChannels());
+  int timelinePosition = 0;
+
+  float* const* outputChannels = output.getArrayOfWritePointers();
+
+  std::vector<std::unique_ptr<SegmentJob>> jobs;
+  for (int segmentStart = 0; segmentStart < numSamples; segmentStart += segmentLength)
+  {
+    const int preRoll = juce::jmin(preRollLength, segmentStart);
+    timeline->advanceControl(segmentStart - preRoll - timelinePosition);
+    timelinePosition = segmentStart - preRoll;
+
+    DistortionEngine::State initialState;
+    timeline->saveState(initialState);
+
+    jobs.push_back(std::make_unique<SegmentJob>(input, outputChannels, settings, std::move(initialState), preRoll,
+      segmentStart, juce::jmin(numSamples, segmentStart + segmentLength)));
+    pool.addJob(jobs.back().get(), false);
+  }
+
+  for (auto& job : jobs)
+    pool.waitForJobToFinish(job.get(), -1);
+
+  result.numSegments = (int)jobs.size();
+  result.renderSeconds = (juce::Time::getMillisecondCounterHiRes() - startTime) * 0.001;
+  return result;
+}
+
+float SegmentedRenderer::getMaxDifference(const juce::AudioBuffer<float>& a, const juce::AudioBuffer<float>& b)
+{
+  float maxDifference = 0.0f;
+
+  for (int ch = 0; ch < a.getNumChannels(); ++ch)
+  {
+    const float* dataA = a.getReadPointer(ch);
+    const float* dataB = b.getReadPointer(ch);
+
+    for (int i = 0; i < a.getNumSamples(); ++i)
+      maxDifference = juce::jmax(maxDifference, std::abs(dataA[i] - dataB[i]));
+  }
+
+  return maxDifference;
+}
+
+SegmentedRenderer::Result SegmentedRenderer::renderAndVerify(const juce::AudioBuffer<float>& input,
+  juce::AudioBuffer<float>& output, const Settings& settings)
+{
+  auto result = render(input, output, settings);
+
+  const auto startTime = juce::Time::getMillisecondCounterHiRes();
+  juce::AudioBuffer<float> reference;
+  renderSerial(input, reference, settings);
+  result.serialSeconds = (juce::Time::getMillisecondCounterHiRes() - startTime) * 0.001;
+
+  // Rounding floor: the same serial render with every input sample one ulp up
+  juce::AudioBuffer<float> nudgedInput(input);
+  for (int ch = 0; ch < nudgedInput.getNumChannels(); ++ch)
+  {
+    float* data = nudgedInput.getWritePointer(ch);
+    for (int i = 0; i < nudgedInput.getNumSamples(); ++i)
+      data[i] = std::nextafter(data[i], 2.0f);
+  }
+
+  juce::AudioBuffer<float> nudged;
+  renderSerial(nudgedInput, nudged, settings);
+
+  result.verified = true;
+  result.maxDifferenceDb = juce::Decibels::gainToDecibels(getMaxDifference(output, reference), -200.0f);
+  result.roundingFloorDb = juce::Decibels::gainToDecibels(getMaxDifference(nudged, reference), -200.0f);
+  result.matchesSerial = result.maxDifferenceDb <= result.roundingFloorDb + 6.0f;
+  return result;
+}
+
+SegmentedRenderer::Result SegmentedRenderer::renderFile(const juce::File& inputFile, const juce::File& outputFile,
+  Settings settings, bool verify)
+{
+  juce::AudioFormatManager formatManager;
+  formatManager.registerBasicFormats();
+
+  std::unique_ptr<juce::AudioFormatReader> reader(formatManager.createReaderFor(inputFile));
+  if (reader == nullptr)
+    return {};
+
+  settings.sampleRate = reader->sampleRate;
+
+  outputFile.deleteFile();
+  auto stream = std::make_unique<juce::FileOutputStream>(outputFile);
+  if (stream->failedToOpen())
+    return {};
+
+  juce::WavAudioFormat wav;
+  std::unique_ptr<juce::AudioFormatWriter> writer(wav.createWriterFor(stream.get(), settings.sampleRate,
+    reader->numChannels, 32, {}, 0));
+
+  if (writer == nullptr)
+    return {};
+
+  // The writer owns the stream now
+  stream.release();
+  return renderStream(*reader, *writer, settings, verify);
+}
+
+SegmentedRenderer::Result SegmentedRenderer::renderStream(juce::AudioFormatReader& reader,
+  juce::AudioFormatWriter& writer, const Settings& settings, bool verify)
+{
+  Result result;
+  const auto startTime = juce::Time::getMillisecondCounterHiRes();
+  double verifySeconds = 0.0;
+
+  const int numChannels = juce::jmax(1, (int)reader.numChannels);
+  const juce::int64 numSamples = reader.lengthInSamples;
+  const int segmentLength = getSegmentLength(settings);
+  const int preRollLength = getPreRollLength(settings);
+
+  // Segment engines start from the controls of a timeline engine, as in render()
+  auto timeline = createEngine(settings, numChannels);
+  juce::int64 timelinePosition = 0;
+
+  const int numThreads = settings.numThreads > 0 ? settings.numThreads : juce::SystemStats::getNumCpus();
+  juce::ThreadPool pool(juce::jmax(1, numThreads));
+  juce::CriticalSection readLock;
+
+  // Enough queued that no thread waits for the writer, few enough to bound the memory
+  const size_t maxQueued = (size_t)juce::jmax(1, numThreads) * 2;
+  std::deque<std::unique_ptr<StreamSegmentJob>> queued;
+  juce::int64 nextStart = 0;
+
+  const auto queueSegment = [&]
+  {
+    const int preRoll = (int)juce::jmin((juce::int64)preRollLength, nextStart);
+    const int length = (int)juce::jmin((juce::int64)segmentLength, numSamples - nextStart);
+
+    timeline->advanceControl(nextStart - preRoll - timelinePosition);
+    timelinePosition = nextStart - preRoll;
+
+    DistortionEngine::State initialState;
+    timeline->saveState(initialState);
+
+    queued.push_back(std::make_unique<StreamSegmentJob>(reader, readLock, settings, std::move(initialState), preRoll, nextStart, length));
+    pool.addJob(queued.back().get(), false);
+    nextStart += length;
+  };
+
+  // Verification: the serial render and the one of the nudged input (see
+  // renderAndVerify), carried on across segments
+  std::unique_ptr<DistortionEngine> serial, nudgedSerial;
+  juce::AudioBuffer<float> reference, nudgedInput, nudged;
+  float maxDifference = 0.0f, roundingFloor = 0.0f;
+
+  if (verify)
+  {
+    serial = createEngine(settings, numChannels);
+    nudgedSerial = createEngine(settings, numChannels);
+  }
+
+  while (nextStart < numSamples || !queued.empty())
+  {
+    while (nextStart < numSamples && queued.size() < maxQueued)
+      queueSegment();
+
+    const auto job = std::move(queued.front());
+    queued.pop_front();
+    pool.waitForJobToFinish(job.get(), -1);
+
+    writer.writeFromAudioSampleBuffer(job->output, job->preRoll, job->length);
+    ++result.numSegments;
+
+    if (!verify)
+      continue;
+
+    // On the render block grid: segments start on it
+    const auto verifyStart = juce::Time::getMillisecondCounterHiRes();
+    const int end = job->preRoll + job->length;
+
+    reference.setSize(numChannels, end, false, false, true);
+    process(*serial, job->input, reference.getArrayOfWritePointers(), job->preRoll, job->preRoll, end, settings);
+    result.serialSeconds += (juce::Time::getMillisecondCounterHiRes() - verifyStart) * 0.001;
+
+    nudgedInput.makeCopyOf(job->input, true);
+    nudged.setSize(numChannels, end, false, false, true);
+
+    for (int ch = 0; ch < numChannels; ++ch)
+    {
+      float* data = nudgedInput.getWritePointer(ch);
+      for (int i = job->preRoll; i < end; ++i)
+        data[i] = std::nextafter(data[i], 2.0f);
+    }
+
+    process(*nudgedSerial, nudgedInput, nudged.getArrayOfWritePointers(), job->preRoll, job->preRoll, end, settings);
+
+    for (int ch = 0; ch < numChannels; ++ch)
+    {
+      const float* out = job->output.getReadPointer(ch);
+      const float* ref = reference.getReadPointer(ch);
+      const float* nudge = nudged.getReadPointer(ch);
+
+      for (int i = job->preRoll; i < end; ++i)
+      {
+        maxDifference = juce::jmax(maxDifference, std::abs(out[i] - ref[i]));
+        roundingFloor = juce::jmax(roundingFloor, std::abs(nudge[i] - ref[i]));
+      }
+    }
+
+    verifySeconds += (juce::Time::getMillisecondCounterHiRes() - verifyStart) * 0.001;
+  }
+
+  result.renderSeconds = (juce::Time::getMillisecondCounterHiRes() - startTime) * 0.001 - verifySeconds;
+
+  if (verify)
+  {
+    result.verified = true;
+    result.maxDifferenceDb = juce::Decibels::gainToDecibels(maxDifference, -200.0f);
+    result.roundingFloorDb = juce::Decibels::gainToDecibels(roundingFloor, -200.0f);
+    result.matchesSerial = result.maxDifferenceDb <= result.roundingFloorDb + 6.0f;
+  }
+
+  return result;
+}
+
+//==============================================================================
+juce::String SegmentedRenderer::getTableHeader()
+{
+  return "segments  render s  serial s  speedup  max diff dB  floor dB  matches";
+}
+
+juce::String SegmentedRenderer::toTableRow(const Result& r)
+{
+  const auto column = [](const juce::String& text, int width) { return text.paddedLeft(' ', width); };
+  const double speedup = r.renderSeconds > 0.0 ? r.serialSeconds / r.renderSeconds : 0.0;
+
+  return column(juce::String(r.numSegments), 8)
+    + column(juce::String(r.renderSeconds, 2), 10)
+    + column(r.verified ? juce::String(r.serialSeconds, 2) : juce::String("-"), 10)
+    + column(r.verified ? juce::String(speedup, 1) : juce::String("-"), 9)
+    + column(r.verified ? juce::String(r.maxDifferenceDb, 1) : juce::String("-"), 13)
+    + column(r.verified ? juce::String(r.roundingFloorDb, 1) : juce::String("-"), 10)
+    + column(r.verified ? juce::String(r.matchesSerial ? "yes" : "no") : juce::String("-"), 9);
+}
@@ -0,0 +1,119 @@
+// segmentedRenderer.h
+
+#pragma once
+
+#include <JuceHeader.h>
+#include "../../Source/DistortionEngine.h"
+
+/**
+    Offline rendering of one long signal on several cores.
+
+    The signal is cut into segments that are rendered in parallel, each by its own
+    DistortionEngine. Every segment engine starts from the state a serial engine's
+    controls (stage table, drift, composite curves, small-signal expansions) have
+    at the start of its pre-roll: one engine walks the timeline with
+    advanceControl() and a snapshot is taken per segment. The segment engine then
+    runs over the pre-roll and throws that output away, so its filter, oversampler
+    and cabinet state has converged by the time the segment starts. The pre-roll
+    is at least the cabinet impulse long.
+
+    Segment starts and pre-roll stay on the render block grid: the Newton solve
+    restarts per sub-block, so the output depends on where blocks start.
+
+    Bit-identical output is not reachable: converged filter state still differs by
+    rounding, and the triode stages have a lot of small-signal gain. Verification
+    therefore also measures the rounding floor, i.e. how far a serial render moves
+    when every input sample is nudged by one ulp, and compares against that.
+*/
+class SegmentedRenderer
+{
+public:
+  struct Settings
+  {
+    double sampleRate = 48000.0;
+
+    // The engine's config, as EngineSwitcher::Config
+    int oversamplingFactor = 1;
+    HalfBandOversampler::Phase phase = HalfBandOversampler::Phase::minimumPhase;
+    bool multiRate = true;
+    std::shared_ptr<const CabinetImpulse> cabinet;
+    DistortionEngine::LowBand lowBand;
+
+    // Stage paths, as DistortionEngine's defaults
+    bool smallSignalFastPath = true;
+    bool compositeStages = true;
+
+    float drive = 0.2f;
+    float bias = 0.5f;
+    float mix = 1.0f;
+    bool midSide = false;
+    bool sideEconomy = false;
+    float drift = 0.0f;
+    juce::uint32 driftSeed = 1;
+
+    // The calibrated makeup gain (MakeupGain) on the engine's output, as the
+    // processor's non-adaptive auto-gain applies it; no brickwall limiter
+    bool makeupGain = false;
+
+    int blockSize = 512;            // rounded up to whole engine sub-blocks
+    double segmentSeconds = 10.0;
+    double preRollSeconds = 0.5;
+    int numThreads = 0;             // 0: one per core
+  };
+
+  struct Result
+  {
+    int numSegments = 0;
+    double renderSeconds = 0.0;     // wall clock of the parallel render
+    double serialSeconds = 0.0;     // wall clock of the serial render, when verifying
+    bool verified = false;
+    float maxDifferenceDb = -200.0f; // largest |parallel - serial|, dBFS
+    float roundingFloorDb = -200.0f; // largest |serial - serial of 1-ulp nudged input|, dBFS
+    bool matchesSerial = false;      // within the rounding floor (plus a 6 dB margin)
+  };
+
+  // Renders input into output (resized to match). The oversampler latency is left
+  // in, as in a serial render through the plugin.
+  static Result render(const juce::AudioBuffer<float>& input, juce::AudioBuffer<float>& output,
+    const Settings& settings);
+
+  // One engine, start to end: the reference the segmented render is checked against
+  static void renderSerial(const juce::AudioBuffer<float>& input, juce::AudioBuffer<float>& output,
+    const Settings& settings);
+
+  // Parallel render, then a serial one and the rounding floor (two more serial renders)
+  static Result renderAndVerify(const juce::AudioBuffer<float>& input, juce::AudioBuffer<float>& output,
+    const Settings& settings);
+
+  // Renders a file into a 32-bit float WAV. The sample rate comes from the file.
+  // Returns an empty result if the file can't be read or written.
+  static Result renderFile(const juce::File& inputFile, const juce::File& outputFile,
+    Settings settings, bool verify);
+
+  // The same for any reader and writer (at settings.sampleRate). Segments are read
+  // as they are queued and written in order as they finish, with at most two per
+  // thread in memory, so the length of the input doesn't matter. Verification runs
+  // the serial and nudged renders alongside, one segment at a time.
+  static Result renderStream(juce::AudioFormatReader& reader, juce::AudioFormatWriter& writer,
+    const Settings& settings, bool verify);
+
+  static juce::String getTableHeader();
+  static juce::String toTableRow(const Result& result);
+
+private:
+  class SegmentJob;
+  class StreamSegmentJob;
+
+  static int getBlockSize(const Settings& settings);
+
+  // Segment length and pre-roll, in whole render blocks
+  static int getSegmentLength(const Settings& settings);
+  static int getPreRollLength(const Settings& settings);
+  static float getMaxDifference(const juce::AudioBuffer<float>& a, const juce::AudioBuffer<float>& b);
+  static std::unique_ptr<DistortionEngine> createEngine(const Settings& settings, int numChannels);
+
+  // Runs an engine over [start, end), writing output only from outputStart on.
+  // Raw output pointers: segments write disjoint ranges from several threads.
+  static void process(DistortionEngine& engine, const juce::AudioBuffer<float>& input,
+    float* const* output, int start, int outputStart, int end, const Settings& settings);
+};
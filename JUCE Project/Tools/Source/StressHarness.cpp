@@ -0,0 +1,300 @@
+// stressHarness.cpp
+
+#include "StressHarness.h"
+#include "../../Source/PluginProcessor.h"
+#include "../../Source/RealtimeSanitizer.h"
+
+namespace
+{
+  const double sampleRates[] = { 44100.0, 48000.0, 88200.0, 96000.0 };
+  const int periods[] = { 32, 64, 128, 256, 512, 1024, 2048 };
+
+  double ticksToMicroseconds(juce::int64 ticks)
+  {
+    return juce::Time::highResolutionTicksToSeconds(ticks) * 1.0e6;
+  }
+
+  double getPercentile(const std::vector<juce::int64>& sortedTicks, double fraction)
+  {
+    if (sortedTicks.empty())
+      return 0.0;
+
+    const auto index = juce::jmin(sortedTicks.size() - 1, (size_t)(fraction * (double)sortedTicks.size()));
+    return ticksToMicroseconds(sortedTicks[index]);
+  }
+}
+
+//==============================================================================
+class StressHarness::HostThread : public juce::Thread
+{
+public:
+  HostThread(const Settings& s, int index)
+    : juce::Thread("Eldur host " + juce::String(index)), settings(s), random(s.seed + index)
+  {
+  }
+
+  void addInstance(std::unique_ptr<ImperialTriodeOverlordAudioProcessor> processor)
+  {
+    instances.push_back({ std::move(processor) });
+  }
+
+  void run() override
+  {
+    // Roughly one entry per processBlock call, so recording stays out of the way
+    blockTicks.reserve((size_t)(settings.seconds * 48000.0 / 128.0) * instances.size() * 2);
+
+    choosePeriod();
+    prepareAll();
+
+    double audioTime = 0.0;
+    double nextPrepareTime = settings.reprepareSeconds;
+
+    while (audioTime < settings.seconds && !threadShouldExit())
+    {
+      if (settings.reprepare && audioTime >= nextPrepareTime)
+      {
+        choosePeriod();
+        prepareAll();
+        nextPrepareTime += settings.reprepareSeconds;
+      }
+
+      const juce::int64 cycleTicks = runCycle();
+      const double periodSeconds = (double)period / sampleRate;
+
+      ++numCycles;
+      busySeconds += juce::Time::highResolutionTicksToSeconds(cycleTicks);
+      if (juce::Time::highResolutionTicksToSeconds(cycleTicks) > periodSeconds)
+        ++numMisses;
+
+      audioTime += periodSeconds;
+    }
+
+    simulatedSeconds = audioTime;
+  }
+
+  std::vector<juce::int64> blockTicks;
+  juce::int64 numCycles = 0, numMisses = 0;
+  double busySeconds = 0.0, simulatedSeconds = 0.0;
+  int numPrepares = 0;
+  double maxPrepareMs = 0.0;
+  std::vector<double> firstAudioMs;
+
+private:
+  struct Instance
+  {
+    std::unique_ptr<ImperialTriodeOverlordAudioProcessor> processor;
+    float drive = 0.6f, bias = 0.5f, mix = 1.0f;
+    bool awaitingFirstAudio = false;
+  };
+
+  void choosePeriod()
+  {
+    sampleRate = sampleRates[random.nextInt((int)std::size(sampleRates))];
+
+    do
+      period = periods[random.nextInt((int)std::size(periods))];
+    while (period > settings.maxPeriod);
+
+    input.setSize(2, period);
+    work.setSize(2, period);
+  }
+
+  void prepareAll()
+  {
+    for (auto& instance : instances)
+    {
+      const auto start = juce::Time::getMillisecondCounterHiRes();
+
+      instance.processor->releaseResources();
+      instance.processor->setRateAndBufferSizeDetails(sampleRate, period);
+      instance.processor->prepareToPlay(sampleRate, period);
+
+      maxPrepareMs = juce::jmax(maxPrepareMs, juce::Time::getMillisecondCounterHiRes() - start);
+      ++numPrepares;
+      instance.awaitingFirstAudio = true;
+    }
+  }
+
+  void setParameter(ImperialTriodeOverlordAudioProcessor& processor, const char* id, float value)
+  {
+    // Hosts deliver automation on the audio thread through the base class
+    if (auto* parameter = processor.getValueTreeState().getParameter(id))
+      static_cast<juce::AudioProcessorParameter*>(parameter)->setValue(parameter->convertTo0to1(value));
+  }
+
+  void automate(Instance& instance)
+  {
+    const auto walk = [this](float value, float lo, float hi, float step)
+    {
+      return juce::jlimit(lo, hi, value + (random.nextFloat() * 2.0f - 1.0f) * step);
+    };
+
+    instance.drive = walk(instance.drive, 0.25f, 1.0f, 0.02f);
+    instance.bias = walk(instance.bias, 0.0f, 2.0f, 0.04f);
+    instance.mix = walk(instance.mix, 0.0f, 1.0f, 0.02f);
+
+    setParameter(*instance.processor, "drive", instance.drive);
+    setParameter(*instance.processor, "bias", instance.bias);
+    setParameter(*instance.processor, "mix", instance.mix);
+  }
+
+  void fillInput()
+  {
+    for (int ch = 0; ch < 2; ++ch)
+    {
+      float* data = input.getWritePointer(ch);
+      for (int i = 0; i < period; ++i)
+      {
+        data[i] = 0.4f * std::sin(phase + 0.3f * (float)ch) + 0.02f * (random.nextFloat() - 0.5f);
+        phase += 0.0314f;
+      }
+    }
+
+    phase = std::fmod(phase, juce::MathConstants<float>::twoPi);
+  }
+
+  juce::int64 runCycle()
+  {
+    fillInput();
+    juce::int64 cycleTicks = 0;
+
+    for (auto& instance : instances)
+    {
+      auto& processor = *instance.processor;
+      work.makeCopyOf(input, true);
+
+      if (settings.toggleBypass && random.nextInt(200) == 0)
+        processor.setBypass(!processor.getBypass());
+
+      for (int position = 0; position < period;)
+      {
+        // Most periods arrive whole, the rest are split at random points
+        int numSamples = period - position;
+        if (settings.randomBlocks && random.nextInt(4) == 0)
+          numSamples = 1 + random.nextInt(numSamples);
+
+        if (settings.automate)
+          automate(instance);
+
+        juce::AudioBuffer<float> block(work.getArrayOfWritePointers(), 2, position, numSamples);
+
+        const auto start = juce::Time::getHighResolutionTicks();
+        processor.processBlock(block, midi);
+        const auto ticks = juce::Time::getHighResolutionTicks() - start;
+
+        blockTicks.push_back(ticks);
+        cycleTicks += ticks;
+        position += numSamples;
+      }
+
+      if (instance.awaitingFirstAudio && processor.getTimeToFirstAudio() >= 0.0)
+      {
+        firstAudioMs.push_back(processor.getTimeToFirstAudio() * 1000.0);
+        instance.awaitingFirstAudio = false;
+      }
+    }
+
+    return cycleTicks;
+  }
+
+  const Settings& settings;
+  juce::Random random;
+  std::vector<Instance> instances;
+
+  double sampleRate = 48000.0;
+  int period = 512;
+  float phase = 0.0f;
+
+  juce::AudioBuffer<float> input, work;
+  juce::MidiBuffer midi;
+};
+
+//==============================================================================
+StressHarness::Result StressHarness::run(const Settings& settings)
+{
+  const int numThreads = juce::jmax(1, settings.numThreads);
+  RealtimeSanitizer::clear();
+
+  std::vector<std::unique_ptr<HostThread>> threads;
+  for (int t = 0; t < numThreads; ++t)
+    threads.push_back(std::make_unique<HostThread>(settings, t));
+
+  // Instances are created here, on the "message thread", and dealt out round-robin
+  for (int i = 0; i < settings.numInstances; ++i)
+    threads[(size_t)(i % numThreads)]->addInstance(std::make_unique<ImperialTriodeOverlordAudioProcessor>());
+
+  for (auto& thread : threads)
+    thread->startThread();
+
+  for (auto& thread : threads)
+    thread->waitForThreadToExit(-1);
+
+  Result result;
+  result.numInstances = settings.numInstances;
+  result.numThreads = numThreads;
+
+  std::vector<juce::int64> allTicks;
+  std::vector<double> firstAudioMs;
+  double busySeconds = 0.0, simulatedSeconds = 0.0;
+
+  for (auto& thread : threads)
+  {
+    allTicks.insert(allTicks.end(), thread->blockTicks.begin(), thread->blockTicks.end());
+    result.numCycles += thread->numCycles;
+    result.numMisses += thread->numMisses;
+    result.numPrepares += thread->numPrepares;
+    result.maxPrepareMs = juce::jmax(result.maxPrepareMs, thread->maxPrepareMs);
+    firstAudioMs.insert(firstAudioMs.end(), thread->firstAudioMs.begin(), thread->firstAudioMs.end());
+    busySeconds += thread->busySeconds;
+    simulatedSeconds += thread->simulatedSeconds;
+  }
+
+  std::sort(allTicks.begin(), allTicks.end());
+
+  result.numBlocks = (juce::int64)allTicks.size();
+  result.missRate = result.numCycles > 0 ? (double)result.numMisses / (double)result.numCycles : 0.0;
+  result.p50 = getPercentile(allTicks, 0.5);
+  result.p99 = getPercentile(allTicks, 0.99);
+  result.p999 = getPercentile(allTicks, 0.999);
+  result.max = allTicks.empty() ? 0.0 : ticksToMicroseconds(allTicks.back());
+  result.load = simulatedSeconds > 0.0 ? busySeconds / simulatedSeconds : 0.0;
+
+  std::sort(firstAudioMs.begin(), firstAudioMs.end());
+
+  if (!firstAudioMs.empty())
+  {
+    result.firstAudioP50Ms = firstAudioMs[firstAudioMs.size() / 2];
+    result.maxFirstAudioMs = firstAudioMs.back();
+  }
+
+  if (RealtimeSanitizer::isEnabled())
+    result.numViolations = RealtimeSanitizer::getNumViolations();
+
+  return result;
+}
+
+juce::String StressHarness::getTableHeader()
+{
+  return "instances threads   blocks   cycles  miss%   p50us   p99us  p999us   maxus  load/thread  prepares  maxPrepMs  p50FirstMs  maxFirstMs  rtViolations";
+}
+
+juce::String StressHarness::toTableRow(const Result& r)
+{
+  const auto column = [](const juce::String& text, int width) { return text.paddedLeft(' ', width); };
+
+  return column(juce::String(r.numInstances), 9)
+    + column(juce::String(r.numThreads), 8)
+    + column(juce::String(r.numBlocks), 9)
+    + column(juce::String(r.numCycles), 9)
+    + column(juce::String(r.missRate * 100.0, 2), 7)
+    + column(juce::String(r.p50, 1), 8)
+    + column(juce::String(r.p99, 1), 8)
+    + column(juce::String(r.p999, 1), 8)
+    + column(juce::String(r.max, 1), 8)
+    + column(juce::String(r.load, 3), 13)
+    + column(juce::String(r.numPrepares), 10)
+    + column(juce::String(r.maxPrepareMs, 2), 11)
+    + column(juce::String(r.firstAudioP50Ms, 2), 12)
+    + column(juce::String(r.maxFirstAudioMs, 2), 12)
+    + column(r.numViolations < 0 ? juce::String("off") : juce::String(r.numViolations), 14);
+}
@@ -0,0 +1,79 @@
+// stressHarness.h
+
+#pragma once
+
+#include <JuceHeader.h>
+
+/**
+    Headless multi-instance host simulation.
+
+    Creates N ImperialTriodeOverlordAudioProcessor instances (no editor) and spreads
+    them over T simulated host threads. Every thread runs host cycles as fast as it
+    can: one period of audio for each of its instances, split into random
+    sub-blocks the way hosts split blocks around automation points, with parameter
+    automation, bypass toggling and occasional prepareToPlay re-calls at a new
+    sample rate and period.
+
+    A cycle misses its deadline when a thread needs longer than the period's audio
+    duration to process all of its instances. Block times are wall clock around
+    processBlock only; input generation and prepareToPlay are not counted.
+    prepareToPlay only starts the engine build, so the time from it to the first
+    block through the new engine (time to first audio) is reported per instance
+    and prepare.
+
+    In ELDUR_RT_SANITIZER builds every processBlock call is also checked for
+    allocations, locks and blocking calls (see RealtimeSanitizer), which are
+    counted in the result.
+*/
+class StressHarness
+{
+public:
+  struct Settings
+  {
+    int numInstances = 16;
+    int numThreads = 2;
+    double seconds = 10.0;          // simulated audio per thread
+    int maxPeriod = 1024;           // largest host period, in samples
+    bool randomBlocks = true;       // split periods into random sub-blocks
+    bool automate = true;           // random-walk drive/bias/mix
+    bool toggleBypass = true;
+    bool reprepare = true;          // prepareToPlay again every few seconds
+    double reprepareSeconds = 2.0;
+    juce::int64 seed = 1;
+  };
+
+  struct Result
+  {
+    int numInstances = 0;
+    int numThreads = 0;
+
+    juce::int64 numBlocks = 0;
+    juce::int64 numCycles = 0;
+    juce::int64 numMisses = 0;
+    double missRate = 0.0;
+
+    // processBlock time per call, microseconds
+    double p50 = 0.0, p99 = 0.0, p999 = 0.0, max = 0.0;
+
+    // Processing time over simulated audio time, per thread (1 = a full core)
+    double load = 0.0;
+
+    int numPrepares = 0;
+    double maxPrepareMs = 0.0;
+
+    // prepareToPlay to the first block through the engine, milliseconds
+    double firstAudioP50Ms = 0.0, maxFirstAudioMs = 0.0;
+
+    // Real-time-safety violations inside processBlock, -1 without the sanitizer
+    juce::int64 numViolations = -1;
+  };
+
+  static Result run(const Settings& settings);
+
+  // Text table: one header line, one line per result
+  static juce::String getTableHeader();
+  static juce::String toTableRow(const Result& result);
+
+private:
+  class HostThread;
+};